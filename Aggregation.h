@@ -0,0 +1,319 @@
+/*
+ * Aggregation.h
+ *
+ * Parallel reductions over all elements of a dataset
+ */
+
+#ifndef HDF5_AGGREGATION_H_
+#define HDF5_AGGREGATION_H_
+
+#include "Exception.h"
+#include "DataTypes.h"
+#include "DatasetInfo.h"
+#include "Hyperslab.h"
+#include "ThreadPool.h"
+#include <hdf5.h>
+#include <stdint.h>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+namespace hdf5
+{
+	/**
+	 * A reducer describes an aggregation by
+	 *   typedef ... Result;
+	 *   Result init() const;                                     // neutral partial result
+	 *   void reduce(const T* values, size_t n, Result& r) const; // adds a block of elements
+	 *   void merge(Result& r, const Result& partial) const;      // adds a partial result
+	 * reduce() is called concurrently for different blocks and must not
+	 * modify the reducer. The kernels below keep several independent
+	 * accumulators, so the compiler can vectorise them.
+	 */
+
+	/// type the elements of T are summed up in, exact for integers
+	template<typename T> struct SumType { typedef double Type; };
+	template<> struct SumType<int8_t> { typedef int64_t Type; };
+	template<> struct SumType<int16_t> { typedef int64_t Type; };
+	template<> struct SumType<int32_t> { typedef int64_t Type; };
+	template<> struct SumType<int64_t> { typedef int64_t Type; };
+	template<> struct SumType<uint8_t> { typedef uint64_t Type; };
+	template<> struct SumType<uint16_t> { typedef uint64_t Type; };
+	template<> struct SumType<uint32_t> { typedef uint64_t Type; };
+	template<> struct SumType<uint64_t> { typedef uint64_t Type; };
+
+	template<typename T> struct Sum {
+			typedef typename SumType<T>::Type Result;
+
+			static Result sum(const T* values, size_t n) {
+				Result s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+				size_t i = 0;
+				for (; i + 4 <= n; i += 4) {
+					s0 += values[i];
+					s1 += values[i + 1];
+					s2 += values[i + 2];
+					s3 += values[i + 3];
+				}
+				for (; i < n; ++i) {
+					s0 += values[i];
+				}
+				return (s0 + s1) + (s2 + s3);
+			}
+
+			inline Result init() const { return 0; }
+			inline void reduce(const T* values, size_t n, Result& result) const { result += sum(values, n); }
+			inline void merge(Result& result, const Result& partial) const { result += partial; }
+	};
+
+	template<typename T> struct Mean {
+			struct Result {
+					typename SumType<T>::Type sum;
+					uint64_t count;
+
+					/// NaN for no elements
+					inline double get() const { return count ? static_cast<double>(sum) / count : std::numeric_limits<double>::quiet_NaN(); }
+			};
+
+			inline Result init() const { Result r = { 0, 0 }; return r; }
+			inline void reduce(const T* values, size_t n, Result& result) const { result.sum += Sum<T>::sum(values, n); result.count += n; }
+			inline void merge(Result& result, const Result& partial) const { result.sum += partial.sum; result.count += partial.count; }
+	};
+
+	/// minimum and maximum, NaN values are ignored
+	template<typename T> struct MinMax {
+			struct Result {
+					T min;
+					T max;
+					/// true if at least one element has been seen
+					inline bool valid() const { return !(max < min); }
+			};
+
+			inline Result init() const {
+				Result r = { std::numeric_limits<T>::max(), std::numeric_limits<T>::lowest() };
+				return r;
+			}
+			void reduce(const T* values, size_t n, Result& result) const {
+				T min[4] = { result.min, result.min, result.min, result.min };
+				T max[4] = { result.max, result.max, result.max, result.max };
+				size_t i = 0;
+				for (; i + 4 <= n; i += 4) {
+					for (size_t j = 0; j < 4; ++j) {
+						// written as comparisons, so NaN never replaces a value
+						min[j] = values[i + j] < min[j] ? values[i + j] : min[j];
+						max[j] = values[i + j] > max[j] ? values[i + j] : max[j];
+					}
+				}
+				for (; i < n; ++i) {
+					min[0] = values[i] < min[0] ? values[i] : min[0];
+					max[0] = values[i] > max[0] ? values[i] : max[0];
+				}
+				result.min = std::min(std::min(min[0], min[1]), std::min(min[2], min[3]));
+				result.max = std::max(std::max(max[0], max[1]), std::max(max[2], max[3]));
+			}
+			inline void merge(Result& result, const Result& partial) const {
+				result.min = std::min(result.min, partial.min);
+				result.max = std::max(result.max, partial.max);
+			}
+	};
+
+	/// number of elements for which predicate(value) is true
+	template<typename T, typename Predicate> struct CountIf {
+			typedef uint64_t Result;
+
+			Predicate predicate;
+
+			explicit CountIf(const Predicate& predicate = Predicate()): predicate(predicate) {}
+
+			inline Result init() const { return 0; }
+			void reduce(const T* values, size_t n, Result& result) const {
+				uint64_t count = 0;
+				for (size_t i = 0; i < n; ++i) {
+					count += predicate(values[i]) ? 1 : 0;
+				}
+				result += count;
+			}
+			inline void merge(Result& result, const Result& partial) const { result += partial; }
+	};
+
+	/// e.g. countIf<double>([](double x) { return x > 5; })
+	template<typename T, typename Predicate> CountIf<T, Predicate> countIf(const Predicate& predicate) { return CountIf<T, Predicate>(predicate); }
+
+	/// nBins bins of equal width between lo and hi, NaN values are not counted
+	template<typename T> struct Histogram {
+			struct Result {
+					std::vector<uint64_t> bins;
+					uint64_t underflow;
+					uint64_t overflow;
+			};
+
+			size_t nBins;
+			double lo;
+			double hi;
+
+			Histogram(size_t nBins, double lo, double hi): nBins(nBins), lo(lo), hi(hi) {
+				if (nBins == 0 || !(lo < hi)) {
+					throw Exception("Histogram: Needs at least one bin and lo < hi");
+				}
+			}
+
+			inline Result init() const {
+				Result r;
+				r.bins.assign(nBins, 0);
+				r.underflow = 0;
+				r.overflow = 0;
+				return r;
+			}
+			void reduce(const T* values, size_t n, Result& result) const {
+				double scale = nBins / (hi - lo);
+				for (size_t i = 0; i < n; ++i) {
+					double value = values[i];
+					if (value < lo) {
+						++result.underflow;
+					}
+					else if (value >= hi) {
+						++result.overflow;
+					}
+					else if (value == value) {
+						// rounding may put values just below hi into bin nBins
+						++result.bins[std::min(static_cast<size_t>((value - lo) * scale), nBins - 1)];
+					}
+				}
+			}
+			void merge(Result& result, const Result& partial) const {
+				for (size_t i = 0; i < nBins; ++i) {
+					result.bins[i] += partial.bins[i];
+				}
+				result.underflow += partial.underflow;
+				result.overflow += partial.overflow;
+			}
+	};
+
+	/// elements per block aggregate() reads, rounded to whole chunks
+	const hsize_t DefaultAggregationBlock = 1 << 20;
+
+	/**
+	 * Reduces all elements of a dataset, converted to T by the library.
+	 *
+	 * The dataset is read on the calling thread in blocks of whole rows,
+	 * aligned to the chunks of the dataset. Every block is reduced by a task
+	 * on pool as soon as it has been read, while the next one is read. At
+	 * most two blocks per worker are held in memory. The partial results are
+	 * merged in block order, so the result does not depend on scheduling.
+	 *
+	 * Must not be called from a task of pool.
+	 */
+	template<typename T, typename Reducer> typename Reducer::Result aggregate(hid_t dataSet, const DatasetInfo& info, const Reducer& reducer,
+			ThreadPool& pool, hsize_t blockElements = DefaultAggregationBlock) {
+		typedef typename Reducer::Result Result;
+		typedef std::vector<T> Buffer;
+
+		struct State {
+				std::mutex mutex;
+				std::condition_variable done;
+				size_t inFlight;
+				std::map<hsize_t, Result> partials;
+				std::vector< boost::shared_ptr<Buffer> > freeBuffers;
+				std::exception_ptr error;
+
+				State(): inFlight(0) {}
+		} state;
+
+		Result result = reducer.init();
+		size_t rank = info.getRank();
+		if (rank == 0 || info.getNumElements() == 0) {
+			if (rank == 0) {
+				// scalar dataset
+				T value;
+				if (H5Dread(dataSet, DataType<T>::hdfType(), H5S_ALL, H5S_ALL, H5P_DEFAULT, &value) < 0) {
+					throw Exception("hdf5::aggregate(): Error while reading data from file");
+				}
+				reducer.reduce(&value, 1, result);
+			}
+			return result;
+		}
+
+		// whole rows, whole chunks along the first dimension
+		hsize_t rowLength = info.getNumElements() / info.shape[0];
+		hsize_t chunkRows = info.isChunked() ? info.chunkDims[0] : 1;
+		hsize_t blockRows = std::max<hsize_t>(1, blockElements / rowLength);
+		blockRows = std::max(chunkRows, blockRows / chunkRows * chunkRows);
+		size_t maxInFlight = 2 * pool.getNumThreads();
+
+		hsize_t nextMerge = 0;
+		hsize_t block = 0;
+		std::vector<hsize_t> start(rank, 0), count(info.shape);
+		for (hsize_t firstRow = 0; firstRow < info.shape[0]; firstRow += blockRows, ++block) {
+			boost::shared_ptr<Buffer> buffer;
+			{
+				std::unique_lock<std::mutex> lock(state.mutex);
+				state.done.wait(lock, [&]() { return state.inFlight < maxInFlight; });
+				while (!state.partials.empty() && state.partials.begin()->first == nextMerge) {
+					reducer.merge(result, state.partials.begin()->second);
+					state.partials.erase(state.partials.begin());
+					++nextMerge;
+				}
+				if (state.error) {
+					break;
+				}
+				if (!state.freeBuffers.empty()) {
+					buffer = state.freeBuffers.back();
+					state.freeBuffers.pop_back();
+				}
+			}
+			if (!buffer) {
+				buffer.reset(new Buffer());
+			}
+
+			start[0] = firstRow;
+			count[0] = std::min(blockRows, info.shape[0] - firstRow);
+			try {
+				readHyperslab(dataSet, start, count, *buffer);
+			}
+			catch (...) {
+				std::unique_lock<std::mutex> lock(state.mutex);
+				state.done.wait(lock, [&]() { return state.inFlight == 0; });
+				throw;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(state.mutex);
+				++state.inFlight;
+			}
+			State* s = &state;
+			const Reducer* r = &reducer;
+			pool.submit([s, r, buffer, block]() {
+				Result partial = r->init();
+				try {
+					r->reduce(buffer->data(), buffer->size(), partial);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(s->mutex);
+					s->error = std::current_exception();
+				}
+				// notified under the lock, the state is gone once the caller sees the last block
+				std::lock_guard<std::mutex> lock(s->mutex);
+				s->partials[block] = partial;
+				s->freeBuffers.push_back(buffer);
+				--s->inFlight;
+				s->done.notify_all();
+			});
+		}
+
+		std::unique_lock<std::mutex> lock(state.mutex);
+		state.done.wait(lock, [&]() { return state.inFlight == 0; });
+		if (state.error) {
+			std::rethrow_exception(state.error);
+		}
+		for (typename std::map<hsize_t, Result>::const_iterator it = state.partials.begin(); it != state.partials.end(); ++it) {
+			reducer.merge(result, it->second);
+		}
+		return result;
+	}
+
+} /* namespace hdf5 */
+#endif /* HDF5_AGGREGATION_H_ */
@@ -0,0 +1,263 @@
+/*
+ * AttributeValue.h
+ *
+ * Compact storage for decoded attribute values
+ */
+
+#ifndef HDF5_ATTRIBUTEVALUE_H_
+#define HDF5_ATTRIBUTEVALUE_H_
+
+#include "Exception.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <stdint.h>
+#include <boost/multi_array.hpp>
+
+namespace hdf5
+{
+	class AttributeValue;
+
+	/// attributes of a compound type, member name -> member value
+	typedef std::map<std::string, AttributeValue> CompoundAttribute;
+
+	/**
+	 * Attribute of rank 2 or higher. The elements are stored in one flat
+	 * buffer in C order, view<NumDims>() gives multi_array access to it,
+	 * e.g. boost::multi_array<double, 2> m = attr.view<2>();
+	 */
+	template<typename T> struct ArrayAttribute {
+			std::vector<size_t> shape;
+			std::vector<T> data;
+
+			inline size_t getRank() const { return shape.size(); }
+
+			template<std::size_t NumDims> boost::const_multi_array_ref<T, NumDims> view() const {
+				if (shape.size() != NumDims) {
+					throw Exception("ArrayAttribute::view(): Rank of attribute and requested view does not match");
+				}
+				return boost::const_multi_array_ref<T, NumDims>(data.empty() ? 0 : &data[0], shape);
+			}
+			template<std::size_t NumDims> boost::multi_array_ref<T, NumDims> view() {
+				if (shape.size() != NumDims) {
+					throw Exception("ArrayAttribute::view(): Rank of attribute and requested view does not match");
+				}
+				return boost::multi_array_ref<T, NumDims>(data.empty() ? 0 : &data[0], shape);
+			}
+	};
+
+	/**
+	 * Type erased value of an attribute, replacing boost::any.
+	 *
+	 * Values of up to InlineSize bytes (all arithmetic types, std::string and
+	 * std::vector) are stored inside the object itself, only larger types
+	 * like CompoundAttribute are allocated on the heap. The stored type is
+	 * identified by a pointer to a static table of operations, therefore
+	 * get<T>() is a single comparison and does not need RTTI.
+	 */
+	class AttributeValue
+	{
+		public:
+			static const size_t InlineSize = 32;
+
+			AttributeValue(): fOperations(0) {}
+			AttributeValue(const AttributeValue& original): fOperations(0) { operator=(original); }
+			AttributeValue(AttributeValue&& original): fOperations(0) { swapIn(original); }
+			template<typename T> AttributeValue(const T& value): fOperations(0) { new (allocate<T>()) T(value); }
+			AttributeValue(const char* value): fOperations(0) { new (allocate<std::string>()) std::string(value); }
+			~AttributeValue() { clear(); }
+
+			AttributeValue& operator=(const AttributeValue& original) {
+				if (this != &original) {
+					clear();
+					if (original.fOperations) {
+						original.fOperations->copy(original, *this);
+					}
+				}
+				return *this;
+			}
+			AttributeValue& operator=(AttributeValue&& original) {
+				if (this != &original) {
+					clear();
+					swapIn(original);
+				}
+				return *this;
+			}
+			template<typename T> AttributeValue& operator=(const T& value) {
+				clear();
+				new (allocate<T>()) T(value);
+				return *this;
+			}
+			AttributeValue& operator=(const char* value) { return operator=(std::string(value)); }
+
+			/**
+			 * Replaces the value by a default constructed T and returns it, e.g.
+			 * to fill a vector in place without copying it afterwards.
+			 */
+			template<typename T> T& emplace() {
+				clear();
+				return *(new (allocate<T>()) T());
+			}
+
+			inline bool empty() const { return fOperations == 0; }
+			/// true if the stored value is of type T
+			template<typename T> inline bool is() const { return fOperations == &Handler<T>::operations; }
+
+			template<typename T> T& get() {
+				if (!is<T>()) {
+					throw Exception("AttributeValue::get(): Requested type does not match the stored type");
+				}
+				return *Handler<T>::pointer(*this);
+			}
+			template<typename T> const T& get() const {
+				if (!is<T>()) {
+					throw Exception("AttributeValue::get(): Requested type does not match the stored type");
+				}
+				return *Handler<T>::pointer(const_cast<AttributeValue&>(*this));
+			}
+
+			void clear() {
+				if (fOperations) {
+					fOperations->destroy(*this);
+					fOperations = 0;
+				}
+			}
+
+			friend std::ostream& operator<<(std::ostream& os, const AttributeValue& value) {
+				if (value.fOperations) {
+					value.fOperations->print(os, value);
+				}
+				return os;
+			}
+
+		private:
+			struct Operations {
+					void (*destroy)(AttributeValue& value);
+					void (*copy)(const AttributeValue& src, AttributeValue& dst);
+					void (*move)(AttributeValue& src, AttributeValue& dst);
+					void (*print)(std::ostream& os, const AttributeValue& value);
+			};
+
+			template<typename T, bool Inline = (sizeof(T) <= InlineSize)> struct Handler;
+
+			/// returns memory for a T and sets the type of the value
+			template<typename T> void* allocate() {
+				void* memory = Handler<T>::allocate(*this);
+				fOperations = &Handler<T>::operations;
+				return memory;
+			}
+
+			void swapIn(AttributeValue& original) {
+				if (original.fOperations) {
+					original.fOperations->move(original, *this);
+					fOperations = original.fOperations;
+					original.fOperations = 0;
+				}
+			}
+
+			/// detects if a type can be written to an ostream
+			template<typename T> struct IsStreamable {
+					template<typename U> static char test(typename std::remove_reference<decltype(std::declval<std::ostream&>() << std::declval<const U&>())>::type*);
+					template<typename U> static long test(...);
+					static const bool value = sizeof(test<T>(0)) == 1;
+			};
+
+			template<typename T> static void print(std::ostream& os, const T& value) { print(os, value, std::integral_constant<bool, IsStreamable<T>::value>()); }
+			template<typename T> static void print(std::ostream& os, const T& value, std::true_type) { os << value; }
+			template<typename T> static void print(std::ostream& os, const T& value, std::false_type) {}
+			static void print(std::ostream& os, int8_t value) { os << static_cast<int>(value); }
+			static void print(std::ostream& os, uint8_t value) { os << static_cast<unsigned int>(value); }
+			template<typename T> static void print(std::ostream& os, const std::vector<T>& value) {
+				os << "[";
+				for (size_t i = 0; i < value.size(); ++i) {
+					os << (i ? ", " : "");
+					print(os, value[i]);
+				}
+				os << "]";
+			}
+			template<typename T> static void print(std::ostream& os, const ArrayAttribute<T>& value) {
+				for (size_t i = 0; i < value.shape.size(); ++i) {
+					os << (i ? "x" : "(") << value.shape[i];
+				}
+				os << ")";
+				print(os, value.data);
+			}
+			static void print(std::ostream& os, const CompoundAttribute& value) {
+				os << "{";
+				for (CompoundAttribute::const_iterator it = value.begin(); it != value.end(); ++it) {
+					os << (it != value.begin() ? ", " : "") << it->first << ": " << it->second;
+				}
+				os << "}";
+			}
+
+			union {
+					long double alignment;
+					void* heap;
+					char buffer[InlineSize];
+			} fStorage;
+			const Operations* fOperations;
+	};
+
+	// values stored inside the object
+	template<typename T> struct AttributeValue::Handler<T, true> {
+			static const Operations operations;
+
+			static void* allocate(AttributeValue& value) { return value.fStorage.buffer; }
+			static T* pointer(AttributeValue& value) { return reinterpret_cast<T*>(value.fStorage.buffer); }
+
+			static void destroy(AttributeValue& value) { pointer(value)->~T(); }
+			static void copy(const AttributeValue& src, AttributeValue& dst) {
+				new (dst.allocate<T>()) T(*pointer(const_cast<AttributeValue&>(src)));
+			}
+			static void move(AttributeValue& src, AttributeValue& dst) {
+				new (dst.fStorage.buffer) T(std::move(*pointer(src)));
+				destroy(src);
+			}
+			static void print(std::ostream& os, const AttributeValue& value) {
+				AttributeValue::print(os, *pointer(const_cast<AttributeValue&>(value)));
+			}
+	};
+	template<typename T> const AttributeValue::Operations AttributeValue::Handler<T, true>::operations = {
+			&AttributeValue::Handler<T, true>::destroy,
+			&AttributeValue::Handler<T, true>::copy,
+			&AttributeValue::Handler<T, true>::move,
+			&AttributeValue::Handler<T, true>::print
+	};
+
+	// values too large to be stored inside the object
+	template<typename T> struct AttributeValue::Handler<T, false> {
+			static const Operations operations;
+
+			static void* allocate(AttributeValue& value) {
+				value.fStorage.heap = ::operator new(sizeof(T));
+				return value.fStorage.heap;
+			}
+			static T* pointer(AttributeValue& value) { return static_cast<T*>(value.fStorage.heap); }
+
+			static void destroy(AttributeValue& value) {
+				pointer(value)->~T();
+				::operator delete(value.fStorage.heap);
+			}
+			static void copy(const AttributeValue& src, AttributeValue& dst) {
+				new (dst.allocate<T>()) T(*pointer(const_cast<AttributeValue&>(src)));
+			}
+			static void move(AttributeValue& src, AttributeValue& dst) {
+				dst.fStorage.heap = src.fStorage.heap;
+			}
+			static void print(std::ostream& os, const AttributeValue& value) {
+				AttributeValue::print(os, *pointer(const_cast<AttributeValue&>(value)));
+			}
+	};
+	template<typename T> const AttributeValue::Operations AttributeValue::Handler<T, false>::operations = {
+			&AttributeValue::Handler<T, false>::destroy,
+			&AttributeValue::Handler<T, false>::copy,
+			&AttributeValue::Handler<T, false>::move,
+			&AttributeValue::Handler<T, false>::print
+	};
+
+} /* namespace hdf5 */
+#endif /* HDF5_ATTRIBUTEVALUE_H_ */
@@ -0,0 +1,400 @@
+/*
+ * ChunkAdvisor.cpp
+ *
+ * Chunk dimensions derived from the expected access pattern of a dataset
+ */
+
+#include "ChunkAdvisor.h"
+#include "Exception.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <stdint.h>
+
+using namespace std;
+
+namespace hdf5
+{
+
+	AccessPattern AccessPattern::rows(hsize_t rowsPerRead)
+	{
+		AccessPattern pattern;
+		pattern.kind = Rows;
+		pattern.extent.push_back(max<hsize_t>(rowsPerRead, 1));
+		return pattern;
+	}
+
+	AccessPattern AccessPattern::columns(hsize_t columnsPerRead)
+	{
+		AccessPattern pattern;
+		pattern.kind = Columns;
+		pattern.extent.push_back(max<hsize_t>(columnsPerRead, 1));
+		return pattern;
+	}
+
+	AccessPattern AccessPattern::tiles(const std::vector<hsize_t>& tile)
+	{
+		AccessPattern pattern;
+		pattern.kind = Tiles;
+		pattern.extent = tile;
+		return pattern;
+	}
+
+	AccessPattern AccessPattern::append()
+	{
+		AccessPattern pattern;
+		pattern.kind = Append;
+		pattern.extent.push_back(1);
+		return pattern;
+	}
+
+	std::ostream& operator<<(std::ostream& os, const ChunkMeasurement& measurement)
+	{
+		os << "chunk=(";
+		for (size_t i = 0; i < measurement.chunkDims.size(); ++i) {
+			os << (i ? "x" : "") << measurement.chunkDims[i];
+		}
+		os << ") stored=" << measurement.storedBytes << " write=" << measurement.writeSeconds << "s read=" << measurement.readSeconds
+				<< "s " << measurement.getReadThroughput() << " MB/s";
+		return os;
+	}
+
+	const hsize_t ChunkAdvisor::DefaultTargetBytes;
+	const hsize_t ChunkAdvisor::DefaultCacheBytes;
+	const hsize_t ChunkAdvisor::DefaultSampleBytes;
+
+	ChunkAdvisor::ChunkAdvisor(hsize_t targetBytes, hsize_t cacheBytes): fTargetBytes(targetBytes), fCacheBytes(cacheBytes)
+	{
+		if (fTargetBytes == 0) {
+			throw Exception("ChunkAdvisor: Target chunk size must be larger than zero");
+		}
+	}
+
+	namespace
+	{
+		/**
+		 * Spends up to budget elements on the dimensions from last down to
+		 * first, the last dimensions are covered completely first.
+		 * @return elements left
+		 */
+		hsize_t fillFromLast(const std::vector<hsize_t>& shape, size_t first, hsize_t budget, std::vector<hsize_t>& dims)
+		{
+			for (size_t d = shape.size(); d-- > first;) {
+				dims[d] = max<hsize_t>(1, min(shape[d], budget));
+				budget = max<hsize_t>(1, budget / dims[d]);
+			}
+			return budget;
+		}
+
+		/// elements of all dimensions from first on
+		hsize_t getElements(const std::vector<hsize_t>& dims, size_t first = 0)
+		{
+			hsize_t n = 1;
+			for (size_t d = first; d < dims.size(); ++d) {
+				n *= dims[d];
+			}
+			return n;
+		}
+	}
+
+	std::vector<hsize_t> ChunkAdvisor::suggest(const std::vector<hsize_t>& shape, size_t typeSize, const AccessPattern& pattern) const
+	{
+		size_t rank = shape.size();
+		if (rank == 0 || typeSize == 0) {
+			throw Exception("ChunkAdvisor::suggest(): Chunks need a dataset of rank 1 or more");
+		}
+		// empty dimensions are treated as one element, chunks must not be empty
+		vector<hsize_t> extent(rank);
+		for (size_t d = 0; d < rank; ++d) {
+			extent[d] = max<hsize_t>(shape[d], 1);
+		}
+		hsize_t target = max<hsize_t>(1, fTargetBytes / typeSize);
+		hsize_t cache = max<hsize_t>(1, fCacheBytes / typeSize);
+		vector<hsize_t> dims(rank, 1);
+
+		switch (pattern.kind) {
+			case AccessPattern::None:
+			case AccessPattern::Rows:
+			case AccessPattern::Append: {
+				// whole rows, as many as fit into the target and the cache
+				hsize_t rowElements = getElements(extent, 1);
+				if (rowElements > target) {
+					fillFromLast(extent, 1, target, dims);
+					break;
+				}
+				copy(extent.begin() + 1, extent.end(), dims.begin() + 1);
+				hsize_t rowsPerRead = pattern.extent.empty() ? 1 : pattern.extent[0];
+				hsize_t rows = target / rowElements;
+				if (pattern.kind == AccessPattern::Append) {
+					// every record is written into the chunk in the cache
+					rows = min(target, cache) / rowElements;
+				}
+				else if (rowsPerRead < rows) {
+					// a chunk is reused by the following reads only if it fits into the cache
+					rows = min(rows, max(rowsPerRead, cache / rowElements));
+					// reads of several rows start at multiples of their size
+					rows = max<hsize_t>(rows / rowsPerRead, 1) * rowsPerRead;
+				}
+				dims[0] = max<hsize_t>(1, min(rows, extent[0]));
+				break;
+			}
+
+			case AccessPattern::Columns: {
+				// as long as possible along the first dimension
+				dims[0] = min(extent[0], target);
+				if (rank == 1) {
+					break;
+				}
+				// one column of chunks is reused by the neighbouring columns if it fits into the cache
+				hsize_t chunksPerColumn = (extent[0] + dims[0] - 1) / dims[0];
+				hsize_t width = cache / (dims[0] * chunksPerColumn);
+				hsize_t columnsPerRead = pattern.extent.empty() ? 1 : pattern.extent[0];
+				width = max<hsize_t>(1, min(target / dims[0], max(width, columnsPerRead)));
+				fillFromLast(extent, 1, width, dims);
+				break;
+			}
+
+			case AccessPattern::Tiles: {
+				if (pattern.extent.size() != rank) {
+					throw Exception("ChunkAdvisor::suggest(): Rank of the tiles and the dataset does not match");
+				}
+				for (size_t d = 0; d < rank; ++d) {
+					dims[d] = max<hsize_t>(1, min(pattern.extent[d], extent[d]));
+				}
+				// tiles larger than the target are split into halves, so they still consist of whole chunks
+				while (getElements(dims) > target) {
+					size_t largest = max_element(dims.begin(), dims.end()) - dims.begin();
+					dims[largest] = (dims[largest] + 1) / 2;
+				}
+				// tiny chunks cost more in the chunk index than reading a few neighbours
+				bool grown = true;
+				while (grown && getElements(dims) < target / 16) {
+					grown = false;
+					for (size_t d = rank; d-- > 0 && getElements(dims) < target / 16;) {
+						if (dims[d] < extent[d]) {
+							dims[d] = min(2 * dims[d], extent[d]);
+							grown = true;
+						}
+					}
+				}
+				break;
+			}
+		}
+		return dims;
+	}
+
+	std::vector< std::vector<hsize_t> > ChunkAdvisor::getCandidates(const std::vector<hsize_t>& shape, size_t typeSize, const AccessPattern& pattern) const
+	{
+		vector< vector<hsize_t> > candidates;
+		candidates.push_back(suggest(shape, typeSize, pattern));
+		candidates.push_back(ChunkAdvisor(max<hsize_t>(fTargetBytes / 4, 1), fCacheBytes).suggest(shape, typeSize, pattern));
+		candidates.push_back(ChunkAdvisor(fTargetBytes * 4, fCacheBytes).suggest(shape, typeSize, pattern));
+		if (pattern.kind != AccessPattern::Rows) {
+			candidates.push_back(suggest(shape, typeSize, AccessPattern::rows()));
+		}
+		if (pattern.kind != AccessPattern::Columns) {
+			candidates.push_back(suggest(shape, typeSize, AccessPattern::columns()));
+		}
+
+		vector< vector<hsize_t> > unique;
+		for (size_t i = 0; i < candidates.size(); ++i) {
+			if (find(unique.begin(), unique.end(), candidates[i]) == unique.end()) {
+				unique.push_back(candidates[i]);
+			}
+		}
+		return unique;
+	}
+
+	namespace
+	{
+		/// reads of the benchmark for one candidate
+		const size_t MaxBenchmarkReads = 1024;
+
+		/// start and count of all reads of pattern in a dataset of the given shape
+		void getReads(const std::vector<hsize_t>& shape, const AccessPattern& pattern, std::vector< std::vector<hsize_t> >& starts,
+				std::vector< std::vector<hsize_t> >& counts)
+		{
+			size_t rank = shape.size();
+			vector<hsize_t> start(rank, 0), count(shape);
+			switch (pattern.kind) {
+				case AccessPattern::None:
+				case AccessPattern::Rows:
+				case AccessPattern::Append: {
+					hsize_t rowsPerRead = pattern.extent.empty() ? 1 : pattern.extent[0];
+					for (hsize_t row = 0; row < shape[0] && starts.size() < MaxBenchmarkReads; row += rowsPerRead) {
+						start[0] = row;
+						count[0] = min(rowsPerRead, shape[0] - row);
+						starts.push_back(start);
+						counts.push_back(count);
+					}
+					break;
+				}
+
+				case AccessPattern::Columns: {
+					// neighbouring columns one after the other
+					hsize_t columnsPerRead = pattern.extent.empty() ? 1 : pattern.extent[0];
+					for (size_t d = 1; d < rank; ++d) {
+						count[d] = 1;
+					}
+					if (rank > 1) {
+						count[rank - 1] = columnsPerRead;
+					}
+					hsize_t nReads = rank > 1 ? getElements(shape, 1) / shape[rank - 1] * ((shape[rank - 1] + columnsPerRead - 1) / columnsPerRead) : 1;
+					for (hsize_t i = 0; i < nReads && starts.size() < MaxBenchmarkReads; ++i) {
+						hsize_t index = i;
+						for (size_t d = rank; d-- > 1;) {
+							hsize_t n = d == rank - 1 ? (shape[d] + columnsPerRead - 1) / columnsPerRead : shape[d];
+							start[d] = (index % n) * count[d];
+							index /= n;
+						}
+						vector<hsize_t> c(count);
+						if (rank > 1) {
+							c[rank - 1] = min(count[rank - 1], shape[rank - 1] - start[rank - 1]);
+						}
+						starts.push_back(start);
+						counts.push_back(c);
+					}
+					break;
+				}
+
+				case AccessPattern::Tiles: {
+					// the same pseudo random positions for all candidates
+					uint64_t state = 12345;
+					for (size_t d = 0; d < rank; ++d) {
+						count[d] = max<hsize_t>(1, min(pattern.extent[d], shape[d]));
+					}
+					for (size_t i = 0; i < MaxBenchmarkReads; ++i) {
+						for (size_t d = 0; d < rank; ++d) {
+							state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+							start[d] = (state >> 33) % (shape[d] - count[d] + 1);
+						}
+						starts.push_back(start);
+						counts.push_back(count);
+					}
+					break;
+				}
+			}
+		}
+	}
+
+	std::vector<ChunkMeasurement> ChunkAdvisor::benchmark(hid_t dataSet, const AccessPattern& pattern, const std::vector< std::vector<hsize_t> >& candidates,
+			hsize_t sampleBytes) const
+	{
+		typedef chrono::steady_clock Clock;
+
+		// the first rows of the dataset in the file type
+		hid_t type = H5Dget_type(dataSet);
+		hid_t space = H5Dget_space(dataSet);
+		int rank = H5Sget_simple_extent_ndims(space);
+		if (rank < 1 || H5Tdetect_class(type, H5T_VLEN) > 0 || H5Tis_variable_str(type) > 0) {
+			H5Sclose(space);
+			H5Tclose(type);
+			throw Exception("ChunkAdvisor::benchmark(): Only datasets of rank 1 or more with fixed size elements are supported");
+		}
+		if (pattern.kind == AccessPattern::Tiles && pattern.extent.size() != static_cast<size_t>(rank)) {
+			H5Sclose(space);
+			H5Tclose(type);
+			throw Exception("ChunkAdvisor::benchmark(): Rank of the tiles and the dataset does not match");
+		}
+		vector<hsize_t> shape(rank);
+		H5Sget_simple_extent_dims(space, &shape[0], 0);
+		size_t typeSize = H5Tget_size(type);
+		hsize_t rowBytes = getElements(shape, 1) * typeSize;
+		shape[0] = min(shape[0], max<hsize_t>(1, sampleBytes / max<hsize_t>(rowBytes, 1)));
+		if (getElements(shape) == 0) {
+			H5Sclose(space);
+			H5Tclose(type);
+			throw Exception("ChunkAdvisor::benchmark(): Dataset is empty");
+		}
+
+		vector<hsize_t> start(rank, 0);
+		H5Sselect_hyperslab(space, H5S_SELECT_SET, &start[0], 0, &shape[0], 0);
+		hid_t sampleSpace = H5Screate_simple(rank, &shape[0], 0);
+		vector<char> sample(getElements(shape) * typeSize);
+		herr_t status = H5Dread(dataSet, type, sampleSpace, space, H5P_DEFAULT, &sample[0]);
+		H5Sclose(space);
+		if (status < 0) {
+			H5Sclose(sampleSpace);
+			H5Tclose(type);
+			throw Exception("ChunkAdvisor::benchmark(): Error while reading the sample");
+		}
+
+		vector< vector<hsize_t> > starts, counts;
+		getReads(shape, pattern, starts, counts);
+		hsize_t maxRead = 0;
+		for (size_t i = 0; i < counts.size(); ++i) {
+			maxRead = max(maxRead, getElements(counts[i]));
+		}
+		vector<char> buffer(maxRead * typeSize);
+
+		// in-memory files, nothing is written to disk
+		hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+		H5Pset_fapl_core(fapl, 64 << 20, 0);
+		hid_t dapl = H5Pcreate(H5P_DATASET_ACCESS);
+		H5Pset_chunk_cache(dapl, H5D_CHUNK_CACHE_NSLOTS_DEFAULT, fCacheBytes, H5D_CHUNK_CACHE_W0_DEFAULT);
+		// the filters of the dataset
+		hid_t dcpl = H5Dget_create_plist(dataSet);
+
+		vector<ChunkMeasurement> measurements;
+		string error;
+		for (size_t c = 0; c < candidates.size() && error.empty(); ++c) {
+			ChunkMeasurement m;
+			m.chunkDims = candidates[c];
+			ostringstream name;
+			name << "hdf5pp-chunk-benchmark-" << this << "-" << c;
+			hid_t file = H5Fcreate(name.str().c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl);
+			if (file < 0) {
+				error = "Could not create an in-memory file";
+				break;
+			}
+			// the sample may have fewer rows than the dataset
+			vector<hsize_t> dims(m.chunkDims);
+			for (size_t d = 0; d < dims.size() && d < shape.size(); ++d) {
+				dims[d] = max<hsize_t>(1, min(dims[d], shape[d]));
+			}
+			hid_t ds = -1;
+			if (dims.size() != static_cast<size_t>(rank) || H5Pset_chunk(dcpl, rank, &dims[0]) < 0
+					|| (ds = H5Dcreate2(file, "sample", type, sampleSpace, H5P_DEFAULT, dcpl, H5P_DEFAULT)) < 0) {
+				H5Fclose(file);
+				error = "Could not create a dataset with the given chunks";
+				break;
+			}
+			Clock::time_point t0 = Clock::now();
+			status = H5Dwrite(ds, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, &sample[0]);
+			H5Dclose(ds);
+			m.writeSeconds = chrono::duration<double>(Clock::now() - t0).count();
+
+			// reopened, so the reads start with an empty chunk cache
+			ds = H5Dopen2(file, "sample", dapl);
+			hid_t fileSpace = H5Dget_space(ds);
+			t0 = Clock::now();
+			for (size_t i = 0; i < starts.size() && status >= 0; ++i) {
+				H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, &starts[i][0], 0, &counts[i][0], 0);
+				hid_t memSpace = H5Screate_simple(rank, &counts[i][0], 0);
+				status = H5Dread(ds, type, memSpace, fileSpace, H5P_DEFAULT, &buffer[0]);
+				H5Sclose(memSpace);
+				m.bytesRead += getElements(counts[i]) * typeSize;
+			}
+			m.readSeconds = chrono::duration<double>(Clock::now() - t0).count();
+			m.storedBytes = H5Dget_storage_size(ds);
+			H5Sclose(fileSpace);
+			H5Dclose(ds);
+			H5Fclose(file);
+			if (status < 0) {
+				error = "Error while transferring the sample";
+			}
+			measurements.push_back(m);
+		}
+
+		H5Pclose(dcpl);
+		H5Pclose(dapl);
+		H5Pclose(fapl);
+		H5Sclose(sampleSpace);
+		H5Tclose(type);
+		if (!error.empty()) {
+			throw Exception("ChunkAdvisor::benchmark(): " + error);
+		}
+		return measurements;
+	}
+
+} /* namespace hdf5 */
@@ -0,0 +1,108 @@
+/*
+ * ChunkAdvisor.h
+ *
+ * Chunk dimensions derived from the expected access pattern of a dataset
+ */
+
+#ifndef HDF5_CHUNKADVISOR_H_
+#define HDF5_CHUNKADVISOR_H_
+
+#include <hdf5.h>
+#include <ostream>
+#include <vector>
+
+namespace hdf5
+{
+	/// how a dataset is going to be accessed, see ChunkAdvisor
+	struct AccessPattern {
+			enum Kind { None, Rows, Columns, Tiles, Append };
+
+			Kind kind;
+			/// rows or columns per read, the dimensions of a tile
+			std::vector<hsize_t> extent;
+
+			AccessPattern(): kind(None) {}
+
+			/// blocks of rowsPerRead whole rows (first dimension)
+			static AccessPattern rows(hsize_t rowsPerRead = 1);
+			/**
+			 * the whole first dimension at fixed other indices, e.g. the time
+			 * series of one pixel, columnsPerRead neighbours along the last
+			 * dimension at once
+			 */
+			static AccessPattern columns(hsize_t columnsPerRead = 1);
+			/// tiles of the given dimensions at any position
+			static AccessPattern tiles(const std::vector<hsize_t>& tile);
+			/**
+			 * records written one after the other along the first dimension and
+			 * read back as ranges of records. Like rows(), but chunks never
+			 * exceed the cache, so partially written chunks stay in memory.
+			 */
+			static AccessPattern append();
+	};
+
+	/// result of one candidate of ChunkAdvisor::benchmark()
+	struct ChunkMeasurement {
+			std::vector<hsize_t> chunkDims;
+			/// size of the sample in the file after filtering
+			hsize_t storedBytes;
+			double writeSeconds;
+			/// bytes requested by the reads of the access pattern
+			hsize_t bytesRead;
+			double readSeconds;
+
+			ChunkMeasurement(): storedBytes(0), writeSeconds(0), bytesRead(0), readSeconds(0) {}
+			inline double getReadThroughput() const { return readSeconds > 0 ? bytesRead / readSeconds / 1e6 : 0; }
+	};
+
+	std::ostream& operator<<(std::ostream& os, const ChunkMeasurement& measurement);
+
+	/**
+	 * Picks chunk dimensions for a dataset from its shape, element size and
+	 * access pattern. Chunks are at most targetBytes large, and the chunks
+	 * a pattern reuses across neighbouring reads fit into cacheBytes, the
+	 * chunk cache of the dataset.
+	 *
+	 * Usage: group.createDataset("x", data, DatasetProperties().chunkedFor(AccessPattern::columns()));
+	 */
+	class ChunkAdvisor
+	{
+		public:
+			/// chunk size aimed at
+			static const hsize_t DefaultTargetBytes = 1 << 20;
+			/// size of the default chunk cache of HDF5
+			static const hsize_t DefaultCacheBytes = 1 << 20;
+			/// data copied from a dataset into benchmark()
+			static const hsize_t DefaultSampleBytes = 64 << 20;
+
+			explicit ChunkAdvisor(hsize_t targetBytes = DefaultTargetBytes, hsize_t cacheBytes = DefaultCacheBytes);
+
+			inline hsize_t getTargetBytes() const { return fTargetBytes; }
+			inline hsize_t getCacheBytes() const { return fCacheBytes; }
+
+			/// chunk dimensions for a dataset of the given shape, never larger than the shape
+			std::vector<hsize_t> suggest(const std::vector<hsize_t>& shape, size_t typeSize, const AccessPattern& pattern) const;
+
+			/**
+			 * The suggestion first, followed by suggestions for a quarter and
+			 * four times the target size and for the other patterns
+			 */
+			std::vector< std::vector<hsize_t> > getCandidates(const std::vector<hsize_t>& shape, size_t typeSize, const AccessPattern& pattern) const;
+
+			/**
+			 * Copies the first sampleBytes of a dataset into in-memory files,
+			 * one per candidate with the filters of the dataset, and measures
+			 * the reads of pattern through a chunk cache of cacheBytes.
+			 *
+			 * @return one measurement per candidate, in the same order
+			 */
+			std::vector<ChunkMeasurement> benchmark(hid_t dataSet, const AccessPattern& pattern, const std::vector< std::vector<hsize_t> >& candidates,
+					hsize_t sampleBytes = DefaultSampleBytes) const;
+
+		private:
+			hsize_t fTargetBytes;
+			hsize_t fCacheBytes;
+	};
+
+} /* namespace hdf5 */
+#endif /* HDF5_CHUNKADVISOR_H_ */
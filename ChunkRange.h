@@ -0,0 +1,184 @@
+/*
+ * ChunkRange.h
+ *
+ * Chunk by chunk traversal of chunked datasets
+ */
+
+#ifndef HDF5_CHUNKRANGE_H_
+#define HDF5_CHUNKRANGE_H_
+
+#include "Exception.h"
+#include "Hyperslab.h"
+#include <hdf5.h>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <boost/shared_ptr.hpp>
+
+namespace hdf5
+{
+	/**
+	 * One stored chunk of a dataset. offset is the coordinate of its first
+	 * element, extent its size clipped to the dataset boundaries and data
+	 * the decoded elements in C order.
+	 */
+	template<typename T> struct Chunk {
+			std::vector<hsize_t> offset;
+			std::vector<hsize_t> extent;
+			hsize_t storageSize;
+			std::vector<T> data;
+
+			Chunk(): storageSize(0) {}
+	};
+
+	/**
+	 * Input range visiting the allocated chunks of a chunked dataset in the
+	 * order they are stored in the file. Chunks which have never been
+	 * written are not allocated and therefore skipped.
+	 *
+	 * Every chunk is read with a hyperslab covering exactly that chunk, so
+	 * each one is decoded once.
+	 */
+	template<typename T> class ChunkRange
+	{
+		public:
+			typedef Chunk<T> Element;
+
+		private:
+			struct ChunkLocation {
+					haddr_t address;
+					hsize_t size;
+					std::vector<hsize_t> offset;
+
+					bool operator<(const ChunkLocation& other) const { return address < other.address; }
+			};
+
+#if H5_VERSION_GE(1, 14, 0)
+			static int collect(const hsize_t* offset, unsigned filterMask, haddr_t address, hsize_t size, void* opData) {
+				std::vector<ChunkLocation>* locations = static_cast<std::vector<ChunkLocation>*>(opData);
+				ChunkLocation loc;
+				loc.address = address;
+				loc.size = size;
+				loc.offset.assign(offset, offset + locations->front().offset.size());
+				locations->push_back(loc);
+				return 0;
+			}
+#endif
+
+			struct State {
+					hid_t dataSet;
+					std::vector<hsize_t> dims;
+					std::vector<hsize_t> chunkDims;
+					std::vector<ChunkLocation> locations;
+					size_t next;
+					bool started;
+					Element current;
+
+					State(hid_t ds): dataSet(ds), next(0), started(false) {
+						H5Iinc_ref(dataSet);
+
+						hid_t plist = H5Dget_create_plist(dataSet);
+						if (H5Pget_layout(plist) != H5D_CHUNKED) {
+							H5Pclose(plist);
+							H5Idec_ref(dataSet);
+							throw Exception("ChunkRange: Dataset is not chunked");
+						}
+						int rank = H5Pget_chunk(plist, 0, 0);
+						chunkDims.resize(rank);
+						H5Pget_chunk(plist, rank, &chunkDims[0]);
+						H5Pclose(plist);
+
+						hid_t space = H5Dget_space(dataSet);
+						dims.resize(rank);
+						H5Sget_simple_extent_dims(space, &dims[0], 0);
+
+#if H5_VERSION_GE(1, 14, 0)
+						// the first entry only carries the rank into the callback
+						locations.resize(1);
+						locations[0].offset.resize(rank);
+						herr_t err = H5Dchunk_iter(dataSet, H5P_DEFAULT, &ChunkRange::collect, &locations);
+						locations.erase(locations.begin());
+#else
+						hsize_t nChunks = 0;
+						herr_t err = H5Dget_num_chunks(dataSet, space, &nChunks);
+						locations.resize(nChunks);
+						for (hsize_t i = 0; i < nChunks && err > -1; ++i) {
+							unsigned filterMask;
+							locations[i].offset.resize(rank);
+							err = H5Dget_chunk_info(dataSet, space, i, &locations[i].offset[0], &filterMask, &locations[i].address, &locations[i].size);
+						}
+#endif
+						H5Sclose(space);
+						if (err < 0) {
+							H5Idec_ref(dataSet);
+							throw Exception("ChunkRange: Could not retrieve chunk information");
+						}
+
+						std::sort(locations.begin(), locations.end());
+					}
+					~State() {
+						H5Idec_ref(dataSet);
+					}
+
+					/// reads the next stored chunk into current
+					void advance() {
+						if (next >= locations.size()) {
+							current = Element();
+							return;
+						}
+
+						const ChunkLocation& loc = locations[next++];
+						current.offset = loc.offset;
+						current.storageSize = loc.size;
+						current.extent.resize(dims.size());
+						for (size_t i = 0; i < dims.size(); ++i) {
+							current.extent[i] = std::min(chunkDims[i], dims[i] - loc.offset[i]);
+						}
+						readHyperslab(dataSet, current.offset, current.extent, current.data);
+					}
+			};
+
+		public:
+			class iterator: public std::iterator<std::input_iterator_tag, Element>
+			{
+				public:
+					iterator(): fState(0) {}
+					explicit iterator(State* state): fState(state) {}
+
+					const Element& operator*() const { return fState->current; }
+					const Element* operator->() const { return &fState->current; }
+					iterator& operator++() { fState->advance(); return *this; }
+
+					bool operator==(const iterator& other) const { return atEnd() == other.atEnd(); }
+					bool operator!=(const iterator& other) const { return !operator==(other); }
+
+				private:
+					bool atEnd() const { return fState == 0 || fState->current.offset.empty(); }
+
+					State* fState;
+			};
+
+			/// @param dataSet HDF5 identifier of a chunked dataset, the range keeps its own reference
+			explicit ChunkRange(hid_t dataSet): fState(new State(dataSet)) {}
+
+			/// number of allocated chunks
+			inline size_t getNumChunks() const { return fState->locations.size(); }
+			/// size of a full chunk in each dimension
+			inline const std::vector<hsize_t>& getChunkDims() const { return fState->chunkDims; }
+
+			/// starts reading; a range can be iterated only once
+			iterator begin() {
+				if (!fState->started) {
+					fState->started = true;
+					fState->advance();
+				}
+				return iterator(fState.get());
+			}
+			iterator end() { return iterator(); }
+
+		private:
+			boost::shared_ptr<State> fState;
+	};
+
+} /* namespace hdf5 */
+#endif /* HDF5_CHUNKRANGE_H_ */
@@ -3,12 +3,45 @@
 
 #include <hdf5.h>
 #include "Exception.h"
+#include "DataTypes.h"
+#include "IoStatistics.h"
+#include "ScratchAllocator.h"
 
 #include <vector>
 #include <list>
 #include <map>
+#include <algorithm>
+#include <utility>
+#include <boost/array.hpp>
+#include <boost/multi_array.hpp>
+#include <boost/next_prior.hpp>
+#include <boost/container/flat_map.hpp>
+#include <boost/noncopyable.hpp>
 
 namespace hdf5 {
+	/**
+	 * Frees the variable length data the library allocated while reading
+	 * nElements elements of memType into buffer, when it goes out of scope.
+	 */
+	class VlenReclaimer: private boost::noncopyable
+	{
+		public:
+			VlenReclaimer(hid_t memType, hsize_t nElements, void* buffer): fMemType(memType), fNumElements(nElements), fBuffer(buffer) {}
+			~VlenReclaimer() {
+				if (fNumElements == 0) {
+					return;
+				}
+				hid_t space = H5Screate_simple(1, &fNumElements, 0);
+				H5Dvlen_reclaim(fMemType, space, H5P_DEFAULT, fBuffer);
+				H5Sclose(space);
+			}
+
+		private:
+			hid_t fMemType;
+			hsize_t fNumElements;
+			void* fBuffer;
+	};
+
 	template<typename T> struct ContainerInterface {
 			typedef T Container;
 
@@ -32,6 +65,16 @@ namespace hdf5 {
 			 */
 			static void write(const Container& src, hid_t dataSet, hid_t dataSpace);
 
+			/**
+			 * Writes the src container to the dataset without validating the
+			 * dataset against the container. Only use it if the dataset has
+			 * been created from this container type and size.
+			 * @param src Container to write
+			 * @param dataSet HDF5 identifier for the target dataset
+			 * @param memType HDF5 type of the elements in memory (see hdfElementType())
+			 */
+			static void writeData(const Container& src, hid_t dataSet, hid_t memType);
+
 			/**
 			 * Reads the data from the dataSet into the dst container
 			 * @param src Container to store the data from file
@@ -39,6 +82,25 @@ namespace hdf5 {
 			 * @param dataSpace HDF5 identifier fitting the container
 			 */
 			static void read(Container& dst, hid_t dataSet, hid_t dataSpace);
+
+			/**
+			 * Reads the dataset into dst without validating the dataset against
+			 * the container, see checkType().
+			 * @param dst Container to store the data from file, resized to dims
+			 * @param dataSet HDF5 identifier for the source dataset
+			 * @param memType HDF5 type of the elements in memory (see hdfElementType())
+			 * @param dims Size of all dimensions of the dataset
+			 */
+			static void readData(Container& dst, hid_t dataSet, hid_t memType, const hsize_t* dims);
+
+			/**
+			 * Throws if element type or rank of the dataset do not fit the
+			 * container. The sizes of the dimensions are not checked.
+			 */
+			static void checkType(hid_t dataSet, hid_t dataSpace);
+
+			/// number of elements of the container
+			static hsize_t getNumElements(const Container& src);
 	};
 
 	/*
@@ -56,17 +118,19 @@ namespace hdf5 {
 				return H5Screate_simple(1, dims, 0);
 			}
 
+			static hsize_t getNumElements(const Container& src) { return src.size(); }
+
 			/**
-			 * Check if the type of the provided dataset and the container matches
-			 * @param src
+			 * Check if element type and rank of the provided dataset fit the container
 			 * @param dataSet
 			 * @param hdfMemLayout
-			 * @return
 			 */
-			static bool checkCompatibility(const Container& src, hid_t dataSet, hid_t hdfMemLayout) {
+			static void checkType(hid_t dataSet, hid_t hdfMemLayout) {
 				const size_t NumDims = 1;
 				// check if type of the target dataset and the one stored in this container matches
-				htri_t type = H5Tequal(DataType<ElementType>::hdfType(), H5Dget_type(dataSet));
+				hid_t fileType = H5Dget_type(dataSet);
+				htri_t type = H5Tequal(DataType<ElementType>::hdfType(), fileType);
+				H5Tclose(fileType);
 				if (type < 1) {
 					throw Exception("HDF5 and Container element type declaration does not match");
 				}
@@ -79,19 +143,27 @@ namespace hdf5 {
 				if ( (size_t)rank != NumDims) {
 					throw Exception("Rank of source and destination does not match! STL vectors are just of rank 1.");
 				}
+			}
+
+			/**
+			 * Check if the type of the provided dataset and the container matches
+			 * @param src
+			 * @param dataSet
+			 * @param hdfMemLayout
+			 * @return
+			 */
+			static bool checkCompatibility(const Container& src, hid_t dataSet, hid_t hdfMemLayout) {
+				const size_t NumDims = 1;
+				checkType(dataSet, hdfMemLayout);
 
 				// check dimensions
-				hsize_t* dims = new hsize_t[rank];
+				hsize_t dims[NumDims];
 				if (H5Sget_simple_extent_dims(hdfMemLayout, dims, 0) < 0) {
-					delete dims;
 					throw Exception("Could not retrieve size of dimensions");
 				}
 
 				bool sizeFit = dims[0] == src.size();
 
-				// freeing memory
-				free(dims);
-
 				if (!sizeFit) {
 					throw Exception("Dimensions between dataset and provided container does not match");
 				}
@@ -113,23 +185,37 @@ namespace hdf5 {
 					throw Exception("hdf5::ContainerInterface< std::vector<..> >::write(): Type compatibility check failed");
 				}
 
+				writeData(src, dataSet, DataType<ElementType>::hdfType());
+			}
+
+			/**
+			 * Writes the src container to the dataset without any validation
+			 * @param src Container to write
+			 * @param dataSet HDF5 identifier for the target dataset
+			 * @param memType HDF5 type of the elements in memory
+			 */
+			static void writeData(const Container& src, hid_t dataSet, hid_t memType) {
 				// check type of elements stored in container
 				if (DataType<ElementType>::isStructType() && !DataType<ElementType>::isPOD()) {
 					// ok that's no very efficient but we have to copy the elements twice
 					// firstly we have to get the POD equivalent of the source type and fill it
 					// before writing data out
 					typedef typename DataType<ElementType>::PODType POD;
-					typedef typename std::vector<POD> DstContainer;
 
 					size_t nElements = src.size();
-					DstContainer dst;
-					dst.resize(nElements);
+					ScratchBuffer<POD> dst(nElements);
 
-					for (size_t i = 0; i < nElements; ++i) {
-						DataType<ElementType>::assignToPOD(src[i], dst[i]);
+					{
+						IoTimer timer(IoConvertToPOD);
+						for (size_t i = 0; i < nElements; ++i) {
+							DataType<ElementType>::assignToPOD(src[i], dst[i]);
+						}
 					}
 
-					H5Dwrite(dataSet, DataType<ElementType>::hdfType(), H5S_ALL, H5S_ALL, H5P_DEFAULT, dst.data());
+					{
+						IoTimer timer(IoWrite, nElements * sizeof(POD));
+						H5Dwrite(dataSet, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, dst.get());
+					}
 
 					for (size_t i = 0; i < nElements; ++i) {
 						DataType<ElementType>::freePOD(dst[i]);
@@ -137,7 +223,8 @@ namespace hdf5 {
 				}
 				else {
 					// this allows simple write
-					H5Dwrite(dataSet, DataType<ElementType>::hdfType(), H5S_ALL, H5S_ALL, H5P_DEFAULT, src.data());
+					IoTimer timer(IoWrite, src.size() * sizeof(ElementType));
+					H5Dwrite(dataSet, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, src.data());
 				}
 
 			}
@@ -156,36 +243,251 @@ namespace hdf5 {
 					throw Exception("hdf5::ContainerInterface< std::vector<..> >::read(): Dimensions of HDF5 and target container does not match");
 				}
 
-				// resize vector to be fitting for data from file
-				hsize_t* dims = new hsize_t[NumDims];
-				H5Sget_simple_extent_dims(dataSpace, dims, 0);
-				dst.resize(dims[0]);
-				delete dims;
-
 				// checking compatibility of hdf5 target and the c++ src object
-				if (!checkCompatibility(dst, dataSet, dataSpace)) {
-					throw Exception("hdf5::ContainerInterface< std::vector<..> >::read(): Type compatibility check failed");
-				}
+				checkType(dataSet, dataSpace);
 
+				hsize_t dims[NumDims];
+				H5Sget_simple_extent_dims(dataSpace, dims, 0);
+				readData(dst, dataSet, DataType<ElementType>::hdfType(), dims);
+			}
+
+			/**
+			 * Reads the dataset into dst without any validation
+			 * @param dst Container to store the data from file
+			 * @param dataSet HDF5 identifier for the source dataset
+			 * @param memType HDF5 type of the elements in memory
+			 * @param dims Size of the dataset
+			 */
+			static void readData(Container& dst, hid_t dataSet, hid_t memType, const hsize_t* dims) {
+				// resize vector to be fitting for data from file
+				dst.resize(dims[0]);
 
 				// check type of elements stored in container
 				// data can only be read to a POD structure therefore with use this...
 				typedef typename DataType<ElementType>::PODType POD;
 
-				POD* rawData = (POD*) malloc( DataType<ElementType>::size() * dst.size());
-				herr_t status = H5Dread(dataSet, DataType<ElementType>::hdfType(), H5S_ALL, H5S_ALL, H5P_DEFAULT, rawData);
+				if (DataType<ElementType>::isPOD()) {
+					// memory layout of container and file type match, read in place
+					IoTimer timer(IoRead, DataType<ElementType>::size() * dst.size());
+					if (H5Dread(dataSet, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, dst.data()) < 0) {
+						throw Exception("hdf5::ContainerInterface< std::vector<..> >::read(): Error while reading data from file");
+					}
+					return;
+				}
+
+				ScratchBuffer<POD> rawData(dst.size());
+				herr_t status;
+				{
+					IoTimer timer(IoRead, DataType<ElementType>::size() * dst.size());
+					status = H5Dread(dataSet, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, rawData.get());
+				}
 				if (status < 0) {
-					free(rawData);
 					throw Exception("hdf5::ContainerInterface< std::vector<..> >::read(): Error while reading data from file");
 				}
 
+				IoTimer timer(IoConvertFromPOD);
 				for (size_t i = 0; i < dst.size(); ++i) {
 					// .. it target is not a POD we need to translate ..
 					DataType<ElementType>::assignFromPOD(rawData[i], dst[i]);
 					DataType<ElementType>::freePOD(rawData[i]);
 				}
+			}
+	};
+
+	/**
+	 * std::vector<std::vector<ElementType> > stored as rank 1 dataset of
+	 * variable length sequences, one per row. Every row is allocated
+	 * separately by the library on reading; for many rows
+	 * Group::createRaggedArray() stores them flattened with offsets instead.
+	 */
+	template<typename ElementType, typename RowAllocator, typename Allocator> struct ContainerInterface<std::vector<std::vector<ElementType, RowAllocator>, Allocator> > {
+			typedef typename std::vector<std::vector<ElementType, RowAllocator>, Allocator> Container;
+			typedef typename DataType<ElementType>::PODType POD;
+
+			static hid_t hdfElementType() { return H5Tvlen_create(DataType<ElementType>::hdfType()); }
+			static hid_t hdfSpace(const Container& src) {
+				hsize_t dims[] = { src.size(), };
+				return H5Screate_simple(1, dims, 0);
+			}
+
+			static hsize_t getNumElements(const Container& src) { return src.size(); }
+
+			/**
+			 * Check if element type and rank of the provided dataset fit the container
+			 * @param dataSet
+			 * @param hdfMemLayout
+			 */
+			static void checkType(hid_t dataSet, hid_t hdfMemLayout) {
+				const size_t NumDims = 1;
+				hid_t memType = hdfElementType();
+				hid_t fileType = H5Dget_type(dataSet);
+				htri_t type = H5Tequal(memType, fileType);
+				H5Tclose(fileType);
+				H5Tclose(memType);
+				if (type < 1) {
+					throw Exception("HDF5 and Container element type declaration does not match");
+				}
+
+				// check if rank matches
+				int rank = H5Sget_simple_extent_ndims(hdfMemLayout);
+				if (rank < 0) {
+					throw Exception("Could not get dimensionality of dataset");
+				}
+				if ( (size_t)rank != NumDims) {
+					throw Exception("Rank of source and destination does not match! Ragged arrays are just of rank 1.");
+				}
+			}
+
+			static bool checkCompatibility(const Container& src, hid_t dataSet, hid_t hdfMemLayout) {
+				const size_t NumDims = 1;
+				checkType(dataSet, hdfMemLayout);
+
+				// check dimensions
+				hsize_t dims[NumDims];
+				if (H5Sget_simple_extent_dims(hdfMemLayout, dims, 0) < 0) {
+					throw Exception("Could not retrieve size of dimensions");
+				}
+
+				if (dims[0] != src.size()) {
+					throw Exception("Dimensions between dataset and provided container does not match");
+				}
+
+				return true;
+			}
+
+			static void write(const Container& src, hid_t dataSet, hid_t dataSpace) {
+				// checking compatibility of hdf5 target and the c++ src object
+				if (!checkCompatibility(src, dataSet, dataSpace)) {
+					throw Exception("hdf5::ContainerInterface< std::vector<std::vector<..> > >::write(): Type compatibility check failed");
+				}
+
+				hid_t memType = hdfElementType();
+				try {
+					writeData(src, dataSet, memType);
+				}
+				catch (...) {
+					H5Tclose(memType);
+					throw;
+				}
+				H5Tclose(memType);
+			}
+
+			/**
+			 * Writes the src container to the dataset without any validation
+			 * @param src Container to write
+			 * @param dataSet HDF5 identifier for the target dataset
+			 * @param memType HDF5 type of the elements in memory
+			 */
+			static void writeData(const Container& src, hid_t dataSet, hid_t memType) {
+				size_t nRows = src.size();
+				ScratchBuffer<hvl_t> rows(nRows);
+
+				if (DataType<ElementType>::isPOD()) {
+					// the sequences point directly into the rows
+					hsize_t nBytes = 0;
+					for (size_t i = 0; i < nRows; ++i) {
+						rows[i].len = src[i].size();
+						rows[i].p = const_cast<ElementType*>(src[i].data());
+						nBytes += src[i].size() * sizeof(ElementType);
+					}
+					herr_t status;
+					{
+						IoTimer timer(IoWrite, nBytes);
+						status = H5Dwrite(dataSet, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, rows.get());
+					}
+					if (status < 0) {
+						throw Exception("hdf5::ContainerInterface< std::vector<std::vector<..> > >::write(): Error while writing data to file");
+					}
+					return;
+				}
+
+				// convert all elements into one buffer, the sequences point into it
+				size_t nElements = 0;
+				for (size_t i = 0; i < nRows; ++i) {
+					nElements += src[i].size();
+				}
+				ScratchBuffer<POD> values(nElements);
+				{
+					IoTimer timer(IoConvertToPOD);
+					size_t iValue = 0;
+					for (size_t i = 0; i < nRows; ++i) {
+						rows[i].len = src[i].size();
+						rows[i].p = &values[iValue];
+						for (size_t j = 0; j < src[i].size(); ++j, ++iValue) {
+							DataType<ElementType>::assignToPOD(src[i][j], values[iValue]);
+						}
+					}
+				}
+
+				herr_t status;
+				{
+					IoTimer timer(IoWrite, nElements * sizeof(POD));
+					status = H5Dwrite(dataSet, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, rows.get());
+				}
+
+				for (size_t i = 0; i < nElements; ++i) {
+					DataType<ElementType>::freePOD(values[i]);
+				}
+				if (status < 0) {
+					throw Exception("hdf5::ContainerInterface< std::vector<std::vector<..> > >::write(): Error while writing data to file");
+				}
+			}
+
+			static void read(Container& dst, hid_t dataSet, hid_t dataSpace) {
+				const size_t NumDims = 1;
+
+				if (static_cast<int>(NumDims) != H5Sget_simple_extent_ndims(dataSpace)) {
+					throw Exception("hdf5::ContainerInterface< std::vector<std::vector<..> > >::read(): Dimensions of HDF5 and target container does not match");
+				}
 
-				free(rawData);
+				// checking compatibility of hdf5 target and the c++ src object
+				checkType(dataSet, dataSpace);
+
+				hsize_t dims[NumDims];
+				H5Sget_simple_extent_dims(dataSpace, dims, 0);
+				hid_t memType = hdfElementType();
+				try {
+					readData(dst, dataSet, memType, dims);
+				}
+				catch (...) {
+					H5Tclose(memType);
+					throw;
+				}
+				H5Tclose(memType);
+			}
+
+			/**
+			 * Reads the dataset into dst without any validation, dst is
+			 * resized to the number of rows of the dataset
+			 * @param dst Container to store the data from file
+			 * @param dataSet HDF5 identifier for the source dataset
+			 * @param memType HDF5 type of the elements in memory
+			 * @param dims Size of the dataset
+			 */
+			static void readData(Container& dst, hid_t dataSet, hid_t memType, const hsize_t* dims) {
+				size_t nRows = dims[0];
+				ScratchBuffer<hvl_t> rows(nRows);
+				herr_t status;
+				{
+					// the sequences themselves are allocated by the library
+					IoTimer timer(IoRead, nRows * sizeof(hvl_t));
+					status = H5Dread(dataSet, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, rows.get());
+				}
+				if (status < 0) {
+					throw Exception("hdf5::ContainerInterface< std::vector<std::vector<..> > >::read(): Error while reading data from file");
+				}
+
+				// all sequences go back to the library, also if a conversion throws
+				VlenReclaimer reclaimer(memType, nRows, rows.get());
+				IoTimer timer(IoConvertFromPOD);
+				dst.resize(nRows);
+				for (size_t i = 0; i < nRows; ++i) {
+					POD* values = static_cast<POD*>(rows[i].p);
+					dst[i].resize(rows[i].len);
+					for (size_t j = 0; j < rows[i].len; ++j) {
+						DataType<ElementType>::assignFromPOD(values[j], dst[i][j]);
+					}
+				}
 			}
 	};
 
@@ -201,17 +503,19 @@ namespace hdf5 {
 				return H5Screate_simple(1, dims, 0);
 			}
 
+			static hsize_t getNumElements(const Container& src) { return src.size(); }
+
 			/**
-			 * Check if the type of the provided dataset and the container matches
-			 * @param src
+			 * Check if element type and rank of the provided dataset fit the container
 			 * @param dataSet
 			 * @param hdfMemLayout
-			 * @return
 			 */
-			static bool checkCompatibility(const Container& src, hid_t dataSet, hid_t hdfMemLayout) {
+			static void checkType(hid_t dataSet, hid_t hdfMemLayout) {
 				const size_t NumDims = 1;
 				// check if type of the target dataset and the one stored in this container matches
-				htri_t type = H5Tequal(DataType<ElementType>::hdfType(), H5Dget_type(dataSet));
+				hid_t fileType = H5Dget_type(dataSet);
+				htri_t type = H5Tequal(DataType<ElementType>::hdfType(), fileType);
+				H5Tclose(fileType);
 				if (type < 1) {
 					throw Exception("HDF5 and Container element type declaration does not match");
 				}
@@ -224,19 +528,27 @@ namespace hdf5 {
 				if ( (size_t)rank != NumDims) {
 					throw Exception("Rank of source and destination does not match! STL vectors are just of rank 1.");
 				}
+			}
+
+			/**
+			 * Check if the type of the provided dataset and the container matches
+			 * @param src
+			 * @param dataSet
+			 * @param hdfMemLayout
+			 * @return
+			 */
+			static bool checkCompatibility(const Container& src, hid_t dataSet, hid_t hdfMemLayout) {
+				const size_t NumDims = 1;
+				checkType(dataSet, hdfMemLayout);
 
 				// check dimensions
-				hsize_t* dims = new hsize_t[rank];
+				hsize_t dims[NumDims];
 				if (H5Sget_simple_extent_dims(hdfMemLayout, dims, 0) < 0) {
-					delete dims;
 					throw Exception("Could not retrieve size of dimensions");
 				}
 
 				bool sizeFit = dims[0] == src.size();
 
-				// freeing memory
-				free(dims);
-
 				if (!sizeFit) {
 					throw Exception("Dimensions between dataset and provided container does not match");
 				}
@@ -258,24 +570,39 @@ namespace hdf5 {
 					throw Exception("hdf5::ContainerInterface< std::list<..> >::write(): Type compatibility check failed");
 				}
 
+				writeData(src, dataSet, DataType<ElementType>::hdfType());
+			}
+
+			/**
+			 * Writes the src container to the dataset without any validation
+			 * @param src Container to write
+			 * @param dataSet HDF5 identifier for the target dataset
+			 * @param memType HDF5 type of the elements in memory
+			 */
+			static void writeData(const Container& src, hid_t dataSet, hid_t memType) {
 
 				// check type of elements stored in container
 				typedef typename DataType<ElementType>::PODType POD;
 				size_t nElements = src.size();
 				size_t item = 0;
-				POD* tmp = (POD*) malloc( DataType<ElementType>::size() * nElements);
+				ScratchBuffer<POD> tmp(nElements);
 
-				for (typename Container::const_iterator it = src.begin(); it != src.end(); ++it) {
-					DataType<ElementType>::assignToPOD(*it, tmp[item]);
-					++item;
+				{
+					IoTimer timer(IoConvertToPOD);
+					for (typename Container::const_iterator it = src.begin(); it != src.end(); ++it) {
+						DataType<ElementType>::assignToPOD(*it, tmp[item]);
+						++item;
+					}
 				}
 
-				H5Dwrite(dataSet, DataType<ElementType>::hdfType(), H5S_ALL, H5S_ALL, H5P_DEFAULT, tmp);
+				{
+					IoTimer timer(IoWrite, DataType<ElementType>::size() * nElements);
+					H5Dwrite(dataSet, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, tmp.get());
+				}
 
 				for (size_t i = 0; i < item; ++i) {
 					DataType<POD>::freePOD(tmp[i]);
 				}
-				free(tmp);
 			}
 
 			/**
@@ -292,32 +619,50 @@ namespace hdf5 {
 					throw Exception("hdf5::ContainerInterface< std::list<..> >::read(): Dimensions of HDF5 and target container does not match");
 				}
 
-				// resize vector to be fitting for data from file
-				hsize_t* dims = new hsize_t[NumDims];
+				// checking compatibility of hdf5 target and the c++ src object
+				checkType(dataSet, dataSpace);
+
+				hsize_t dims[NumDims];
 				H5Sget_simple_extent_dims(dataSpace, dims, 0);
-				size_t nElements = dst.resize(dims[0]);
-				delete dims;
+				readData(dst, dataSet, DataType<ElementType>::hdfType(), dims);
+			}
 
+			/**
+			 * Reads the dataset into dst without any validation
+			 * @param dst Container to store the data from file
+			 * @param dataSet HDF5 identifier for the source dataset
+			 * @param memType HDF5 type of the elements in memory
+			 * @param dims Size of the dataset
+			 */
+			static void readData(Container& dst, hid_t dataSet, hid_t memType, const hsize_t* dims) {
+				size_t nElements = dims[0];
 
 				// check type of elements stored in container
 				// data can only be read to a POD structure therefore with use this...
 				typedef typename DataType<ElementType>::PODType POD;
 
-				POD* rawData = (POD*) malloc( DataType<ElementType>::size() * dst.size());
-				herr_t status = H5Dread(dataSet, DataType<ElementType>::hdfType(), H5S_ALL, H5S_ALL, H5P_DEFAULT, rawData);
+				ScratchBuffer<POD> rawData(nElements);
+				herr_t status;
+				{
+					IoTimer timer(IoRead, DataType<ElementType>::size() * nElements);
+					status = H5Dread(dataSet, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, rawData.get());
+				}
 				if (status < 0) {
-					free(rawData);
-					throw Exception("hdf5::ContainerInterface< std::vector<..> >::read(): Error while reading data from file");
+					throw Exception("hdf5::ContainerInterface< std::list<..> >::read(): Error while reading data from file");
 				}
 
-				for (size_t i = 0; i < dst.size(); ++i) {
-					ElementType tmp;
-					DataType<ElementType>::assignFromPOD(rawData[i], tmp);
+				// existing nodes are overwritten, so rereading a list of the same length does not allocate
+				IoTimer timer(IoConvertFromPOD);
+				typename Container::iterator it = dst.begin();
+				for (size_t i = 0; i < nElements; ++i) {
+					if (it == dst.end()) {
+						it = dst.insert(it, ElementType());
+					}
+					DataType<ElementType>::assignFromPOD(rawData[i], *it);
 					DataType<ElementType>::freePOD(rawData[i]);
-					dst.push_back(tmp);
+					++it;
 				}
-
-				free(rawData);
+				dst.erase(it, dst.end());
 			}
 	};
 
@@ -344,9 +689,14 @@ namespace hdf5 {
 			static void assignFromPOD(const PODType& in, ElementType& out) {};
 	};
 
-	template<typename Key, typename Value, typename Compare, typename Allocator> struct ContainerInterface< std::map<Key, Value, Compare, Allocator> > {
-			typedef typename std::map<Key, Value, Compare, Allocator> Container;
-//			typedef POD_STL_MAP<Key, Value> Element;
+	/**
+	 * Conversion of containers of key/value pairs, stored as compound of
+	 * "Key" and "Value" in the order of the container. The specializations
+	 * below only differ in how entries are put into the container on reading,
+	 * read() dispatches to ContainerInterface<Container>::readData().
+	 */
+	template<typename ContainerType, typename Key, typename Value> struct KeyValueInterface {
+			typedef ContainerType Container;
 
 			// POD Types for storage
 			typedef typename DataType<Key>::PODType KeyPOD;
@@ -359,10 +709,21 @@ namespace hdf5 {
 				return H5Screate_simple(1, dims, 0);
 			}
 
-			static bool checkCompatibility(const Container& src, hid_t dataSet, hid_t hdfMemLayout, bool sizeTest = true) {
+			static hsize_t getNumElements(const Container& src) { return src.size(); }
+
+			/**
+			 * Check if element type and rank of the provided dataset fit the container
+			 * @param dataSet
+			 * @param hdfMemLayout
+			 */
+			static void checkType(hid_t dataSet, hid_t hdfMemLayout) {
 				const size_t NumDims = 1;
 				// check if type of the target dataset and the one stored in this container matches
-				htri_t type = H5Tequal(DataType<ElementPOD>::hdfType(), H5Dget_type(dataSet));
+				hid_t memType = DataType<ElementPOD>::hdfType();
+				hid_t fileType = H5Dget_type(dataSet);
+				htri_t type = H5Tequal(memType, fileType);
+				H5Tclose(fileType);
+				H5Tclose(memType);
 				if (type < 1) {
 					throw Exception("HDF5 and Container element type declaration does not match");
 				}
@@ -375,20 +736,21 @@ namespace hdf5 {
 				if ( (size_t)rank != NumDims) {
 					throw Exception("Rank of source and destination does not match! STL vectors are just of rank 1.");
 				}
+			}
+
+			static bool checkCompatibility(const Container& src, hid_t dataSet, hid_t hdfMemLayout) {
+				const size_t NumDims = 1;
+				checkType(dataSet, hdfMemLayout);
 
 				// check dimensions
-				hsize_t* dims = new hsize_t[rank];
+				hsize_t dims[NumDims];
 				if (H5Sget_simple_extent_dims(hdfMemLayout, dims, 0) < 0) {
-					delete dims;
 					throw Exception("Could not retrieve size of dimensions");
 				}
 
 				bool sizeFit = dims[0] == src.size();
 
-				// freeing memory
-				free(dims);
-
-				if (!sizeFit && sizeTest) {
+				if (!sizeFit) {
 					throw Exception("Dimensions between dataset and provided container does not match");
 				}
 
@@ -398,27 +760,36 @@ namespace hdf5 {
 			static void write(const Container& src, hid_t dataSet, hid_t dataSpace) {
 				// checking compatibility of hdf5 target and the c++ src object
 				if (!checkCompatibility(src, dataSet, dataSpace)) {
-					throw Exception("hdf5::ContainerInterface< std::map<..> >::write(): Type compatibility check failed");
+					throw Exception("hdf5::KeyValueInterface<..>::write(): Type compatibility check failed");
 				}
 
-				ElementPOD* buffer = (ElementPOD*) malloc(src.size() * DataType<ElementPOD>::size());
+				writeData(src, dataSet, DataType<ElementPOD>::hdfType());
+			}
+
+			static void writeData(const Container& src, hid_t dataSet, hid_t memType) {
+				ScratchBuffer<ElementPOD> buffer(src.size());
 
 				size_t iBuf = 0;
-				for (typename Container::const_iterator it = src.begin(); it != src.end(); ++it) {
-					DataType<Key>::assignToPOD(it->first, buffer[iBuf].k);
-					DataType<Value>::assignToPOD(it->second, buffer[iBuf].v);
+				{
+					IoTimer timer(IoConvertToPOD);
+					for (typename Container::const_iterator it = src.begin(); it != src.end(); ++it) {
+						DataType<Key>::assignToPOD(it->first, buffer[iBuf].k);
+						DataType<Value>::assignToPOD(it->second, buffer[iBuf].v);
 
-					++iBuf;
+						++iBuf;
+					}
 				}
 
-				H5Dwrite(dataSet, DataType<ElementPOD>::hdfType(), H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer);
+				{
+					IoTimer timer(IoWrite, src.size() * DataType<ElementPOD>::size());
+					H5Dwrite(dataSet, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.get());
+				}
 
 				// first free POD if necessary (will be handled by each type handler)
 				for (size_t i = 0; i < iBuf; ++i) {
 					DataType<Key>::freePOD(buffer[i].k);
 					DataType<Value>::freePOD(buffer[i].v);
 				}
-				free(buffer);
 			}
 
 			static void read(Container& dst, hid_t dataSet, hid_t dataSpace) {
@@ -426,48 +797,138 @@ namespace hdf5 {
 //				std::cout << "hdf5::ContainerInterface< std::mapr<..> >::read()" << std::endl;
 
 				if (static_cast<int>(NumDims) != H5Sget_simple_extent_ndims(dataSpace)) {
-					throw Exception("hdf5::ContainerInterface< std::map<..> >::read(): Dimensions of HDF5 and target container does not match");
+					throw Exception("hdf5::KeyValueInterface<..>::read(): Dimensions of HDF5 and target container does not match");
 				}
 
-				// resize vector to be fitting for data from file
-				hsize_t* dims = new hsize_t[NumDims];
+				// checking compatibility of hdf5 target and the c++ src object
+				checkType(dataSet, dataSpace);
+
+				hsize_t dims[NumDims];
 				H5Sget_simple_extent_dims(dataSpace, dims, 0);
+				hid_t memType = DataType<ElementPOD>::hdfType();
+				try {
+					ContainerInterface<Container>::readData(dst, dataSet, memType, dims);
+				}
+				catch (...) {
+					H5Tclose(memType);
+					throw;
+				}
+				H5Tclose(memType);
+			}
+
+			/**
+			 * Reads the dataset into an associative container without any
+			 * validation, existing entries with other keys are kept
+			 * @param dst Container to store the data from file
+			 * @param dataSet HDF5 identifier for the source dataset
+			 * @param memType HDF5 type of the elements in memory
+			 * @param dims Size of the dataset
+			 */
+			static void readData(Container& dst, hid_t dataSet, hid_t memType, const hsize_t* dims) {
 				size_t nElements = dims[0];
-				delete dims;
+				ScratchBuffer<ElementPOD> buffer(nElements);
+				readBuffer(buffer, dataSet, memType, nElements);
 
-				// checking compatibility of hdf5 target and the c++ src object
-				if (!checkCompatibility(dst, dataSet, dataSpace, false)) {
-					throw Exception("hdf5::ContainerInterface< std::map<..> >::read(): Type compatibility check failed");
+				IoTimer timer(IoConvertFromPOD);
+				typename Container::iterator next = dst.begin();
+				for (size_t i = 0; i < nElements; ++i) {
+					Key k;
+					Value v;
+					DataType<Key>::assignFromPOD(buffer[i].k, k);
+					DataType<Value>::assignFromPOD(buffer[i].v, v);
+					insertEntry(dst, next, k, v);
+
+					DataType<Key>::freePOD(buffer[i].k);
+					DataType<Value>::freePOD(buffer[i].v);
 				}
+			}
 
-				// check if key or value is not a POD
+		protected:
+			/// reads all nElements entries of the dataset into buffer
+			static void readBuffer(const ScratchBuffer<ElementPOD>& buffer, hid_t dataSet, hid_t memType, size_t nElements) {
+				// variable length members are allocated by the library, the buffer only holds the fixed part
 				hsize_t normalLen = nElements * DataType<ElementPOD>::size();
-				hsize_t variableLen;
-				herr_t status = H5Dvlen_get_buf_size(dataSet, DataType<ElementPOD>::hdfType(), dataSpace, &variableLen);
+				herr_t status;
+				{
+					IoTimer timer(IoRead, normalLen);
+					status = H5Dread(dataSet, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.get());
+				}
 				if (status < 0) {
-					throw Exception("hdf5::ContainerInterface< std::map<..> >::read(): Error while determining necessary memory buffer size");
+					throw Exception("hdf5::KeyValueInterface<..>::read(): Error while reading data from file");
 				}
+			}
 
-				ElementPOD* buffer = (ElementPOD*) malloc( std::max(variableLen, normalLen) );
-				status = H5Dread(dataSet, DataType<ElementPOD>::hdfType(), H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer);
-				if (status < 0) {
-					free(buffer);
-					throw Exception("hdf5::ContainerInterface< std::map<..> >::read(): Error while reading data from file");
+			/**
+			 * Inserts or replaces the entry k, next is the position behind the
+			 * previously inserted entry. Entries arriving in key order, as
+			 * written from a map, are inserted or replaced right there in
+			 * constant time.
+			 */
+			static void insertEntry(Container& dst, typename Container::iterator& next, Key& k, Value& v) {
+				typename Container::key_compare compare = dst.key_comp();
+				if (next != dst.end() && !compare(k, next->first) && !compare(next->first, k)) {
+					// rereading the keys already in the container
+					next->second = std::move(v);
+					++next;
+					return;
+				}
+				if ( !( (next == dst.end() || compare(k, next->first)) && (next == dst.begin() || compare(boost::prior(next)->first, k)) ) ) {
+					next = dst.lower_bound(k);
+					if (next != dst.end() && !compare(k, next->first)) {
+						next->second = std::move(v);
+						++next;
+						return;
+					}
 				}
+				next = dst.emplace_hint(next, std::move(k), std::move(v));
+				++next;
+			}
+	};
+
+	template<typename Key, typename Value, typename Compare, typename Allocator> struct ContainerInterface< std::map<Key, Value, Compare, Allocator> >:
+			public KeyValueInterface<std::map<Key, Value, Compare, Allocator>, Key, Value> {
+	};
+
+	template<typename Key, typename Value, typename Compare, typename Allocator> struct ContainerInterface< boost::container::flat_map<Key, Value, Compare, Allocator> >:
+			public KeyValueInterface<boost::container::flat_map<Key, Value, Compare, Allocator>, Key, Value> {
+			typedef KeyValueInterface<boost::container::flat_map<Key, Value, Compare, Allocator>, Key, Value> Base;
+			typedef typename Base::Container Container;
+
+			static void readData(Container& dst, hid_t dataSet, hid_t memType, const hsize_t* dims) {
+				dst.reserve(dst.size() + dims[0]);
+				Base::readData(dst, dataSet, memType, dims);
+			}
+	};
+
+	/**
+	 * A vector of pairs is read like a map, in the order of the dataset. The
+	 * vector has to be sorted by key when written for the dataset to be
+	 * usable as map.
+	 */
+	template<typename Key, typename Value, typename Allocator> struct ContainerInterface< std::vector<std::pair<Key, Value>, Allocator> >:
+			public KeyValueInterface<std::vector<std::pair<Key, Value>, Allocator>, Key, Value> {
+			typedef KeyValueInterface<std::vector<std::pair<Key, Value>, Allocator>, Key, Value> Base;
+			typedef typename Base::Container Container;
+			typedef typename Base::ElementPOD ElementPOD;
+
+			/**
+			 * Reads the dataset into dst without any validation, dst is
+			 * resized to the size of the dataset
+			 */
+			static void readData(Container& dst, hid_t dataSet, hid_t memType, const hsize_t* dims) {
+				size_t nElements = dims[0];
+				ScratchBuffer<ElementPOD> buffer(nElements);
+				Base::readBuffer(buffer, dataSet, memType, nElements);
 
+				IoTimer timer(IoConvertFromPOD);
+				dst.resize(nElements);
 				for (size_t i = 0; i < nElements; ++i) {
-					Key k;
-					Value v;
-					DataType<Key>::assignFromPOD(buffer[i].k, k);
-					DataType<Value>::assignFromPOD(buffer[i].v, v);
-					dst[k] = v;
+					DataType<Key>::assignFromPOD(buffer[i].k, dst[i].first);
+					DataType<Value>::assignFromPOD(buffer[i].v, dst[i].second);
 
 					DataType<Key>::freePOD(buffer[i].k);
 					DataType<Value>::freePOD(buffer[i].v);
 				}
-
-//				std::cout << "ContainerInterface< std::map<Key, Value, ..> >::read(..): freeing buffer" << std::endl;
-				free(buffer);
 			}
 	};
 
@@ -480,20 +941,16 @@ namespace hdf5 {
 
 		static hid_t hdfSpace(const Container& src) {
 //			std::cout << "  ContainerInterface<boost::multi_array...>::hdfSpace(): Rank=" << NumDims << std::endl;
-			hsize_t* dims = new hsize_t[NumDims];
-			hsize_t* maxDims = new hsize_t[NumDims];
+			hsize_t dims[NumDims];
 			for (size_t i = 0; i < NumDims; ++i) {
 				dims[i] = src.shape()[i];
-				maxDims[i] = H5S_UNLIMITED;
+//				maxDims[i] = H5S_UNLIMITED;
 
 //				std::cout << "  ContainerInterface<boost::multi_array...>::hdfSpace(): dims[" << i << "]=" << dims[i] << ", maxDims[" << i << "]=" << maxDims[i] << std::endl;
 			}
 			// H5S_UNLIMITED leads to HDF5 C lib errors therefore currently only fixed size is supported
 			hid_t spaceId = H5Screate_simple(NumDims, dims, 0);
 
-			free(maxDims);
-			free(dims);
-
 //			std::cout << "  ContainerInterface<boost::multi_array...>::hdfSpace(): spaceId=" << spaceId << std::endl;
 			return spaceId;
 		}
@@ -509,6 +966,11 @@ namespace hdf5 {
 			return dimXX;
 		}
 
+		/// true if the i-th element in C order is data()[i]
+		static bool isCOrder(const Container& src) {
+			return src.storage_order() == boost::general_storage_order<NumDims>(boost::c_storage_order());
+		}
+
 		static Coordinate getArrayCoordinate(const Container& src, size_t i) {
 			Coordinate x(NumDims);
 			size_t iBackup = i;
@@ -526,6 +988,24 @@ namespace hdf5 {
 			return x;
 		}
 
+		static hsize_t getNumElements(const Container& src) { return src.num_elements(); }
+
+		/**
+		 * Check if the rank of the provided dataset fits the container
+		 * @param dataSet
+		 * @param hdfMemLayout
+		 */
+		static void checkType(hid_t dataSet, hid_t hdfMemLayout) {
+			// check if rank matches
+			int rank = H5Sget_simple_extent_ndims(hdfMemLayout);
+			if (rank < 0) {
+				throw Exception("Could not get dimensionality of dataset");
+			}
+			if ( (size_t)rank != NumDims) {
+				throw Exception("Rank of source and destination does not match!");
+			}
+		}
+
 		static bool checkCompatibility(const Container& src, hid_t dataSet, hid_t hdfMemLayout) {
 			using namespace std;
 			// type match
@@ -565,19 +1045,11 @@ namespace hdf5 {
 //				throw Exception("HDF5 and Container element type declaration does not match");
 //			}
 
-			// check if rank matches
-			int rank = H5Sget_simple_extent_ndims(hdfMemLayout);
-			if (rank < 0) {
-				throw Exception("Could not get dimensionality of dataset");
-			}
-			if ( (size_t)rank != NumDims) {
-				throw Exception("Rank of source and destination does not match!");
-			}
+			checkType(dataSet, hdfMemLayout);
 
 			// check dimensions
-			hsize_t* dims = new hsize_t[rank];
+			hsize_t dims[NumDims];
 			if (H5Sget_simple_extent_dims(hdfMemLayout, dims, 0) < 0) {
-				delete dims;
 				throw Exception("Could not retrieve size of dimension");
 			}
 
@@ -586,9 +1058,6 @@ namespace hdf5 {
 				sizeFit &= (dims[iDim] == src.shape()[iDim]);
 			}
 
-			// freeing memory
-			free(dims);
-
 			if (!sizeFit) {
 				throw Exception("Dimensions between dataset and provided container does not match");
 			}
@@ -609,39 +1078,55 @@ namespace hdf5 {
 				throw Exception("ContainerInterface< boost::multi_array<...> >::write(): Type compatibility check failed");
 			}
 
+			writeData(src, ds, DataType<ElementType>::hdfType());
+		}
+
+		/**
+		 * Writes the src container to the dataset without any validation
+		 * @param src Container to write
+		 * @param ds HDF5 identifier for the target dataset
+		 * @param memType HDF5 type of the elements in memory
+		 */
+		static void writeData(const Container& src, hid_t ds, hid_t memType) {
 			// check DataType
 			if (DataType<ElementType>::isStructType() && !DataType<ElementType>::isPOD()) {
 				// ok that's no very efficient but we have to copy the elements twice
 				// firstly we have to get the POD equivalent of the source type and fill it
 				// before writing data out
 				typedef typename DataType<ElementType>::PODType POD;
-				typedef typename boost::multi_array<POD, NumDims> DstContainer;
-
-				size_t nElements = 1.;
-				Coordinate dim = getArrayExtents(src, nElements);
 
-				// this relies on a fitting copy constructor
-				// otherwise e.g. gcc would also perform on non-pod but other compilers
-				// fail because it is not standard compliant
-				DstContainer dst;
-				dst.resize(dim);
+				size_t nElements = src.num_elements();
+				ScratchBuffer<POD> dst(nElements);
 
-				// assuming c-data order
-				for (size_t i = 0; i < nElements; ++i) {
-					Coordinate x = getArrayCoordinate(src, i);
-					DataType<ElementType>::assignToPOD(src(x), dst(x));
+				// the file is in c-data order
+				{
+					IoTimer timer(IoConvertToPOD);
+					if (isCOrder(src)) {
+						for (size_t i = 0; i < nElements; ++i) {
+							DataType<ElementType>::assignToPOD(src.data()[i], dst[i]);
+						}
+					}
+					else {
+						for (size_t i = 0; i < nElements; ++i) {
+							Coordinate x = getArrayCoordinate(src, i);
+							DataType<ElementType>::assignToPOD(src(x), dst[i]);
+						}
+					}
 				}
 
-				H5Dwrite(ds, DataType<ElementType>::hdfType(), H5S_ALL, H5S_ALL, H5P_DEFAULT, dst.data());
+				{
+					IoTimer timer(IoWrite, nElements * sizeof(POD));
+					H5Dwrite(ds, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, dst.get());
+				}
 
 				for (size_t i = 0; i < nElements; ++i) {
-					Coordinate x = getArrayCoordinate(src, i);
-					DataType<POD>::freePOD(dst(x));
+					DataType<POD>::freePOD(dst[i]);
 				}
 			}
 			else {
 				// this allows simple write
-				H5Dwrite(ds, DataType<ElementType>::hdfType(), H5S_ALL, H5S_ALL, H5P_DEFAULT, src.data());
+				IoTimer timer(IoWrite, src.num_elements() * sizeof(ElementType));
+				H5Dwrite(ds, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, src.data());
 			}
 		};
 
@@ -656,43 +1141,63 @@ namespace hdf5 {
 			if (NumDims != H5Sget_simple_extent_ndims(space)) {
 				throw Exception("ContainerInterface< boost::multi_array<...> >::read(): Dimensions of HDF5 and target container does not match");
 			}
-			Coordinate dimXX(NumDims);
+			checkType(ds, space);
+
+			hsize_t dims[NumDims];
+			H5Sget_simple_extent_dims(space, dims, 0);
+			readData(dst, ds, DataType<ElementType>::hdfType(), dims);
+		}
+
+		/**
+		 * Reads the dataset into dst without any validation
+		 * @param dst Container to store the data from file
+		 * @param ds HDF5 identifier for the source dataset
+		 * @param memType HDF5 type of the elements in memory
+		 * @param dims Size of all dimensions of the dataset
+		 */
+		static void readData(Container& dst, hid_t ds, hid_t memType, const hsize_t* dims) {
+			boost::array<size_t, NumDims> dimXX;
 			size_t nElements = 1.;
-			{
-				hsize_t* dims = new hsize_t[NumDims];
-				H5Sget_simple_extent_dims(space, dims, 0);
-				for (hsize_t iDim = 0; iDim < NumDims; ++iDim) {
-					dimXX[iDim] = static_cast<size_t>(dims[iDim]);
-					nElements *= dims[iDim];
-				}
-				delete dims;
+			for (hsize_t iDim = 0; iDim < NumDims; ++iDim) {
+				dimXX[iDim] = static_cast<size_t>(dims[iDim]);
+				nElements *= dims[iDim];
 			}
-			// resize multi_array according to source dimensions
-			dst.resize(dimXX);
-
-			if (!checkCompatibility(dst, ds, space)) {
-				throw Exception("ContainerInterface< boost::multi_array<...> >::read(): Type compatibility check failed");
+			// resize multi_array according to source dimensions, resize() always reallocates
+			if (!std::equal(dimXX.begin(), dimXX.end(), dst.shape())) {
+				dst.resize(dimXX);
 			}
 
 			// check type of elements stored in container
 			// data can only be read to a POD structure therefore with use this...
 			typedef typename DataType<ElementType>::PODType POD;
 
-			POD* rawData = (POD*) malloc( DataType<ElementType>::size() * nElements);
-			herr_t status = H5Dread(ds, DataType<ElementType>::hdfType(), H5S_ALL, H5S_ALL, H5P_DEFAULT, rawData);
+			bool cOrder = isCOrder(dst);
+			if (DataType<ElementType>::isPOD() && cOrder) {
+				// memory layout of container and file type match, read in place
+				IoTimer timer(IoRead, DataType<ElementType>::size() * nElements);
+				if (H5Dread(ds, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, dst.data()) < 0) {
+					throw Exception("hdf5::ContainerInterface< boost::multi_array<..> >::read(): Error while reading data from file");
+				}
+				return;
+			}
+
+			ScratchBuffer<POD> rawData(nElements);
+			herr_t status;
+			{
+				IoTimer timer(IoRead, DataType<ElementType>::size() * nElements);
+				status = H5Dread(ds, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, rawData.get());
+			}
 			if (status < 0) {
-				free(rawData);
 				throw Exception("hdf5::ContainerInterface< boost::multi_array<..> >::read(): Error while reading data from file");
 			}
 
+			// the file is in c-data order
+			IoTimer timer(IoConvertFromPOD);
 			for (size_t i = 0; i < nElements; ++i) {
-				// assuming c-data order
-				Coordinate x = getArrayCoordinate(dst, i);
-				DataType<ElementType>::assignFromPOD(rawData[i], dst(x));
+				ElementType& element = cOrder ? dst.data()[i] : dst(getArrayCoordinate(dst, i));
+				DataType<ElementType>::assignFromPOD(rawData[i], element);
 				DataType<ElementType>::freePOD(rawData[i]);
 			}
-
-			free(rawData);
 		}
 	};
 };
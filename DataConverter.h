@@ -56,6 +56,7 @@ namespace hdf5 {
 			static hid_t isStructType() { return true; }
 			static hid_t isPOD() { return false; }
 			static hsize_t size() { return sizeof(PODType); }
+			static void freePOD(PODType& pod) {};
 			static void assignToPOD(const ElementType& in, PODType& out) {
 				out.X = in.getX();
 				out.Y = in.getY();
@@ -106,7 +106,7 @@ namespace hdf5 {
 	template<> struct DataType<float> {
 			typedef float ElementType;
 			typedef float PODType;
-			inline static hid_t hdfType() { return H5T_C_S1; }
+			inline static hid_t hdfType() { return H5T_NATIVE_FLOAT; }
 			inline static hid_t isStructType() { return false; }
 			inline static hid_t isPOD() { return true; }
 			inline static hsize_t size() { return sizeof(ElementType); }
@@ -208,6 +208,7 @@ namespace hdf5 {
 			typedef uint32_t ElementType;
 			typedef uint32_t PODType;
 			inline static hid_t hdfType() { return H5T_NATIVE_UINT; }
+			inline static hid_t isStructType() { return false; }
 			inline static hid_t isPOD() { return true; }
 			inline static hsize_t size() { return sizeof(ElementType); }
 			inline static void freePOD(PODType& pod) {};
@@ -8,13 +8,14 @@
 #include "Dataset.h"
 #include "Exception.h"
 #include <iostream>
+#include <sstream>
 #include "hdfLLReading.h"
 
 using namespace std;
 namespace hdf5
 {
 
-	Dataset::Dataset()
+	Dataset::Dataset(): fStatistics(0)
 	{
 		// TODO Auto-generated constructor stub
 		fType = ObjectType::Dataset;
@@ -22,44 +23,174 @@ namespace hdf5
 
 	Dataset::~Dataset()
 	{
-		H5Sclose(fSpace);
-		H5Dclose(fObjectId);
+		try {
+			flushAttributes();
+		}
+		catch (const Exception& e) {
+			cerr << "Dataset::~Dataset(): " << e.what() << endl;
+		}
+		delete fStatistics.load();
+	}
+
+	std::vector<size_t> Dataset::getExtents() const
+	{
+		return std::vector<size_t>(fInfo.shape.begin(), fInfo.shape.end());
+	}
+
+	void Dataset::refresh()
+	{
+		fInfo = DatasetInfo(getIdentifier());
+	}
+
+	IoStatistics* Dataset::getFileStatistics() const
+	{
+		return fHandle ? &fHandle->getManager()->getStatistics() : 0;
+	}
+
+	IoStatistics* Dataset::getDatasetStatistics() const
+	{
+		IoStatistics* statistics = fStatistics.load(std::memory_order_acquire);
+		if (statistics == 0) {
+			// a single slot is enough, datasets are rarely used by many threads at once
+			IoStatistics* created = new IoStatistics(1);
+			if (fStatistics.compare_exchange_strong(statistics, created)) {
+				statistics = created;
+			}
+			else {
+				delete created;
+			}
+		}
+		return statistics;
+	}
+
+	IoSummary Dataset::getStatistics() const
+	{
+		IoStatistics* statistics = fStatistics.load(std::memory_order_acquire);
+		IoSummary summary = statistics ? statistics->getSummary() : IoSummary();
+
+		hid_t dataSet = getIdentifier();
+		hid_t plist = H5Dget_create_plist(dataSet);
+		if (plist > -1) {
+			H5D_layout_t layout = H5Pget_layout(plist);
+			H5Pclose(plist);
+			hid_t dapl = H5Dget_access_plist(dataSet);
+			if (layout == H5D_CHUNKED && dapl > -1) {
+				size_t nSlots, nBytes;
+				double w0;
+				if (H5Pget_chunk_cache(dapl, &nSlots, &nBytes, &w0) > -1) {
+					summary.chunkCacheSlots = nSlots;
+					summary.chunkCacheBytes = nBytes;
+					summary.chunkCachePreemption = w0;
+				}
+			}
+			if (dapl > -1) {
+				H5Pclose(dapl);
+			}
+		}
+		return summary;
+	}
+
+	void Dataset::resetStatistics()
+	{
+		IoStatistics* statistics = fStatistics.load(std::memory_order_acquire);
+		if (statistics) {
+			statistics->reset();
+		}
+	}
+
+	void Dataset::setScratchAllocator(const ScratchAllocator::Ptr& allocator)
+	{
+		fScratchAllocator = allocator;
 	}
 
-	size_t Dataset::getRank() const
+	ScratchAllocator* Dataset::getScratchAllocator() const
 	{
-		int a = H5Sget_simple_extent_ndims(fSpace);
-		if (a < 0) {
-			throw Exception("Could not get dimensionality of dataset");
+		if (fScratchAllocator) {
+			return fScratchAllocator.get();
+		}
+		if (fHandle) {
+			return &fHandle->getManager()->getScratchPool();
 		}
-		return static_cast<size_t>(a);
+		return getDefaultScratchAllocator().get();
 	}
 
-	size_t Dataset::getDimension(size_t dim) const
+	MappedRegion::Ptr Dataset::mapRawData(hid_t memType, bool writable) const
 	{
-		if (dim >= getRank()) {
-			throw Exception("The requested dimension is out-of-range");
+		// layout and filters
+		hid_t dataSet = getIdentifier();
+		hid_t plist = H5Dget_create_plist(dataSet);
+		if (plist < 0) {
+			throw Exception("Dataset::map(): Could not retrieve creation properties of dataset '" + fName + "'");
+		}
+		H5D_layout_t layout = H5Pget_layout(plist);
+		int nFilters = H5Pget_nfilters(plist);
+		int nExternal = H5Pget_external_count(plist);
+		H5Pclose(plist);
+
+		if (layout != H5D_CONTIGUOUS) {
+			throw Exception("Dataset::map(): Dataset '" + fName + "' is not stored contiguously (chunked and compact layouts cannot be mapped)");
+		}
+		if (nFilters != 0) {
+			throw Exception("Dataset::map(): Dataset '" + fName + "' uses filters, filtered data cannot be mapped");
+		}
+		if (nExternal != 0) {
+			throw Exception("Dataset::map(): Dataset '" + fName + "' is stored in external files");
+		}
+
+		// element type
+		hid_t fileType = H5Dget_type(dataSet);
+		htri_t typeMatch = H5Tequal(memType, fileType);
+		H5Tclose(fileType);
+		if (typeMatch < 1) {
+			throw Exception("Dataset::map(): Type of dataset '" + fName + "' does not match the requested native type");
+		}
+
+		// the file driver must store the HDF5 address space 1:1 in a single file
+		hid_t fileId = H5Iget_file_id(dataSet);
+		hid_t fapl = H5Fget_access_plist(fileId);
+		hid_t driver = H5Pget_driver(fapl);
+		H5Pclose(fapl);
+		if (driver != H5FD_SEC2) {
+			H5Fclose(fileId);
+			throw Exception("Dataset::map(): Only files opened with the default (sec2) driver can be mapped");
 		}
 
-		hsize_t* dims = new hsize_t[getRank()];
-		if (H5Sget_simple_extent_dims(fSpace, dims, 0) < 0) {
-			delete dims;
-			throw Exception("Could not retrieve size of dimension");
+		// bring file and raw data buffers in sync with the storage
+		unsigned int intent;
+		if (H5Fget_intent(fileId, &intent) > -1 && intent != H5F_ACC_RDONLY) {
+			H5Fflush(fileId, H5F_SCOPE_LOCAL);
 		}
-		size_t res = static_cast<size_t>(dims[dim]);
-		delete dims;
-		return res;
+
+		ssize_t nameLen = H5Fget_name(fileId, 0, 0);
+		std::vector<char> fileName(nameLen > 0 ? nameLen + 1 : 1, 0);
+		if (nameLen > 0) {
+			H5Fget_name(fileId, &fileName[0], fileName.size());
+		}
+		H5Fclose(fileId);
+
+		haddr_t offset = H5Dget_offset(dataSet);
+		if (offset == HADDR_UNDEF) {
+			throw Exception("Dataset::map(): Storage of dataset '" + fName + "' has not been allocated");
+		}
+		hsize_t storageSize = H5Dget_storage_size(dataSet);
+
+		return MappedRegion::Ptr(new MappedRegion(std::string(&fileName[0]), offset, static_cast<size_t>(storageSize), writable));
 	}
 
-	Dataset::Dataset(hid_t objectId, const std::string& name)
+	Dataset::Dataset(const ObjectHandle::Ptr& handle, const std::string& name): fStatistics(0)
 	{
 		fName = name;
 		fType = Object::ObjectType::Dataset;
-		fObjectId = objectId;
-		fSpace = H5Dget_space(fObjectId);
-		if (objectId > -1) {
-			updateAttributes();
+		fHandle = handle;
+
+		try {
+			fInfo = DatasetInfo(fHandle->get());
 		}
+		catch (const Exception& e) {
+			throw Exception("Could not read metadata of dataset '" + name + "': " + e.what());
+		}
+
+		updateAttributes();
 
 //		updateDataset(objectId);
 	}
@@ -10,7 +10,18 @@
 
 #include "Object.h"
 #include "DataConverter.h"
+#include "MappedRegion.h"
+#include "RowRange.h"
+#include "ChunkRange.h"
+#include "DatasetInfo.h"
+#include "IoStatistics.h"
+#include "ScratchAllocator.h"
+#include "TransferPlan.h"
+#include "Aggregation.h"
+#include "ZoneMap.h"
+#include <atomic>
 #include <string>
+#include <vector>
 
 namespace hdf5
 {
@@ -23,28 +34,171 @@ namespace hdf5
 			Dataset();
 			virtual ~Dataset();
 
-			size_t getRank() const;
-			size_t getDimension(size_t dim) const;
+			inline size_t getRank() const { return fInfo.getRank(); }
+			inline size_t getDimension(size_t dim) const {
+				if (dim >= fInfo.getRank()) {
+					throw Exception("The requested dimension is out-of-range");
+				}
+				return static_cast<size_t>(fInfo.shape[dim]);
+			}
 
-			/// returns the HDF5 identifier to directly use C methods on the dataset
-			hid_t getIdentifier() const { return fObjectId; }
+			/**
+			 * Metadata taken when the dataset has been opened or refreshed. It
+			 * is not updated by writes, e.g. the storage size of a dataset with
+			 * late allocation stays 0 until refresh().
+			 */
+			inline const DatasetInfo& getInfo() const { return fInfo; }
+			/// takes a new metadata snapshot, e.g. after another program changed the dataset
+			void refresh();
 
 			template<typename T> bool read(T& dst) const {
-				ContainerInterface<T>::read(dst, fObjectId, fSpace);
+				HDF5PP_TRACE_SCOPE(trace, "read", getPath());
+				HDF5PP_TRACE_BYTES(trace, getDataSize());
+				IoContext context(getFileStatistics(), getDatasetStatistics());
+				ScratchContext scratch(getScratchAllocator());
+				hid_t dataSet = getIdentifier();
+				hid_t space = H5Dget_space(dataSet);
+				try {
+					ContainerInterface<T>::read(dst, dataSet, space);
+				}
+				catch (...) {
+					H5Sclose(space);
+					throw;
+				}
+				H5Sclose(space);
 				return true;
 			}
 			template<typename T> bool write(const T& src) {
-				ContainerInterface<T>::write(src, fObjectId, fSpace);
+				HDF5PP_TRACE_SCOPE(trace, "write", getPath());
+				HDF5PP_TRACE_BYTES(trace, getDataSize());
+				IoContext context(getFileStatistics(), getDatasetStatistics());
+				ScratchContext scratch(getScratchAllocator());
+				hid_t dataSet = getIdentifier();
+				if (fInfo.tracksWriteGeneration) {
+					advanceWriteGeneration(dataSet);
+				}
+				hid_t space = H5Dget_space(dataSet);
+				try {
+					ContainerInterface<T>::write(src, dataSet, space);
+				}
+				catch (...) {
+					H5Sclose(space);
+					throw;
+				}
+				H5Sclose(space);
 				return true;
 			}
 
+			/**
+			 * Validates once that containers of type T fit this dataset and
+			 * returns a plan for repeated read() and write() calls without
+			 * further checks. The plan must not outlive the dataset.
+			 */
+			template<typename T> TransferPlan<T> prepare() const {
+				return TransferPlan<T>(pinHandle(), getPath(), getFileStatistics(), getDatasetStatistics(), getScratchAllocator(), fInfo.tracksWriteGeneration);
+			}
+
+			/**
+			 * Maps the raw data of the dataset read-only into memory without
+			 * copying it through the HDF5 library.
+			 *
+			 * This is only possible for datasets with contiguous layout, no filters,
+			 * allocated storage and a file type that matches the native type of T
+			 * exactly. Everything else is refused with an Exception. Access to the
+			 * mapped elements is unaligned if the file was not written with a
+			 * suitable H5Pset_alignment.
+			 *
+			 * @return multi_array view of rank NumDims onto the mapped data
+			 */
+			template<typename T, std::size_t NumDims = 1> ConstMappedArray<T, NumDims> map() const {
+				if (!DataType<T>::isPOD()) {
+					throw Exception("Dataset::map(): Only POD element types can be mapped");
+				}
+				if (getRank() != NumDims) {
+					throw Exception("Dataset::map(): Rank of dataset '" + fName + "' and requested view does not match");
+				}
+
+				MappedRegion::Ptr region = mapRawData(DataType<T>::hdfType(), false);
+				return ConstMappedArray<T, NumDims>(region, getExtents());
+			}
+
+			/**
+			 * Streams the dataset in blocks of blockSize rows (first dimension).
+			 * The next block is prefetched in the background while the current
+			 * one is processed.
+			 */
+			template<typename T> RowRange<T> rows(hsize_t blockSize) const {
+				return RowRange<T>(getIdentifier(), blockSize);
+			}
+
+			/**
+			 * Visits the allocated chunks of a chunked dataset in storage order,
+			 * unwritten chunks are skipped.
+			 */
+			template<typename T> ChunkRange<T> chunks() const {
+				return ChunkRange<T>(getIdentifier());
+			}
+
+			/**
+			 * Reduces all elements, converted to T, on a pool of worker threads
+			 * while the dataset is read in chunk aligned blocks, e.g.
+			 * dataset->aggregate<double>(Mean<double>()).get()
+			 * See hdf5::aggregate() for the Reducer interface.
+			 */
+			template<typename T, typename Reducer> typename Reducer::Result aggregate(const Reducer& reducer,
+					ThreadPool& pool = getDefaultThreadPool()) const {
+				HDF5PP_TRACE_SCOPE(trace, "aggregate", getPath());
+				HDF5PP_TRACE_BYTES(trace, getDataSize());
+				HandlePin pin = pinHandle();
+				IoContext context(getFileStatistics(), getDatasetStatistics());
+				ScratchContext scratch(getScratchAllocator());
+				return hdf5::aggregate<T>(pin.get(), fInfo, reducer, pool);
+			}
+
+			/**
+			 * Returns the I/O statistics of read() and write() of this dataset
+			 * and the configuration of its chunk cache. Streaming through rows()
+			 * and chunks() is not accounted.
+			 */
+			IoSummary getStatistics() const;
+			void resetStatistics();
+
+			/**
+			 * Replaces the allocator of the temporary conversion buffers of
+			 * read() and write(). By default all datasets of a file share one
+			 * PoolAllocator, so the cached blocks are bounded per file. Must not
+			 * be called while the dataset is read or written, 0 restores the
+			 * default.
+			 */
+			void setScratchAllocator(const ScratchAllocator::Ptr& allocator);
+			/// allocator of the conversion buffers of this dataset
+			ScratchAllocator* getScratchAllocator() const;
 
 		protected:
 			friend class Group;
-			Dataset(hid_t objectId, const std::string& name);
+			Dataset(const ObjectHandle::Ptr& handle, const std::string& name);
+
+			/// returns the size of all dimensions
+			std::vector<size_t> getExtents() const;
+			/// size of all elements in the file type in bytes
+			inline hsize_t getDataSize() const { return fInfo.getDataSize(); }
+
+			/**
+			 * Checks if the dataset can be mapped with memType as element type
+			 * and maps its raw data.
+			 */
+			MappedRegion::Ptr mapRawData(hid_t memType, bool writable) const;
+
+			/// statistics of the file this dataset belongs to, 0 if it has none
+			IoStatistics* getFileStatistics() const;
+			/// statistics of this dataset, allocated on first use
+			IoStatistics* getDatasetStatistics() const;
 
 		private:
-			hid_t fSpace;
+			/// metadata snapshot, cached to avoid opening the dataset
+			DatasetInfo fInfo;
+			mutable std::atomic<IoStatistics*> fStatistics;
+			ScratchAllocator::Ptr fScratchAllocator;
 	};
 
 } /* namespace hdf5 */
@@ -0,0 +1,166 @@
+/*
+ * DatasetInfo.cpp
+ *
+ * Snapshot of the metadata (shape, type, storage) of a dataset
+ */
+
+#include "DatasetInfo.h"
+#include "Exception.h"
+#include "ZoneMap.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace hdf5
+{
+
+	DatasetInfo::DatasetInfo(hid_t dataSet): typeClass(H5T_NO_CLASS), typeSize(0), layout(H5D_LAYOUT_ERROR), storageSize(0), tracksWriteGeneration(false)
+	{
+		// shape
+		hid_t space = H5Dget_space(dataSet);
+		int rank = H5Sget_simple_extent_ndims(space);
+		if (rank < 0) {
+			H5Sclose(space);
+			throw Exception("DatasetInfo::DatasetInfo(): Could not get dimensionality of dataset");
+		}
+		shape.resize(rank);
+		maxShape.resize(rank);
+		if (rank > 0) {
+			H5Sget_simple_extent_dims(space, &shape[0], &maxShape[0]);
+		}
+		H5Sclose(space);
+
+		// element type
+		hid_t type = H5Dget_type(dataSet);
+		if (type < 0) {
+			throw Exception("DatasetInfo::DatasetInfo(): Could not get type of dataset");
+		}
+		typeClass = H5Tget_class(type);
+		typeSize = H5Tget_size(type);
+		H5Tclose(type);
+
+		// layout and filter pipeline
+		hid_t plist = H5Dget_create_plist(dataSet);
+		if (plist < 0) {
+			throw Exception("DatasetInfo::DatasetInfo(): Could not retrieve creation properties of dataset");
+		}
+		layout = H5Pget_layout(plist);
+		if (layout == H5D_CHUNKED && rank > 0) {
+			chunkDims.resize(rank);
+			H5Pget_chunk(plist, rank, &chunkDims[0]);
+		}
+		int nFilters = H5Pget_nfilters(plist);
+		filters.resize(nFilters > 0 ? nFilters : 0);
+		for (int i = 0; i < nFilters; ++i) {
+			Filter& filter = filters[i];
+			unsigned int config;
+			char name[256];
+			size_t nParameters = 16;
+			filter.parameters.resize(nParameters);
+			filter.id = H5Pget_filter2(plist, i, &filter.flags, &nParameters, &filter.parameters[0], sizeof(name), name, &config);
+			filter.parameters.resize(std::min<size_t>(nParameters, 16));
+			filter.name = name;
+		}
+		H5Pclose(plist);
+
+		storageSize = H5Dget_storage_size(dataSet);
+		tracksWriteGeneration = H5Aexists(dataSet, WriteGenerationAttribute) > 0;
+	}
+
+	hsize_t DatasetInfo::getNumElements() const
+	{
+		hsize_t nElements = 1;
+		for (size_t i = 0; i < shape.size(); ++i) {
+			nElements *= shape[i];
+		}
+		return nElements;
+	}
+
+	namespace
+	{
+		void writeDims(std::ostream& os, const std::vector<hsize_t>& dims)
+		{
+			os << "(";
+			for (size_t i = 0; i < dims.size(); ++i) {
+				if (i > 0) {
+					os << "x";
+				}
+				if (dims[i] == H5S_UNLIMITED) {
+					os << "inf";
+				}
+				else {
+					os << dims[i];
+				}
+			}
+			os << ")";
+		}
+
+		const char* getClassName(H5T_class_t typeClass)
+		{
+			switch (typeClass) {
+				case H5T_INTEGER:
+					return "integer";
+				case H5T_FLOAT:
+					return "float";
+				case H5T_STRING:
+					return "string";
+				case H5T_TIME:
+					return "time";
+				case H5T_BITFIELD:
+					return "bitfield";
+				case H5T_OPAQUE:
+					return "opaque";
+				case H5T_COMPOUND:
+					return "compound";
+				case H5T_REFERENCE:
+					return "reference";
+				case H5T_ENUM:
+					return "enum";
+				case H5T_VLEN:
+					return "vlen";
+				case H5T_ARRAY:
+					return "array";
+				default:
+					return "unknown";
+			}
+		}
+
+		const char* getLayoutName(H5D_layout_t layout)
+		{
+			switch (layout) {
+				case H5D_COMPACT:
+					return "compact";
+				case H5D_CONTIGUOUS:
+					return "contiguous";
+				case H5D_CHUNKED:
+					return "chunked";
+				case H5D_VIRTUAL:
+					return "virtual";
+				default:
+					return "unknown";
+			}
+		}
+	}
+
+	std::ostream& operator<<(std::ostream& os, const DatasetInfo& info)
+	{
+		os << "shape=";
+		writeDims(os, info.shape);
+		if (info.isExtendible()) {
+			os << " max=";
+			writeDims(os, info.maxShape);
+		}
+		os << " type=" << getClassName(info.typeClass) << "[" << info.typeSize << "]";
+		os << " layout=" << getLayoutName(info.layout);
+		if (info.isChunked()) {
+			os << " chunk=";
+			writeDims(os, info.chunkDims);
+		}
+		for (size_t i = 0; i < info.filters.size(); ++i) {
+			os << (i == 0 ? " filters=" : ",") << info.filters[i].name;
+		}
+		os << " storage=" << info.storageSize;
+		return os;
+	}
+
+} /* namespace hdf5 */
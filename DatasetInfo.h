@@ -0,0 +1,62 @@
+/*
+ * DatasetInfo.h
+ *
+ * Snapshot of the metadata (shape, type, storage) of a dataset
+ */
+
+#ifndef HDF5_DATASETINFO_H_
+#define HDF5_DATASETINFO_H_
+
+#include <hdf5.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace hdf5
+{
+	/**
+	 * Metadata of a dataset as read by one series of library calls. Nothing
+	 * is updated afterwards, Dataset::refresh() takes a new snapshot.
+	 */
+	struct DatasetInfo {
+			/// one stage of the filter pipeline
+			struct Filter {
+					H5Z_filter_t id;
+					std::string name;
+					unsigned int flags;
+					std::vector<unsigned int> parameters;
+			};
+
+			/// current size of all dimensions
+			std::vector<hsize_t> shape;
+			/// maximum size of all dimensions, H5S_UNLIMITED for extendible ones
+			std::vector<hsize_t> maxShape;
+			H5T_class_t typeClass;
+			/// size of one element in the file in bytes
+			size_t typeSize;
+			H5D_layout_t layout;
+			/// size of the chunks, empty unless the layout is chunked
+			std::vector<hsize_t> chunkDims;
+			std::vector<Filter> filters;
+			/// bytes allocated in the file at the time of the snapshot
+			hsize_t storageSize;
+			/// writes are counted for a zone map, see advanceWriteGeneration()
+			bool tracksWriteGeneration;
+
+			DatasetInfo(): typeClass(H5T_NO_CLASS), typeSize(0), layout(H5D_LAYOUT_ERROR), storageSize(0), tracksWriteGeneration(false) {}
+			/// takes a snapshot of the open dataset
+			explicit DatasetInfo(hid_t dataSet);
+
+			inline size_t getRank() const { return shape.size(); }
+			inline bool isChunked() const { return layout == H5D_CHUNKED; }
+			inline bool isExtendible() const { return maxShape != shape; }
+			/// number of elements of the dataset
+			hsize_t getNumElements() const;
+			/// size of all elements in the file type in bytes, before filtering
+			inline hsize_t getDataSize() const { return getNumElements() * typeSize; }
+	};
+
+	std::ostream& operator<<(std::ostream& os, const DatasetInfo& info);
+
+} /* namespace hdf5 */
+#endif /* HDF5_DATASETINFO_H_ */
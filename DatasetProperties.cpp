@@ -0,0 +1,98 @@
+/*
+ * DatasetProperties.cpp
+ */
+
+#include "DatasetProperties.h"
+#include "Exception.h"
+
+namespace hdf5
+{
+
+	DatasetProperties& DatasetProperties::operator=(const DatasetProperties& original)
+	{
+		if (this != &original) {
+			fLayout = original.fLayout;
+			fChunkDims = original.fChunkDims;
+			fAccessPattern = original.fAccessPattern;
+			fAdvisor = original.fAdvisor;
+			fAllocTime = original.fAllocTime;
+			fFillTime = original.fFillTime;
+			fShuffle = original.fShuffle;
+			fDeflateLevel = original.fDeflateLevel;
+			fZoneMap = original.fZoneMap;
+			fZoneMapFields = original.fZoneMapFields;
+		}
+		return *this;
+	}
+
+	bool DatasetProperties::isDefault() const
+	{
+		return fLayout == H5D_CONTIGUOUS && fAllocTime == H5D_ALLOC_TIME_DEFAULT && fFillTime == H5D_FILL_TIME_IFSET && !fShuffle && fDeflateLevel < 0;
+	}
+
+	hid_t DatasetProperties::createPropertyList(size_t rank) const
+	{
+		if (isDefault()) {
+			return H5P_DEFAULT;
+		}
+
+		hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
+		if (plist < 0) {
+			throw Exception("DatasetProperties: Could not create dataset creation property list");
+		}
+
+		herr_t err = 0;
+		if (fLayout == H5D_CHUNKED) {
+			if (fChunkDims.empty() && fAccessPattern.kind != AccessPattern::None) {
+				H5Pclose(plist);
+				throw Exception("DatasetProperties: Chunks for an access pattern need the shape of the dataset");
+			}
+			if (fChunkDims.size() != rank) {
+				H5Pclose(plist);
+				throw Exception("DatasetProperties: Rank of chunk and dataset does not match");
+			}
+			err |= H5Pset_chunk(plist, static_cast<int>(rank), &fChunkDims[0]);
+		}
+		else {
+			err |= H5Pset_layout(plist, fLayout);
+		}
+		if (fAllocTime != H5D_ALLOC_TIME_DEFAULT) {
+			err |= H5Pset_alloc_time(plist, fAllocTime);
+		}
+		err |= H5Pset_fill_time(plist, fFillTime);
+		if (fShuffle || fDeflateLevel >= 0) {
+			if (fLayout != H5D_CHUNKED) {
+				H5Pclose(plist);
+				throw Exception("DatasetProperties: Filters need a chunked layout");
+			}
+			if (fDeflateLevel > 9) {
+				H5Pclose(plist);
+				throw Exception("DatasetProperties: Compression level must be between 0 and 9");
+			}
+			// the pipeline runs in the order the filters are added
+			if (fShuffle) {
+				err |= H5Pset_shuffle(plist);
+			}
+			if (fDeflateLevel >= 0) {
+				err |= H5Pset_deflate(plist, fDeflateLevel);
+			}
+		}
+
+		if (err < 0) {
+			H5Pclose(plist);
+			throw Exception("DatasetProperties: Could not set dataset creation properties");
+		}
+		return plist;
+	}
+
+	hid_t DatasetProperties::createPropertyList(const std::vector<hsize_t>& shape, size_t typeSize) const
+	{
+		if (fLayout == H5D_CHUNKED && fChunkDims.empty() && fAccessPattern.kind != AccessPattern::None) {
+			DatasetProperties resolved(*this);
+			resolved.chunked(fAdvisor.suggest(shape, typeSize, fAccessPattern));
+			return resolved.createPropertyList(shape.size());
+		}
+		return createPropertyList(shape.size());
+	}
+
+} /* namespace hdf5 */
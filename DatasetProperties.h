@@ -0,0 +1,88 @@
+/*
+ * DatasetProperties.h
+ *
+ * Creation properties (layout, allocation, filling, filters) of datasets
+ */
+
+#ifndef HDF5_DATASETPROPERTIES_H_
+#define HDF5_DATASETPROPERTIES_H_
+
+#include "ChunkAdvisor.h"
+#include <hdf5.h>
+#include <string>
+#include <vector>
+
+namespace hdf5
+{
+	/**
+	 * Describes how a dataset is created. Without any modification the
+	 * defaults of the HDF5 library are used.
+	 *
+	 * Usage: group.createDataset("x", data, DatasetProperties().chunked(dims));
+	 */
+	struct DatasetProperties {
+			H5D_layout_t fLayout;
+			std::vector<hsize_t> fChunkDims;
+			/// picks fChunkDims from the shape of the dataset if they are empty, see chunkedFor()
+			AccessPattern fAccessPattern;
+			ChunkAdvisor fAdvisor;
+			H5D_alloc_time_t fAllocTime;
+			H5D_fill_time_t fFillTime;
+			/// byte shuffle filter before compression
+			bool fShuffle;
+			/// gzip compression level, -1 for no compression
+			int fDeflateLevel;
+			bool fZoneMap;
+			std::vector<std::string> fZoneMapFields;
+
+			DatasetProperties(): fLayout(H5D_CONTIGUOUS), fAllocTime(H5D_ALLOC_TIME_DEFAULT), fFillTime(H5D_FILL_TIME_IFSET), fShuffle(false),
+					fDeflateLevel(-1), fZoneMap(false) {};
+			DatasetProperties(const DatasetProperties& original) { operator=(original); }
+			DatasetProperties& operator=(const DatasetProperties& original);
+
+			/// store the data in one contiguous block (default)
+			inline DatasetProperties& contiguous() { fLayout = H5D_CONTIGUOUS; fChunkDims.clear(); fAccessPattern = AccessPattern(); return *this; }
+			/// store the data in the object header, only possible for small datasets (< 64kB)
+			inline DatasetProperties& compact() { fLayout = H5D_COMPACT; fChunkDims.clear(); fAccessPattern = AccessPattern(); return *this; }
+			/// store the data in chunks of the given size
+			inline DatasetProperties& chunked(const std::vector<hsize_t>& dims) { fLayout = H5D_CHUNKED; fChunkDims = dims; fAccessPattern = AccessPattern(); return *this; }
+			/// store the data in chunks, which advisor picks for the shape of the dataset and pattern
+			inline DatasetProperties& chunkedFor(const AccessPattern& pattern, const ChunkAdvisor& advisor = ChunkAdvisor()) {
+				fLayout = H5D_CHUNKED;
+				fChunkDims.clear();
+				fAccessPattern = pattern;
+				fAdvisor = advisor;
+				return *this;
+			}
+			/// allocate the complete storage when the dataset is created
+			inline DatasetProperties& allocateEarly() { fAllocTime = H5D_ALLOC_TIME_EARLY; return *this; }
+			/// never write fill values into allocated storage
+			inline DatasetProperties& noFill() { fFillTime = H5D_FILL_TIME_NEVER; return *this; }
+			/// reorder the bytes of the elements by significance before compressing, needs a chunked layout
+			inline DatasetProperties& shuffle() { fShuffle = true; return *this; }
+			/// compress the chunks with gzip at level 0-9, needs a chunked layout
+			inline DatasetProperties& deflate(unsigned int level = 6) { fDeflateLevel = level; return *this; }
+			/// no shuffle and compression
+			inline DatasetProperties& noFilters() { fShuffle = false; fDeflateLevel = -1; return *this; }
+			/**
+			 * record minimum and maximum of the given fields per chunk when the
+			 * dataset is created (see Group::createZoneMap()), fields are empty
+			 * for numeric datasets
+			 */
+			inline DatasetProperties& zoneMap(const std::vector<std::string>& fields = std::vector<std::string>()) { fZoneMap = true; fZoneMapFields = fields; return *this; }
+
+			/// true if the dataset creation property list does not differ from the library defaults
+			bool isDefault() const;
+
+			/**
+			 * Creates a dataset creation property list.
+			 * @param rank Rank of the dataset which is going to be created
+			 * @return H5P_DEFAULT or a property list, which has to be closed by the caller
+			 */
+			hid_t createPropertyList(size_t rank) const;
+			/// as above, with the chunks of chunkedFor() picked for a dataset of the given shape and element size
+			hid_t createPropertyList(const std::vector<hsize_t>& shape, size_t typeSize) const;
+	};
+
+} /* namespace hdf5 */
+#endif /* HDF5_DATASETPROPERTIES_H_ */
@@ -22,7 +22,12 @@ namespace hdf5
 
 	File::~File()
 	{
-		closeFile();
+		try {
+			closeFile();
+		}
+		catch (const Exception& e) {
+			cerr << "File::~File(): " << e.what() << endl;
+		}
 	}
 
 	OpenFile& OpenFile::operator =(const OpenFile& original)
@@ -33,6 +38,8 @@ namespace hdf5
 			fCreate = original.fCreate;
 			fRead = original.fRead;
 			fWrite = original.fWrite;
+			fMaxOpenObjects = original.fMaxOpenObjects;
+			fTrackCreationOrder = original.fTrackCreationOrder;
 		}
 		return *this;
 	}
@@ -40,6 +47,7 @@ namespace hdf5
 	File& File::closeFile()
 	{
 		if (isOpen()) {
+			flushAttributes();
 			herr_t id = H5Fclose(fFile);
 			if (id > -1) {
 				fFile = -1;
@@ -53,6 +61,18 @@ namespace hdf5
 		return *this;
 	}
 
+	File& File::flush()
+	{
+		if (!isOpen()) {
+			throw Exception("File is not opened");
+		}
+		flushAttributes();
+		if (H5Fflush(fFile, H5F_SCOPE_GLOBAL) < 0) {
+			throw Exception("Could not flush file \"" + fFileMode.fFileName + "\"");
+		}
+		return *this;
+	}
+
 	File::File(const std::string& fileName): fFile(-1)
 	{
 		fType = ObjectType::File;
@@ -96,6 +116,53 @@ namespace hdf5
 		}
 	}
 
+	size_t File::getNumOpenObjects() const
+	{
+		if (!isOpen()) {
+			throw Exception("File is not opened");
+		}
+		return fHandle->getManager()->getNumOpenObjects();
+	}
+
+	File& File::setMaxOpenObjects(size_t maxOpenObjects)
+	{
+		if (!isOpen()) {
+			throw Exception("File is not opened");
+		}
+		fFileMode.fMaxOpenObjects = maxOpenObjects;
+		fHandle->getManager()->setMaxOpenObjects(maxOpenObjects);
+		return *this;
+	}
+
+	IoSummary File::getStatistics() const
+	{
+		if (!isOpen()) {
+			throw Exception("File is not opened");
+		}
+		IoSummary summary = fHandle->getManager()->getStatistics().getSummary();
+
+		double hitRate;
+		if (H5Fget_mdc_hit_rate(fFile, &hitRate) > -1) {
+			summary.mdcHitRate = hitRate;
+		}
+		size_t maxSize, minCleanSize, currentSize;
+		int nEntries;
+		if (H5Fget_mdc_size(fFile, &maxSize, &minCleanSize, &currentSize, &nEntries) > -1) {
+			summary.mdcSize = currentSize;
+		}
+		return summary;
+	}
+
+	File& File::resetStatistics()
+	{
+		if (!isOpen()) {
+			throw Exception("File is not opened");
+		}
+		fHandle->getManager()->getStatistics().reset();
+		H5Freset_mdc_hit_rate_stats(fFile);
+		return *this;
+	}
+
 	inline bool File::isReadOnly() const
 	{
 		if (this->fFile > -1) {
@@ -119,10 +186,19 @@ namespace hdf5
 	{
 		closeFile();
 		fFileMode = fileMode;
+		HDF5PP_TRACE_SCOPE(trace, "openFile", fFileMode.fFileName);
 
 		if (fFileMode.fCreate && fFileMode.fWrite && fFileMode.fRead) {
 			unsigned int flags = fFileMode.fTruncate ? H5F_ACC_TRUNC : H5F_ACC_EXCL;
-			fFile = H5Fcreate(fFileMode.fFileName.c_str(), flags, H5P_DEFAULT, H5P_DEFAULT);
+			hid_t fcpl = H5P_DEFAULT;
+			if (fFileMode.fTrackCreationOrder) {
+				fcpl = H5Pcreate(H5P_FILE_CREATE);
+				H5Pset_link_creation_order(fcpl, H5P_CRT_ORDER_TRACKED | H5P_CRT_ORDER_INDEXED);
+			}
+			fFile = H5Fcreate(fFileMode.fFileName.c_str(), flags, fcpl, H5P_DEFAULT);
+			if (fcpl != H5P_DEFAULT) {
+				H5Pclose(fcpl);
+			}
 		}
 
 		if ( (fFile < 0 || !fFileMode.fCreate) ) {
@@ -134,8 +210,18 @@ namespace hdf5
 			throw Exception("Could not open file \"" + fFileMode.fFileName + "\"");
 		}
 
+		// all groups and datasets are opened through the handle manager, the
+		// root group is our own handle
+		HandleManager::Ptr manager(new HandleManager(fFile, fFileMode.fMaxOpenObjects));
+		hid_t rootId = H5Gopen2(fFile, "/", H5P_DEFAULT);
+		if (rootId < 0) {
+			throw Exception("Could not open root group of file \"" + fFileMode.fFileName + "\"");
+		}
+		fHandle = manager->add("/", rootId);
+
 		// retrieve object list
-		updateGroup(fFile);
+		updateGroup();
+		updateAttributes();
 
 //		cout << " --- Groups in root:" << endl;
 //		for (Group::ObjectConstIterator itObj = objectsBegin(); itObj != objectsEnd(); ++itObj) {
@@ -23,9 +23,11 @@ namespace hdf5
 			bool fCreate;
 			bool fRead;
 			bool fWrite;
+			size_t fMaxOpenObjects;
+			bool fTrackCreationOrder;
 
-			OpenFile(): fFileName(""), fTruncate(false), fCreate(false), fRead(true), fWrite(false) {};
-			OpenFile(const std::string& fileName): fFileName(fileName), fTruncate(false), fCreate(false), fRead(true), fWrite(false) {};
+			OpenFile(): fFileName(""), fTruncate(false), fCreate(false), fRead(true), fWrite(false), fMaxOpenObjects(0), fTrackCreationOrder(false) {};
+			OpenFile(const std::string& fileName): fFileName(fileName), fTruncate(false), fCreate(false), fRead(true), fWrite(false), fMaxOpenObjects(0), fTrackCreationOrder(false) {};
 			OpenFile(const OpenFile& original) { operator=(original); }
 			OpenFile& operator=(const OpenFile& original);
 
@@ -39,6 +41,14 @@ namespace hdf5
 			inline OpenFile& create() { fCreate = true; return *this; }
 			/// does not create the file if it does not already exist
 			inline OpenFile& dontCreate() { fCreate = false; return *this; }
+			/**
+			 * keep at most maxOpenObjects group and dataset handles open at the
+			 * same time, the least recently used ones are closed and reopened on
+			 * demand (0 = unlimited)
+			 */
+			inline OpenFile& maxOpenObjects(size_t maxOpenObjects) { fMaxOpenObjects = maxOpenObjects; return *this; }
+			/// track and index the creation order of links in the root group of a new file
+			inline OpenFile& trackCreationOrder() { fTrackCreationOrder = true; return *this; }
 	};
 
 	/**
@@ -78,6 +88,19 @@ namespace hdf5
 			 */
 			hsize_t getFreeSpace() const;
 
+			/// number of group and dataset handles currently open
+			size_t getNumOpenObjects() const;
+			/// changes the limit of open group and dataset handles (0 = unlimited)
+			File& setMaxOpenObjects(size_t maxOpenObjects);
+
+			/**
+			 * Returns the I/O statistics of all objects of the file together
+			 * with the hit rate and size of the metadata cache.
+			 */
+			IoSummary getStatistics() const;
+			/// resets the I/O statistics of the file and the metadata cache
+			File& resetStatistics();
+
 			/**
 			 * closeFile terminates access to an HDF5 file by flushing all data
 			 * to storage and terminating access to the file through file_id.
@@ -110,6 +133,12 @@ namespace hdf5
 			 * @return reference to this object
 			 */
 			File& closeFile();
+			/**
+			 * Writes all staged attributes and flushes all buffers of the file
+			 * to storage.
+			 * @return reference to this object
+			 */
+			File& flush();
 			File& openFile(const OpenFile& fileMode);
 			/// opens the file in read-only mode
 			File& openFile(const std::string& fileName) { return openFile(OpenFile(fileName)); }
@@ -10,6 +10,7 @@
 #include "Dataset.h"
 #include "File.h"
 #include <hdf5.h>
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 
@@ -21,7 +22,6 @@ namespace hdf5
 	Group::Group()
 	{
 		// TODO Auto-generated constructor stub
-		fObjectId = -1;
 		fType = Object::ObjectType::Group;
 	}
 
@@ -30,18 +30,44 @@ namespace hdf5
 		// since all daughters must be closed before we close our own group
 		// we have to clear the map on our own
 		fDaughters.clear();
-//		cout << "Group::~Group: fType=" << fType << " / ObjectType::Group=" << ObjectType::Group << " / ObjectType::File=" << ObjectType::File << " / fObjectId=" << fObjectId << endl;
-		if (fType == ObjectType::Group && fObjectId >= 0) {
-			H5Gclose(fObjectId);
+		if (fType == ObjectType::Group && fHandle) {
+			try {
+				Object::flushAttributes();
+			}
+			catch (const Exception& e) {
+				cerr << "Group::~Group(): " << e.what() << endl;
+			}
 		}
 	}
 
-	Group::Group(hid_t objectId, const std::string& groupName)
+	bool Group::hasPendingAttributes() const
+	{
+		if (Object::hasPendingAttributes()) {
+			return true;
+		}
+		for (ObjectConstIterator it = fDaughters.begin(); it != fDaughters.end(); ++it) {
+			if (it->second->hasPendingAttributes()) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void Group::writePendingAttributes()
+	{
+		Object::writePendingAttributes();
+		for (ObjectIterator it = fDaughters.begin(); it != fDaughters.end(); ++it) {
+			it->second->writePendingAttributes();
+		}
+	}
+
+	Group::Group(const ObjectHandle::Ptr& handle, const std::string& groupName)
 	{
 		fName = groupName;
 		fType = Object::ObjectType::Group;
-//		cout << "Group::Group: Calling updateGroup(" << groupName << ", " << objectId << ")" << endl;
-		updateGroup(objectId);
+		fHandle = handle;
+//		cout << "Group::Group: Calling updateGroup(" << groupName << ")" << endl;
+		updateGroup();
 //		cout << "Group::Group: Calling updateAttributes()" << endl;
 		updateAttributes();
 	}
@@ -118,64 +144,245 @@ namespace hdf5
 		fDaughters.erase(name);
 
 		// remove the object from the file
-		return H5Gunlink(fObjectId, name.c_str()) > -1;
+		return H5Gunlink(getIdentifier(), name.c_str()) > -1;
 	}
 
-	void Group::updateGroup(hid_t groupId)
+	Dataset::Ptr Group::createZoneMap(const std::string& name, const std::vector<std::string>& fields)
 	{
-		fDaughters.clear();
-		fObjectId = groupId;
-
-		hsize_t nObj;
-		herr_t err = H5Gget_num_objs(groupId, &nObj);
-		if (err < 0)
-			throw Exception("Group::updateGroup(): Could not retrieve number of objects in group");
-
-		for (size_t iObj = 0; iObj < nObj; ++iObj) {
-//			cout << " -------" << endl;
-			char* objName;
-			ssize_t nameSize = H5Gget_objname_by_idx(groupId, iObj, 0, 0);
-			if (nameSize > -1) {
-				nameSize++; // to get termination character, too
-				objName = new char[nameSize];
-				H5Gget_objname_by_idx(groupId, iObj, objName, nameSize);
-				string sObjectName(objName);
-				delete[] objName;
-
-				int objType = H5Gget_objtype_by_idx(groupId, iObj);
-				hid_t daughterId = -1;
-				Object::Ptr objPtr;
-				switch(objType) {
-					case H5G_GROUP:
-						daughterId = H5Gopen1(groupId, sObjectName.c_str());
-						objPtr = Object::Ptr(new Group(daughterId, sObjectName));
-						break;
-					case H5G_DATASET:
-						daughterId = H5Dopen1(groupId, sObjectName.c_str());
-//						cout << "Group::updateGroup(" << groupId << "): Found H5G_DATASET (named '" << sObjectName << "'), id=" << daughterId << endl;
-						objPtr = Object::Ptr(new hdf5::Dataset(daughterId, sObjectName));
-						break;
-					case H5G_TYPE:
-						throw Exception("Group::updateGroup(): Object not implemented H5G_TYPE");
-						break;
-					case H5G_LINK:
-						throw Exception("Group::updateGroup(): Object not implemented H5G_LINK");
-						break;
-					case H5G_UDLINK:
-						throw Exception("Group::updateGroup(): Object not implemented H5G_UDLINK");
-						break;
-				}
+		Dataset::Ptr data = getDataSet(name);
+		const DatasetInfo& info = data->getInfo();
+		if (!info.isChunked() || info.getRank() != 1) {
+			throw Exception("Group::createZoneMap(): '" + name + "' is no chunked dataset of rank 1");
+		}
+		ZoneMap zones;
+		uint64_t generation;
+		{
+			HandlePin pin = data->pinHandle();
+			IoContext context(data->getFileStatistics(), data->getDatasetStatistics());
+			zones = ZoneMap::build(pin.get(), fields, info.chunkDims[0]);
+			generation = trackWriteGeneration(pin.get());
+		}
+		// so that the writes of the dataset advance the generation from now on
+		data->refresh();
+
+		string zoneMapName = name + ZoneMapSuffix;
+		if (hasObject(zoneMapName)) {
+			deleteObject(zoneMapName);
+		}
+		// an empty dataset does not need a zone map
+		if (zones.getEntries().empty()) {
+			return Dataset::Ptr();
+		}
+		Dataset::Ptr zoneMap = createDataset(zoneMapName, zones.getEntries());
+		if (!fields.empty()) {
+			zoneMap->setAttribute("Fields", fields);
+		}
+		zoneMap->setAttribute("BlockSize", static_cast<uint64_t>(zones.getBlockSize()));
+		zoneMap->setAttribute("Rows", static_cast<uint64_t>(zones.getNumRows()));
+		zoneMap->setAttribute("Generation", generation);
+		return zoneMap;
+	}
 
-				if (daughterId < 0) {
-					cerr << "Could not open daughter '" << sObjectName << "': " << daughterId << endl;
-					continue;
+	ZoneMap Group::openZoneMap(const std::string& name)
+	{
+		string zoneMapName = name + ZoneMapSuffix;
+		if (!hasObject(zoneMapName)) {
+			return ZoneMap();
+		}
+		Dataset::Ptr zoneMap = getDataSet(zoneMapName);
+		if (!zoneMap->hasAttribute("BlockSize") || !zoneMap->hasAttribute("Rows")) {
+			throw Exception("Group::openZoneMap(): '" + zoneMapName + "' is no zone map");
+		}
+		uint64_t generation;
+		bool tracked;
+		{
+			HandlePin pin = getDataSet(name)->pinHandle();
+			tracked = getWriteGeneration(pin.get(), generation);
+		}
+		// the dataset has been written since the zone map has been built
+		if (!tracked || !zoneMap->hasAttribute("Generation") || zoneMap->getAttribute<uint64_t>("Generation") != generation) {
+			return ZoneMap();
+		}
+		vector<string> fields;
+		if (zoneMap->hasAttribute("Fields")) {
+			try {
+				fields = zoneMap->getAttribute< vector<string> >("Fields");
+			}
+			catch (const Exception&) {
+				// a single field is read back as string, older zone maps joined the fields by commas
+				const string& joined = zoneMap->getAttribute<string>("Fields");
+				for (size_t begin = 0; begin <= joined.size(); ) {
+					size_t end = min(joined.find(',', begin), joined.size());
+					fields.push_back(joined.substr(begin, end - begin));
+					begin = end + 1;
 				}
-				fDaughters[sObjectName] = objPtr;
+			}
+		}
+		vector<ZoneMapEntry> entries;
+		zoneMap->read(entries);
+		return ZoneMap(fields, zoneMap->getAttribute<uint64_t>("BlockSize"), zoneMap->getAttribute<uint64_t>("Rows"), entries);
+	}
+
+	void Group::checkZoneMap(const DatasetProperties& properties, size_t rank, hid_t type) const
+	{
+		if (properties.fLayout != H5D_CHUNKED || rank != 1) {
+			throw Exception("Group::createDataset(): Zone maps are only supported for chunked datasets of rank 1");
+		}
+		ZoneMap::checkFields(type, properties.fZoneMapFields);
+	}
+
+	std::string Group::getDaughterPath(const std::string& name) const
+	{
+		std::string path = getPath();
+		return path == "/" ? "/" + name : path + "/" + name;
+	}
+
+	ObjectHandle::Ptr Group::addDaughterHandle(const std::string& name, hid_t id)
+	{
+		return fHandle->getManager()->add(getDaughterPath(name), id);
+	}
+
+	Group::Ptr Group::createGroup(const std::string& name, bool trackCreationOrder)
+	{
+		if (hasObject(name)) {
+			throw Exception("Could not create group '" + name + "' because it already exists");
+		}
+
+		hid_t gcpl = H5P_DEFAULT;
+		if (trackCreationOrder) {
+			gcpl = H5Pcreate(H5P_GROUP_CREATE);
+			H5Pset_link_creation_order(gcpl, H5P_CRT_ORDER_TRACKED | H5P_CRT_ORDER_INDEXED);
+		}
+		hid_t groupId = H5Gcreate2(getIdentifier(), name.c_str(), H5P_DEFAULT, gcpl, H5P_DEFAULT);
+		if (gcpl != H5P_DEFAULT) {
+			H5Pclose(gcpl);
+		}
+		if (groupId < 0) {
+			throw Exception("Could not create group '" + name + "'");
+		}
+
+		Group::Ptr groupPtr = Group::Ptr(new Group(addDaughterHandle(name, groupId), name));
+		fDaughters[name] = groupPtr;
+		return groupPtr;
+	}
+
+	std::vector<Group::LinkInfo> Group::listLinks() const
+	{
+		HandlePin pin = pinHandle();
+		std::vector<LinkInfo> links;
+		LinkScan scan = { 0, &links, "" };
+		iterateLinks(pin.get(), scan);
+		return links;
+	}
+
+	void Group::iterateLinks(hid_t groupId, LinkScan& scan)
+	{
+		// groups tracking the creation order are listed in that order
+		H5_index_t index = H5_INDEX_NAME;
+		hid_t gcpl = H5Gget_create_plist(groupId);
+		if (gcpl > -1) {
+			unsigned int flags = 0;
+			if (H5Pget_link_creation_order(gcpl, &flags) > -1 && (flags & H5P_CRT_ORDER_INDEXED)) {
+				index = H5_INDEX_CRT_ORDER;
+			}
+			H5Pclose(gcpl);
+		}
+
+		hsize_t idx = 0;
+		herr_t err = H5Literate(groupId, index, H5_ITER_INC, &idx, &Group::visitLink, &scan);
+		if (!scan.error.empty()) {
+			throw Exception(scan.error);
+		}
+		if (err < 0) {
+			throw Exception("Group::iterateLinks(): Could not iterate over the links of the group");
+		}
+	}
+
+	herr_t Group::visitLink(hid_t groupId, const char* name, const H5L_info_t* info, void* data)
+	{
+		LinkScan& scan = *static_cast<LinkScan*>(data);
+
+		LinkInfo link;
+		link.name = name;
+		link.objectType = Object::Unknown;
+		switch (info->type) {
+			case H5L_TYPE_HARD:
+				link.linkType = LinkInfo::Hard;
+				break;
+			case H5L_TYPE_SOFT:
+				link.linkType = LinkInfo::Soft;
+				break;
+			case H5L_TYPE_EXTERNAL:
+				link.linkType = LinkInfo::External;
+				break;
+			default:
+				link.linkType = LinkInfo::UserDefined;
+				break;
+		}
+
+		// the object type of hard links is resolved by opening the object,
+		// which can be used right away to build the object tree
+		hid_t daughterId = -1;
+		if (link.linkType == LinkInfo::Hard) {
+			{
+				HDF5PP_TRACE_SCOPE(trace, "open", scan.group ? scan.group->getDaughterPath(link.name) : link.name);
+				IoStatistics* statistics = scan.group ? &scan.group->fHandle->getManager()->getStatistics() : 0;
+				IoContext context(statistics, 0);
+				IoTimer timer(IoOpen);
+				daughterId = H5Oopen(groupId, name, H5P_DEFAULT);
+			}
+			if (daughterId < 0) {
+				cerr << "Could not open daughter '" << name << "'" << endl;
+			}
+			else if (H5Iget_type(daughterId) == H5I_GROUP) {
+				link.objectType = Object::Group;
+			}
+			else if (H5Iget_type(daughterId) == H5I_DATASET) {
+				link.objectType = Object::Dataset;
+			}
+		}
+
+		if (scan.links) {
+			scan.links->push_back(link);
+		}
+
+		// soft/external links and named datatypes are not part of the object tree
+		if (!scan.group || link.objectType == Object::Unknown) {
+			if (daughterId > -1) {
+				H5Oclose(daughterId);
+			}
+			return 0;
+		}
+
+		try {
+			Object::Ptr objPtr;
+			ObjectHandle::Ptr handle = scan.group->addDaughterHandle(link.name, daughterId);
+			if (link.objectType == Object::Group) {
+				objPtr = Object::Ptr(new hdf5::Group(handle, link.name));
 			}
 			else {
-				throw Exception("Group::updateGroup(): Could not retrieve objects in group");
+				objPtr = Object::Ptr(new hdf5::Dataset(handle, link.name));
 			}
+			// names are visited in increasing order unless the creation order is tracked
+			scan.group->fDaughters.insert(scan.group->fDaughters.end(), ObjectMap::value_type(link.name, objPtr));
+		}
+		catch (const std::exception& e) {
+			// exceptions must not pass through the HDF5 library
+			scan.error = e.what();
+			return -1;
 		}
+		return 0;
+	}
+
+	void Group::updateGroup()
+	{
+		fDaughters.clear();
+		HDF5PP_TRACE_SCOPE(trace, "scanGroup", getPath());
+
+		// our handle must stay open while the daughters are opened
+		HandlePin pin = pinHandle();
+		LinkScan scan = { this, 0, "" };
+		iterateLinks(pin.get(), scan);
 	}
 
 } /* namespace hdf5 */
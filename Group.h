@@ -11,7 +11,16 @@
 #include "Object.h"
 #include "Dataset.h"
 #include "DataConverter.h"
+#include "DatasetProperties.h"
+#include "MappedRegion.h"
+#include "RaggedArray.h"
+#include "SortedMapView.h"
+#include "SparseMatrix.h"
+#include "ZoneMap.h"
 #include <boost/concept_check.hpp>
+#include <iterator>
+#include <set>
+#include <vector>
 
 namespace hdf5
 {
@@ -25,6 +34,16 @@ namespace hdf5
 			typedef ObjectMap::const_iterator ObjectConstIterator;
 			typedef ObjectMap::iterator ObjectIterator;
 
+			/// link of a group as returned by listLinks()
+			struct LinkInfo {
+					enum LinkType { Hard, Soft, External, UserDefined };
+
+					std::string name;
+					LinkType linkType;
+					/// type of the linked object, only resolved for hard links
+					ObjectType objectType;
+			};
+
 			Group();
 			virtual ~Group();
 
@@ -64,33 +83,482 @@ namespace hdf5
 			 */
 			bool deleteObject(const std::string& name);
 
+			/**
+			 * Lists all links of this group in one pass, in creation order if
+			 * the group tracks it and in name order otherwise. Unlike the object
+			 * tree, soft and external links are included.
+			 */
+			std::vector<LinkInfo> listLinks() const;
+
 			// subobject creation interface
-			template<typename T> Dataset::Ptr createDataset(const std::string& name, T& src) {
+			template<typename T> Dataset::Ptr createDataset(const std::string& name, const T& src, const DatasetProperties& properties = DatasetProperties()) {
 				// throw an exception, if it already exists
 				if (hasObject(name)) {
 					throw Exception("Could not create dataset '" + name + "' because it already exists");
 				}
 
+				HDF5PP_TRACE_SCOPE(trace, "createDataset", getDaughterPath(name));
 				hid_t memType =  ContainerInterface<T>::hdfElementType();
 				hid_t fileType = memType;
 				hid_t space = ContainerInterface<T>::hdfSpace(src);
-
-				hid_t dsId = H5Dcreate2(fObjectId, name.c_str(), fileType, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+				HDF5PP_TRACE_BYTES(trace, H5Sget_simple_extent_npoints(space) * H5Tget_size(memType));
+				std::vector<hsize_t> shape(H5Sget_simple_extent_ndims(space));
+				H5Sget_simple_extent_dims(space, shape.data(), 0);
+				hid_t dsId;
+				try {
+					if (properties.fZoneMap) {
+						checkZoneMap(properties, shape.size(), fileType);
+					}
+					hid_t plist = properties.createPropertyList(shape, H5Tget_size(memType));
+					dsId = H5Dcreate2(getIdentifier(), name.c_str(), fileType, space, H5P_DEFAULT, plist, H5P_DEFAULT);
+					if (plist != H5P_DEFAULT) {
+						H5Pclose(plist);
+					}
+				}
+				catch (...) {
+					H5Sclose(space);
+					H5E_BEGIN_TRY {
+						H5Tclose(memType);
+					} H5E_END_TRY;
+					throw;
+				}
+				H5Sclose(space);
+				// predefined types cannot be closed, compound ones have been created for us
+				H5E_BEGIN_TRY {
+					H5Tclose(memType);
+				} H5E_END_TRY;
 				if (dsId < 0) {
 					throw Exception("Could not create dataset '" + name + "'");
 				}
-				Dataset::Ptr dsPtr = Dataset::Ptr(new hdf5::Dataset(dsId, name));
+				Dataset::Ptr dsPtr = Dataset::Ptr(new hdf5::Dataset(addDaughterHandle(name, dsId), name));
 				dsPtr->write(src);
+				// the snapshot of the constructor predates the allocation of the storage
+				dsPtr->refresh();
 				fDaughters[name] = dsPtr;
+				if (properties.fZoneMap) {
+					createZoneMap(name, properties.fZoneMapFields);
+				}
+				return dsPtr;
+			}
+
+			/**
+			 * Creates one dataset per (name, container) pair of [begin, end), e.g.
+			 * from a std::map<std::string, T> or std::vector<std::pair<std::string, T> >.
+			 *
+			 * Compared to calling createDataset for each element, the element type
+			 * and property lists are created only once, the containers are not
+			 * validated against the freshly created datasets, datasets with at
+			 * most compactThreshold bytes are stored compact in their object
+			 * header and the metadata cache is not flushed before all datasets
+			 * have been written.
+			 *
+			 * @return the created datasets in the order of the input
+			 */
+			template<typename Iterator> std::vector<Dataset::Ptr> createDatasets(Iterator begin, Iterator end, hsize_t compactThreshold = 16384) {
+				typedef typename std::iterator_traits<Iterator>::value_type::second_type Container;
+
+				std::set<std::string> names;
+				for (Iterator it = begin; it != end; ++it) {
+					if (hasObject(it->first)) {
+						throw Exception("Could not create dataset '" + it->first + "' because it already exists");
+					}
+					if (!names.insert(it->first).second) {
+						throw Exception("Could not create dataset '" + it->first + "' because it is given more than once");
+					}
+				}
+
+				std::vector<Dataset::Ptr> result;
+				hid_t memType = ContainerInterface<Container>::hdfElementType();
+				size_t elementSize = H5Tget_size(memType);
+				hid_t compactPlist = DatasetProperties().compact().createPropertyList(1);
+
+				// the group must stay open while its daughters are created
+				HandlePin pin = pinHandle();
+				IoContext context(&fHandle->getManager()->getStatistics(), 0);
+				H5AC_cache_config_t cacheConfig;
+				suspendMetadataFlushes(cacheConfig);
+				try {
+					for (Iterator it = begin; it != end; ++it) {
+						HDF5PP_TRACE_SCOPE(trace, "createDataset", getDaughterPath(it->first));
+						hid_t space = ContainerInterface<Container>::hdfSpace(it->second);
+						hssize_t nElements = H5Sget_simple_extent_npoints(space);
+						HDF5PP_TRACE_BYTES(trace, nElements * elementSize);
+						hid_t plist = (nElements > 0 && nElements * elementSize <= compactThreshold) ? compactPlist : H5P_DEFAULT;
+
+						hid_t dsId = H5Dcreate2(pin.get(), it->first.c_str(), memType, space, H5P_DEFAULT, plist, H5P_DEFAULT);
+						H5Sclose(space);
+						if (dsId < 0) {
+							throw Exception("Could not create dataset '" + it->first + "'");
+						}
+						ObjectHandle::Ptr handle = addDaughterHandle(it->first, dsId);
+						ContainerInterface<Container>::writeData(it->second, dsId, memType);
+						// created after the write, so the snapshot includes the allocated storage
+						Dataset::Ptr dsPtr = Dataset::Ptr(new hdf5::Dataset(handle, it->first));
+						fDaughters.insert(fDaughters.end(), ObjectMap::value_type(it->first, dsPtr));
+						result.push_back(dsPtr);
+					}
+				}
+				catch (...) {
+					H5Pclose(compactPlist);
+					H5E_BEGIN_TRY {
+						H5Tclose(memType);
+					} H5E_END_TRY;
+					resumeMetadataFlushes(cacheConfig);
+					throw;
+				}
+				H5Pclose(compactPlist);
+				// predefined types cannot be closed, compound ones have been created for us
+				H5E_BEGIN_TRY {
+					H5Tclose(memType);
+				} H5E_END_TRY;
+				resumeMetadataFlushes(cacheConfig);
+
+				return result;
+			}
+
+			/**
+			 * Creates a dataset from a map like createDataset() and, next to it,
+			 * the key index "<name>.keyindex" holding every sampleInterval-th
+			 * key. openSortedMap() uses it to find keys by reading a single
+			 * block of sampleInterval entries.
+			 */
+			template<typename Key, typename Value, typename Compare, typename Allocator> Dataset::Ptr createSortedMap(const std::string& name,
+					const std::map<Key, Value, Compare, Allocator>& src, hsize_t sampleInterval = DefaultKeySampleInterval,
+					const DatasetProperties& properties = DatasetProperties()) {
+				if (sampleInterval == 0) {
+					throw Exception("Group::createSortedMap(): Sample interval must be larger than zero");
+				}
+				Dataset::Ptr dsPtr = createDataset(name, src, properties);
+
+				// the map is already in key order
+				std::vector<Key> samples;
+				samples.reserve((src.size() + sampleInterval - 1) / sampleInterval);
+				hsize_t i = 0;
+				for (typename std::map<Key, Value, Compare, Allocator>::const_iterator it = src.begin(); it != src.end(); ++it, ++i) {
+					if (i % sampleInterval == 0) {
+						samples.push_back(it->first);
+					}
+				}
+				writeKeyIndex(name, samples, sampleInterval, src.size());
 				return dsPtr;
 			}
-			Group::Ptr createGroup(std::string& name);
+
+			/**
+			 * Creates or replaces the key index of an existing map dataset,
+			 * e.g. one written by createDataset(). Every sampleInterval-th key
+			 * is read from the dataset.
+			 */
+			template<typename Key, typename Value> Dataset::Ptr createKeyIndex(const std::string& name, hsize_t sampleInterval = DefaultKeySampleInterval) {
+				if (sampleInterval == 0) {
+					throw Exception("Group::createKeyIndex(): Sample interval must be larger than zero");
+				}
+				Dataset::Ptr data = getDataSet(name);
+				hsize_t nEntries = data->getDimension(0);
+				std::vector<Key> samples;
+				{
+					HandlePin pin = data->pinHandle();
+					readMapKeys<Key, Value>(pin.get(), 0, (nEntries + sampleInterval - 1) / sampleInterval, sampleInterval, samples);
+				}
+				return writeKeyIndex(name, samples, sampleInterval, nEntries);
+			}
+
+			/**
+			 * Opens a map dataset for point and range lookups, using its key
+			 * index if there is one.
+			 */
+			template<typename Key, typename Value, typename Compare = std::less<Key> > SortedMapView<Key, Value, Compare> openSortedMap(const std::string& name) {
+				std::string indexName = name + KeyIndexSuffix;
+				return SortedMapView<Key, Value, Compare>(getDataSet(name), hasObject(indexName) ? getDataSet(indexName) : Dataset::Ptr());
+			}
+
+			/**
+			 * Creates the group name holding the rows of src flattened into the
+			 * dataset "values" and their offsets into the dataset "offsets".
+			 * Compared to createDataset(), which stores one variable length
+			 * sequence per row, rows are transferred in bulk and single rows
+			 * can be read without touching the others, see openRaggedArray().
+			 *
+			 * @param properties Creation properties of both datasets
+			 */
+			template<typename T, typename RowAllocator, typename Allocator> Group::Ptr createRaggedArray(const std::string& name,
+					const std::vector<std::vector<T, RowAllocator>, Allocator>& src, const DatasetProperties& properties = DatasetProperties()) {
+				std::vector<uint64_t> offsets(src.size() + 1);
+				offsets[0] = 0;
+				for (size_t i = 0; i < src.size(); ++i) {
+					offsets[i + 1] = offsets[i] + src[i].size();
+				}
+
+				Group::Ptr group = createGroup(name);
+				Dataset::Ptr values = group->createUnwrittenDataset<T>(RaggedValuesName, std::vector<hsize_t>(1, offsets.back()), properties);
+				{
+					// short rows are gathered into batches of bounded size, long ones are written in place
+					HDF5PP_TRACE_SCOPE(trace, "write", values->getPath());
+					HDF5PP_TRACE_BYTES(trace, offsets.back() * sizeof(T));
+					HandlePin pin = values->pinHandle();
+					IoContext context(values->getFileStatistics(), values->getDatasetStatistics());
+					ScratchContext scratch(values->getScratchAllocator());
+					const size_t batchSize = std::max<size_t>(1, RaggedWriteBatchBytes / sizeof(T));
+					std::vector<T> batch;
+					batch.reserve(std::min<size_t>(batchSize, offsets.back()));
+					std::vector<hsize_t> start(1), count(1);
+					for (size_t i = 0; i <= src.size(); ++i) {
+						if (!batch.empty() && (i == src.size() || batch.size() + src[i].size() > batchSize)) {
+							start[0] = offsets[i] - batch.size();
+							count[0] = batch.size();
+							writeHyperslab(pin.get(), start, count, &batch[0]);
+							batch.clear();
+						}
+						if (i == src.size() || src[i].empty()) {
+							continue;
+						}
+						if (src[i].size() >= batchSize) {
+							start[0] = offsets[i];
+							count[0] = src[i].size();
+							writeHyperslab(pin.get(), start, count, &src[i][0]);
+						}
+						else {
+							batch.insert(batch.end(), src[i].begin(), src[i].end());
+						}
+					}
+				}
+				values->refresh();
+				if (properties.fZoneMap) {
+					group->createZoneMap(RaggedValuesName, properties.fZoneMapFields);
+				}
+				group->createDataset(RaggedOffsetsName, offsets, properties);
+				return group;
+			}
+
+			/// opens a ragged array written by createRaggedArray() for reading single rows or row ranges
+			template<typename T> RaggedArrayView<T> openRaggedArray(const std::string& name) {
+				Group::Ptr group = getGroup(name);
+				return RaggedArrayView<T>(group->getDataSet(RaggedValuesName), group->getDataSet(RaggedOffsetsName));
+			}
+
+			/// reads all rows of a ragged array written by createRaggedArray()
+			template<typename T> void readRaggedArray(const std::string& name, std::vector<std::vector<T> >& dst) {
+				openRaggedArray<T>(name).readAll(dst);
+			}
+
+			/**
+			 * Creates the group name holding src in CSR format: the datasets
+			 * "data", "indices" and "indptr" and the attributes "shape" and
+			 * "encoding-type", the layout used by scipy and anndata.
+			 *
+			 * @param properties Creation properties of the three datasets
+			 */
+			template<typename T> Group::Ptr createSparseMatrix(const std::string& name, const SparseMatrix<T>& src, const DatasetProperties& properties = DatasetProperties()) {
+				if (src.indptr.size() != src.rows + 1 || src.indices.size() != src.data.size() || src.indptr.back() != src.data.size()) {
+					throw Exception("Group::createSparseMatrix(): Sizes of data, indices and indptr do not fit the shape");
+				}
+
+				Group::Ptr group = createGroup(name);
+				group->createDataset(SparseDataName, src.data, properties);
+				group->createDataset(SparseIndicesName, src.indices, properties);
+				group->createDataset(SparseIndptrName, src.indptr, properties);
+				std::vector<uint64_t> shape(2);
+				shape[0] = src.rows;
+				shape[1] = src.cols;
+				group->setAttribute(SparseShapeAttribute, shape);
+				group->setAttribute(SparseEncodingAttribute, "csr_matrix");
+				return group;
+			}
+
+			/// opens a sparse matrix written by createSparseMatrix() for reading row ranges
+			template<typename T> SparseMatrixView<T> openSparseMatrix(const std::string& name) {
+				Group::Ptr group = getGroup(name);
+				if (group->hasAttribute(SparseEncodingAttribute) && group->getAttribute<std::string>(SparseEncodingAttribute) != "csr_matrix") {
+					throw Exception("Group::openSparseMatrix(): '" + name + "' is not stored in CSR format");
+				}
+				std::vector<uint64_t> shape;
+				if (!group->hasAttribute(SparseShapeAttribute) || !convertSparseShape(group->getAttributeValue(SparseShapeAttribute), shape)) {
+					throw Exception("Group::openSparseMatrix(): '" + name + "' has no valid shape");
+				}
+				return SparseMatrixView<T>(group->getDataSet(SparseDataName), group->getDataSet(SparseIndicesName), group->getDataSet(SparseIndptrName),
+						shape[0], shape[1]);
+			}
+
+			/// reads a whole sparse matrix written by createSparseMatrix()
+			template<typename T> void readSparseMatrix(const std::string& name, SparseMatrix<T>& dst) {
+				openSparseMatrix<T>(name).readAll(dst);
+			}
+
+			/**
+			 * Creates or replaces the zone map "<name>.zonemap" of a chunked
+			 * rank 1 dataset: minimum, maximum and NaN count of the given fields
+			 * for every chunk. From now on the writes of the dataset are counted
+			 * in its attribute "WriteGeneration", readWhere() ignores the zone
+			 * map once the dataset has been written again until it is recreated.
+			 *
+			 * @param fields Members of a compound dataset, empty for numeric datasets
+			 */
+			Dataset::Ptr createZoneMap(const std::string& name, const std::vector<std::string>& fields = std::vector<std::string>());
+
+			/// zone map of the dataset name, empty if there is none or the dataset has been written since it has been built
+			ZoneMap openZoneMap(const std::string& name);
+
+			/**
+			 * Reads the rows of the rank 1 dataset name matching predicate into
+			 * dst. Chunks excluded by the zone map of the dataset are skipped,
+			 * the other rows are tested against the predicate.
+			 *
+			 * Usage: group.readWhere("events", ZonePredicate().greater("Energy", 5.), events);
+			 *
+			 * @param rowIndices If given, receives the position of each row in the dataset
+			 * @return number of rows that have been read and tested
+			 */
+			template<typename T> hsize_t readWhere(const std::string& name, const ZonePredicate& predicate, std::vector<T>& dst, std::vector<hsize_t>* rowIndices = 0) {
+				Dataset::Ptr dsPtr = getDataSet(name);
+				ZoneMap zones = openZoneMap(name);
+				HDF5PP_TRACE_SCOPE(trace, "read", dsPtr->getPath());
+				HandlePin pin = dsPtr->pinHandle();
+				IoContext context(dsPtr->getFileStatistics(), dsPtr->getDatasetStatistics());
+				ScratchContext scratch(dsPtr->getScratchAllocator());
+				hsize_t nRead = hdf5::readWhere(pin.get(), zones, predicate, dst, rowIndices);
+				HDF5PP_TRACE_BYTES(trace, nRead * dsPtr->getInfo().typeSize);
+				return nRead;
+			}
+
+			/**
+			 * Creates a contiguous dataset of the given extents, allocates its
+			 * storage immediately (without writing fill values), flushes the
+			 * metadata to the file and maps the raw data writable into memory.
+			 *
+			 * This allows producers to fill large datasets in place, e.g. from
+			 * several threads, instead of passing the data through H5Dwrite.
+			 * Call sync() on the returned view to ensure the data is on disk.
+			 *
+			 * @param name Name of the new dataset
+			 * @param extents Size of each of the NumDims dimensions
+			 * @return writable view onto the storage of the new dataset
+			 */
+			template<typename T, std::size_t NumDims> MappedArray<T, NumDims> createMappedDataset(const std::string& name, const std::vector<size_t>& extents) {
+				if (hasObject(name)) {
+					throw Exception("Could not create dataset '" + name + "' because it already exists");
+				}
+				if (!DataType<T>::isPOD()) {
+					throw Exception("Group::createMappedDataset(): Only POD element types can be mapped");
+				}
+				if (extents.size() != NumDims) {
+					throw Exception("Group::createMappedDataset(): Number of extents does not match the rank");
+				}
+
+				HDF5PP_TRACE_SCOPE(trace, "createDataset", getDaughterPath(name));
+				hsize_t dims[NumDims];
+				for (size_t i = 0; i < NumDims; ++i) {
+					dims[i] = extents[i];
+				}
+				hid_t memType = DataType<T>::hdfType();
+				hid_t space = H5Screate_simple(NumDims, dims, 0);
+				HDF5PP_TRACE_BYTES(trace, H5Sget_simple_extent_npoints(space) * sizeof(T));
+				hid_t plist = DatasetProperties().contiguous().allocateEarly().noFill().createPropertyList(NumDims);
+
+				hid_t dsId = H5Dcreate2(getIdentifier(), name.c_str(), memType, space, H5P_DEFAULT, plist, H5P_DEFAULT);
+				H5Pclose(plist);
+				H5Sclose(space);
+				if (dsId < 0) {
+					throw Exception("Could not create dataset '" + name + "'");
+				}
+				Dataset::Ptr dsPtr = Dataset::Ptr(new hdf5::Dataset(addDaughterHandle(name, dsId), name));
+				fDaughters[name] = dsPtr;
+
+				return MappedArray<T, NumDims>(dsPtr->mapRawData(memType, true), extents);
+			}
+			/**
+			 * Creates a new group below this one.
+			 *
+			 * @param name Name of the new group
+			 * @param trackCreationOrder Tracks and indexes the creation order of
+			 * the links in the new group, listLinks() then returns them in this
+			 * order
+			 */
+			Group::Ptr createGroup(const std::string& name, bool trackCreationOrder = false);
 
 		protected:
-			Group(hid_t objectId, const std::string& groupName);
-			void updateGroup(hid_t groupId);
+			Group(const ObjectHandle::Ptr& handle, const std::string& groupName);
+			/// (re)reads all objects below this group
+			void updateGroup();
+			/// registers a daughter of this group at the handle manager, id may be -1
+			ObjectHandle::Ptr addDaughterHandle(const std::string& name, hid_t id);
+			/// absolute path of a daughter of this group
+			std::string getDaughterPath(const std::string& name) const;
+
+			virtual bool hasPendingAttributes() const;
+			virtual void writePendingAttributes();
+			/// throws if the zone map of properties cannot be built for a new dataset of the given rank and type
+			void checkZoneMap(const DatasetProperties& properties, size_t rank, hid_t type) const;
+
+		private:
+			/**
+			 * Creates the dataset name of the given shape with the element type
+			 * of T, its data is written by the caller
+			 */
+			template<typename T> Dataset::Ptr createUnwrittenDataset(const std::string& name, const std::vector<hsize_t>& shape, const DatasetProperties& properties) {
+				if (hasObject(name)) {
+					throw Exception("Could not create dataset '" + name + "' because it already exists");
+				}
+
+				HDF5PP_TRACE_SCOPE(trace, "createDataset", getDaughterPath(name));
+				hid_t memType = DataType<T>::hdfType();
+				hid_t space = H5Screate_simple(shape.size(), shape.data(), 0);
+				hid_t dsId;
+				try {
+					if (properties.fZoneMap) {
+						checkZoneMap(properties, shape.size(), memType);
+					}
+					hid_t plist = properties.createPropertyList(shape, H5Tget_size(memType));
+					dsId = H5Dcreate2(getIdentifier(), name.c_str(), memType, space, H5P_DEFAULT, plist, H5P_DEFAULT);
+					if (plist != H5P_DEFAULT) {
+						H5Pclose(plist);
+					}
+				}
+				catch (...) {
+					H5Sclose(space);
+					H5E_BEGIN_TRY {
+						H5Tclose(memType);
+					} H5E_END_TRY;
+					throw;
+				}
+				H5Sclose(space);
+				H5E_BEGIN_TRY {
+					H5Tclose(memType);
+				} H5E_END_TRY;
+				if (dsId < 0) {
+					throw Exception("Could not create dataset '" + name + "'");
+				}
+				Dataset::Ptr dsPtr = Dataset::Ptr(new hdf5::Dataset(addDaughterHandle(name, dsId), name));
+				fDaughters[name] = dsPtr;
+				return dsPtr;
+			}
 
 		private:
+			/// (re)writes the key index of the map dataset name
+			template<typename Key> Dataset::Ptr writeKeyIndex(const std::string& name, const std::vector<Key>& samples, hsize_t sampleInterval, hsize_t nEntries) {
+				std::string indexName = name + KeyIndexSuffix;
+				if (hasObject(indexName)) {
+					deleteObject(indexName);
+				}
+				// an empty map does not need an index
+				if (samples.empty()) {
+					return Dataset::Ptr();
+				}
+				Dataset::Ptr index = createDataset(indexName, samples);
+				index->setAttribute("SampleInterval", static_cast<uint64_t>(sampleInterval));
+				index->setAttribute("Entries", static_cast<uint64_t>(nEntries));
+				return index;
+			}
+
+			/// state of a link iteration, fills the object tree of group and/or links
+			struct LinkScan {
+					Group* group;
+					std::vector<LinkInfo>* links;
+					std::string error;
+			};
+
+			/// visits all links of groupId in one pass (creation order if indexed)
+			static void iterateLinks(hid_t groupId, LinkScan& scan);
+			static herr_t visitLink(hid_t groupId, const char* name, const H5L_info_t* info, void* data);
+
 			ObjectMap fDaughters;
 	};
 
@@ -0,0 +1,159 @@
+/*
+ * HandleManager.cpp
+ *
+ * Opens HDF5 object handles on demand and limits the number of open ones
+ */
+
+#include "HandleManager.h"
+#include "Exception.h"
+#include "Tracing.h"
+
+using namespace std;
+
+namespace hdf5
+{
+
+	ObjectHandle::ObjectHandle(const boost::shared_ptr<HandleManager>& manager, const std::string& path, hid_t id):
+			fManager(manager), fPath(path), fId(-1), fPins(0)
+	{
+		if (id > -1) {
+			lock_guard<mutex> lock(fManager->fMutex);
+			fId = id;
+			fManager->fOpen.push_front(this);
+			fLruPosition = fManager->fOpen.begin();
+			fManager->evict();
+		}
+	}
+
+	ObjectHandle::~ObjectHandle()
+	{
+		lock_guard<mutex> lock(fManager->fMutex);
+		fManager->close(*this);
+	}
+
+	hid_t ObjectHandle::get()
+	{
+		lock_guard<mutex> lock(fManager->fMutex);
+		fManager->touch(*this);
+		return fId;
+	}
+
+	HandlePin::HandlePin(const ObjectHandle::Ptr& handle): fHandle(handle)
+	{
+		if (fHandle) {
+			lock_guard<mutex> lock(fHandle->fManager->fMutex);
+			// pin before opening, so that the handle cannot be evicted by itself
+			++fHandle->fPins;
+			try {
+				fHandle->fManager->touch(*fHandle);
+			}
+			catch (...) {
+				--fHandle->fPins;
+				throw;
+			}
+		}
+	}
+
+	HandlePin::HandlePin(const HandlePin& original): fHandle(original.fHandle)
+	{
+		if (fHandle) {
+			lock_guard<mutex> lock(fHandle->fManager->fMutex);
+			++fHandle->fPins;
+		}
+	}
+
+	HandlePin::~HandlePin()
+	{
+		if (fHandle) {
+			lock_guard<mutex> lock(fHandle->fManager->fMutex);
+			--fHandle->fPins;
+			if (fHandle->fPins == 0) {
+				fHandle->fManager->evict();
+			}
+		}
+	}
+
+	HandleManager::HandleManager(hid_t fileId, size_t maxOpenObjects): fFileId(fileId), fMaxOpenObjects(maxOpenObjects)
+	{
+		if (H5Iinc_ref(fFileId) < 0) {
+			throw Exception("HandleManager::HandleManager(): Invalid file identifier");
+		}
+	}
+
+	HandleManager::~HandleManager()
+	{
+		// all object handles hold a reference to us, therefore none is left open
+		H5Idec_ref(fFileId);
+	}
+
+	ObjectHandle::Ptr HandleManager::add(const std::string& path, hid_t id)
+	{
+		return ObjectHandle::Ptr(new ObjectHandle(shared_from_this(), path, id));
+	}
+
+	size_t HandleManager::getNumOpenObjects() const
+	{
+		lock_guard<mutex> lock(fMutex);
+		return fOpen.size();
+	}
+
+	void HandleManager::setMaxOpenObjects(size_t maxOpenObjects)
+	{
+		// without a limit the handles are in the order they were opened, which is taken as the order of use
+		lock_guard<mutex> lock(fMutex);
+		fMaxOpenObjects = maxOpenObjects;
+		evict();
+	}
+
+	void HandleManager::touch(ObjectHandle& handle)
+	{
+		if (handle.fId > -1) {
+			// move to front of the LRU list, without a limit the order does not matter
+			if (fMaxOpenObjects > 0) {
+				fOpen.splice(fOpen.begin(), fOpen, handle.fLruPosition);
+			}
+			return;
+		}
+
+		{
+			HDF5PP_TRACE_SCOPE(trace, "open", handle.fPath);
+			IoContext context(&fStatistics, 0);
+			IoTimer timer(IoOpen);
+			handle.fId = H5Oopen(fFileId, handle.fPath.c_str(), H5P_DEFAULT);
+		}
+		if (handle.fId < 0) {
+			throw Exception("HandleManager::touch(): Could not open object '" + handle.fPath + "'");
+		}
+		fOpen.push_front(&handle);
+		handle.fLruPosition = fOpen.begin();
+		evict();
+	}
+
+	void HandleManager::close(ObjectHandle& handle)
+	{
+		if (handle.fId > -1) {
+			H5Oclose(handle.fId);
+			handle.fId = -1;
+			fOpen.erase(handle.fLruPosition);
+		}
+	}
+
+	void HandleManager::evict()
+	{
+		if (fMaxOpenObjects == 0 || fOpen.size() <= fMaxOpenObjects) {
+			return;
+		}
+
+		// the most recently used handle is never closed, it has just been handed out
+		std::list<ObjectHandle*>::iterator it = fOpen.end();
+		--it;
+		while (fOpen.size() > fMaxOpenObjects && it != fOpen.begin()) {
+			ObjectHandle* handle = *it;
+			--it;
+			if (handle->fPins == 0) {
+				close(*handle);
+			}
+		}
+	}
+
+} /* namespace hdf5 */
@@ -0,0 +1,144 @@
+/*
+ * HandleManager.h
+ *
+ * Opens HDF5 object handles on demand and limits the number of open ones
+ */
+
+#ifndef HDF5_HANDLEMANAGER_H_
+#define HDF5_HANDLEMANAGER_H_
+
+#include "Exception.h"
+#include "IoStatistics.h"
+#include "ScratchAllocator.h"
+#include <hdf5.h>
+#include <list>
+#include <mutex>
+#include <string>
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace hdf5
+{
+	class HandleManager;
+
+	/**
+	 * Lightweight descriptor of a group or dataset of a file. The HDF5 handle
+	 * is opened by path when it is needed and may be closed again by the
+	 * HandleManager as soon as too many other handles have been used since.
+	 */
+	class ObjectHandle: private boost::noncopyable
+	{
+		public:
+			typedef boost::shared_ptr<ObjectHandle> Ptr;
+
+			~ObjectHandle();
+
+			/**
+			 * Returns the open HDF5 handle and marks it as most recently used.
+			 * The handle stays valid until another object of the file is
+			 * accessed, use HandlePin to keep it open longer.
+			 */
+			hid_t get();
+
+			inline bool isOpen() const { return fId > -1; }
+			/// absolute path of the object within its file
+			inline const std::string& getPath() const { return fPath; }
+			inline const boost::shared_ptr<HandleManager>& getManager() const { return fManager; }
+
+		private:
+			friend class HandleManager;
+			friend class HandlePin;
+			ObjectHandle(const boost::shared_ptr<HandleManager>& manager, const std::string& path, hid_t id);
+
+			boost::shared_ptr<HandleManager> fManager;
+			std::string fPath;
+			hid_t fId;
+			size_t fPins;
+			std::list<ObjectHandle*>::iterator fLruPosition;
+	};
+
+	/**
+	 * Keeps the handle of an object open as long as the pin exists, e.g. while
+	 * an identifier is used across the creation of other objects.
+	 */
+	class HandlePin
+	{
+		public:
+			explicit HandlePin(const ObjectHandle::Ptr& handle);
+			HandlePin(const HandlePin& original);
+			~HandlePin();
+
+			/// returns the open HDF5 handle of the pinned object
+			inline hid_t get() const { return fHandle ? fHandle->fId : -1; }
+
+		private:
+			HandlePin& operator=(const HandlePin&);
+
+			ObjectHandle::Ptr fHandle;
+	};
+
+	/**
+	 * Keeps track of all object handles of one file. At most maxOpenObjects
+	 * handles are kept open, beyond that the least recently used unpinned
+	 * ones are closed. A limit of 0 means unlimited, then handles stay open
+	 * once they are used and no LRU order is kept.
+	 *
+	 * Unlike the object tree the manager is thread-safe, so datasets of one
+	 * file may be read by several threads at once. With a limit, threads
+	 * must pin the handles they use, since an identifier returned by
+	 * ObjectHandle::get() may be closed by the accesses of other threads.
+	 */
+	class HandleManager: public boost::enable_shared_from_this<HandleManager>, private boost::noncopyable
+	{
+		public:
+			typedef boost::shared_ptr<HandleManager> Ptr;
+
+			/**
+			 * @param fileId File the objects belong to, the manager keeps its
+			 * own reference to the identifier
+			 * @param maxOpenObjects Maximum number of open object handles
+			 */
+			HandleManager(hid_t fileId, size_t maxOpenObjects = 0);
+			~HandleManager();
+
+			/**
+			 * Registers the object at path. If id is a valid handle, it is
+			 * taken over by the manager, otherwise the object is opened when
+			 * it is used for the first time.
+			 */
+			ObjectHandle::Ptr add(const std::string& path, hid_t id = -1);
+
+			inline hid_t getFileId() const { return fFileId; }
+			size_t getNumOpenObjects() const;
+			inline size_t getMaxOpenObjects() const { return fMaxOpenObjects; }
+			/// changes the limit and closes surplus handles immediately
+			void setMaxOpenObjects(size_t maxOpenObjects);
+
+			/// I/O statistics of all objects of the file
+			inline IoStatistics& getStatistics() { return fStatistics; }
+			/// conversion buffers shared by all datasets of the file, see Dataset::getScratchAllocator()
+			inline PoolAllocator& getScratchPool() { return fScratchPool; }
+
+		private:
+			friend class ObjectHandle;
+			friend class HandlePin;
+
+			/// opens the handle if necessary and moves it to the front of the LRU list, fMutex must be held
+			void touch(ObjectHandle& handle);
+			void close(ObjectHandle& handle);
+			/// closes the least recently used unpinned handles beyond the limit, fMutex must be held
+			void evict();
+
+			hid_t fFileId;
+			size_t fMaxOpenObjects;
+			/// open handles, the most recently used one first
+			std::list<ObjectHandle*> fOpen;
+			IoStatistics fStatistics;
+			PoolAllocator fScratchPool;
+			/// guards fOpen and the ids and pins of all handles
+			mutable std::mutex fMutex;
+	};
+
+} /* namespace hdf5 */
+#endif /* HDF5_HANDLEMANAGER_H_ */
@@ -0,0 +1,151 @@
+/*
+ * Hyperslab.h
+ *
+ * Partial reads and writes of datasets
+ */
+
+#ifndef HDF5_HYPERSLAB_H_
+#define HDF5_HYPERSLAB_H_
+
+#include "Exception.h"
+#include "DataTypes.h"
+#include "IoStatistics.h"
+#include "ScratchAllocator.h"
+#include <hdf5.h>
+#include <vector>
+
+namespace hdf5
+{
+	/**
+	 * Reads the hyperslab [start, start+count) of a dataset into dst. The
+	 * elements are stored in C order, dst is resized accordingly.
+	 *
+	 * @param dataSet HDF5 identifier of the dataset
+	 * @param start Offset of the hyperslab in each dimension
+	 * @param count Number of elements in each dimension
+	 * @param dst Container for the elements
+	 */
+	template<typename T> void readHyperslab(hid_t dataSet, const std::vector<hsize_t>& start, const std::vector<hsize_t>& count, std::vector<T>& dst) {
+		typedef typename DataType<T>::PODType POD;
+
+		hsize_t nElements = 1;
+		for (size_t i = 0; i < count.size(); ++i) {
+			nElements *= count[i];
+		}
+		dst.resize(nElements);
+		if (nElements == 0) {
+			return;
+		}
+
+		hid_t fileSpace = H5Dget_space(dataSet);
+		if (fileSpace < 0) {
+			throw Exception("hdf5::readHyperslab(): Could not retrieve dataspace of dataset");
+		}
+		if (H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, &start[0], 0, &count[0], 0) < 0) {
+			H5Sclose(fileSpace);
+			throw Exception("hdf5::readHyperslab(): Could not select hyperslab");
+		}
+		hid_t memSpace = H5Screate_simple(1, &nElements, 0);
+		hid_t memType = DataType<T>::hdfType();
+
+		herr_t status;
+		if (DataType<T>::isPOD()) {
+			// memory layout of container and file type match, read in place
+			IoTimer timer(IoRead, DataType<T>::size() * nElements);
+			status = H5Dread(dataSet, memType, memSpace, fileSpace, H5P_DEFAULT, &dst[0]);
+		}
+		else {
+			ScratchBuffer<POD> rawData(nElements);
+			{
+				IoTimer timer(IoRead, DataType<T>::size() * nElements);
+				status = H5Dread(dataSet, memType, memSpace, fileSpace, H5P_DEFAULT, rawData.get());
+			}
+			if (status > -1) {
+				IoTimer timer(IoConvertFromPOD);
+				for (size_t i = 0; i < nElements; ++i) {
+					DataType<T>::assignFromPOD(rawData[i], dst[i]);
+					DataType<T>::freePOD(rawData[i]);
+				}
+			}
+		}
+
+		// predefined types cannot be closed, compound ones have been created for us
+		H5E_BEGIN_TRY {
+			H5Tclose(memType);
+		} H5E_END_TRY;
+		H5Sclose(memSpace);
+		H5Sclose(fileSpace);
+		if (status < 0) {
+			throw Exception("hdf5::readHyperslab(): Error while reading data from file");
+		}
+	}
+
+	/**
+	 * Writes the elements of src, stored in C order, into the hyperslab
+	 * [start, start+count) of a dataset. Like readHyperslab() it works on the
+	 * bare identifier without a metadata snapshot, so the write generation
+	 * of a zone map is not advanced, see advanceWriteGeneration().
+	 *
+	 * @param dataSet HDF5 identifier of the dataset
+	 * @param start Offset of the hyperslab in each dimension
+	 * @param count Number of elements in each dimension
+	 * @param src Product of count elements
+	 */
+	template<typename T> void writeHyperslab(hid_t dataSet, const std::vector<hsize_t>& start, const std::vector<hsize_t>& count, const T* src) {
+		typedef typename DataType<T>::PODType POD;
+
+		hsize_t nElements = 1;
+		for (size_t i = 0; i < count.size(); ++i) {
+			nElements *= count[i];
+		}
+		if (nElements == 0) {
+			return;
+		}
+
+		hid_t fileSpace = H5Dget_space(dataSet);
+		if (fileSpace < 0) {
+			throw Exception("hdf5::writeHyperslab(): Could not retrieve dataspace of dataset");
+		}
+		if (H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, &start[0], 0, &count[0], 0) < 0) {
+			H5Sclose(fileSpace);
+			throw Exception("hdf5::writeHyperslab(): Could not select hyperslab");
+		}
+		hid_t memSpace = H5Screate_simple(1, &nElements, 0);
+		hid_t memType = DataType<T>::hdfType();
+
+		herr_t status;
+		if (DataType<T>::isPOD()) {
+			// memory layout of container and file type match, write in place
+			IoTimer timer(IoWrite, DataType<T>::size() * nElements);
+			status = H5Dwrite(dataSet, memType, memSpace, fileSpace, H5P_DEFAULT, src);
+		}
+		else {
+			ScratchBuffer<POD> rawData(nElements);
+			{
+				IoTimer timer(IoConvertToPOD);
+				for (size_t i = 0; i < nElements; ++i) {
+					DataType<T>::assignToPOD(src[i], rawData[i]);
+				}
+			}
+			{
+				IoTimer timer(IoWrite, DataType<T>::size() * nElements);
+				status = H5Dwrite(dataSet, memType, memSpace, fileSpace, H5P_DEFAULT, rawData.get());
+			}
+			for (size_t i = 0; i < nElements; ++i) {
+				DataType<T>::freePOD(rawData[i]);
+			}
+		}
+
+		// predefined types cannot be closed, compound ones have been created for us
+		H5E_BEGIN_TRY {
+			H5Tclose(memType);
+		} H5E_END_TRY;
+		H5Sclose(memSpace);
+		H5Sclose(fileSpace);
+		if (status < 0) {
+			throw Exception("hdf5::writeHyperslab(): Error while writing data to file");
+		}
+	}
+
+} /* namespace hdf5 */
+#endif /* HDF5_HYPERSLAB_H_ */
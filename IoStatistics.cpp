@@ -0,0 +1,127 @@
+/*
+ * IoStatistics.cpp
+ *
+ * Lock-free I/O counters and latency histograms
+ */
+
+#include "IoStatistics.h"
+#include <iomanip>
+
+using namespace std;
+
+namespace hdf5
+{
+
+	const char* getIoOperationName(IoOperation operation)
+	{
+		switch (operation) {
+			case IoRead:
+				return "read";
+			case IoWrite:
+				return "write";
+			case IoOpen:
+				return "open";
+			case IoConvertToPOD:
+				return "convertToPOD";
+			case IoConvertFromPOD:
+				return "convertFromPOD";
+			default:
+				return "unknown";
+		}
+	}
+
+	IoSummary::IoSummary(): mdcHitRate(-1), mdcSize(0), chunkCacheSlots(0), chunkCacheBytes(0), chunkCachePreemption(0)
+	{
+		for (size_t op = 0; op < NumIoOperations; ++op) {
+			Operation& o = operations[op];
+			o.calls = o.bytes = o.nanoseconds = 0;
+			for (size_t i = 0; i < NumBuckets; ++i) {
+				o.histogram[i] = 0;
+			}
+		}
+	}
+
+	double IoSummary::Operation::getPercentile(double fraction) const
+	{
+		if (calls == 0) {
+			return 0;
+		}
+		uint64_t threshold = static_cast<uint64_t>(fraction * calls + 0.5);
+		uint64_t sum = 0;
+		for (size_t i = 0; i < NumBuckets; ++i) {
+			sum += histogram[i];
+			if (sum >= threshold && sum > 0) {
+				return static_cast<double>(uint64_t(1) << i) * 1e-9;
+			}
+		}
+		return static_cast<double>(uint64_t(1) << (NumBuckets - 1)) * 1e-9;
+	}
+
+	std::ostream& operator<<(std::ostream& os, const IoSummary& summary)
+	{
+		for (size_t op = 0; op < NumIoOperations; ++op) {
+			const IoSummary::Operation& o = summary.operations[op];
+			os << setw(15) << left << getIoOperationName(static_cast<IoOperation>(op)) << right
+					<< " calls=" << o.calls << " bytes=" << o.bytes << " time=" << o.getSeconds() << "s"
+					<< " p50<" << o.getPercentile(0.5) << "s p99<" << o.getPercentile(0.99) << "s" << endl;
+		}
+		if (summary.mdcHitRate >= 0) {
+			os << "metadata cache: hit rate=" << summary.mdcHitRate << " size=" << summary.mdcSize << endl;
+		}
+		if (summary.chunkCacheSlots > 0) {
+			os << "chunk cache: slots=" << summary.chunkCacheSlots << " bytes=" << summary.chunkCacheBytes
+					<< " w0=" << summary.chunkCachePreemption << endl;
+		}
+		return os;
+	}
+
+	IoStatistics::IoStatistics(size_t nSlots): fNumSlots(nSlots > 0 ? nSlots : 1), fSlots(new Slot[fNumSlots]())
+	{
+	}
+
+	IoStatistics::~IoStatistics()
+	{
+		delete[] fSlots;
+	}
+
+	size_t IoStatistics::getThreadIndex()
+	{
+		static std::atomic<size_t> nextIndex(0);
+		static thread_local size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+		return index;
+	}
+
+	IoSummary IoStatistics::getSummary() const
+	{
+		IoSummary summary;
+		for (size_t iSlot = 0; iSlot < fNumSlots; ++iSlot) {
+			for (size_t op = 0; op < NumIoOperations; ++op) {
+				const Counters& c = fSlots[iSlot].operations[op];
+				IoSummary::Operation& o = summary.operations[op];
+				o.calls += c.calls.load(std::memory_order_relaxed);
+				o.bytes += c.bytes.load(std::memory_order_relaxed);
+				o.nanoseconds += c.nanoseconds.load(std::memory_order_relaxed);
+				for (size_t i = 0; i < IoSummary::NumBuckets; ++i) {
+					o.histogram[i] += c.histogram[i].load(std::memory_order_relaxed);
+				}
+			}
+		}
+		return summary;
+	}
+
+	void IoStatistics::reset()
+	{
+		for (size_t iSlot = 0; iSlot < fNumSlots; ++iSlot) {
+			for (size_t op = 0; op < NumIoOperations; ++op) {
+				Counters& c = fSlots[iSlot].operations[op];
+				c.calls.store(0, std::memory_order_relaxed);
+				c.bytes.store(0, std::memory_order_relaxed);
+				c.nanoseconds.store(0, std::memory_order_relaxed);
+				for (size_t i = 0; i < IoSummary::NumBuckets; ++i) {
+					c.histogram[i].store(0, std::memory_order_relaxed);
+				}
+			}
+		}
+	}
+
+} /* namespace hdf5 */
@@ -0,0 +1,178 @@
+/*
+ * IoStatistics.h
+ *
+ * Lock-free I/O counters and latency histograms
+ */
+
+#ifndef HDF5_IOSTATISTICS_H_
+#define HDF5_IOSTATISTICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <stdint.h>
+#include <boost/noncopyable.hpp>
+
+namespace hdf5
+{
+	/// operations accounted in IoStatistics
+	enum IoOperation {
+		IoRead = 0,       ///< H5Dread calls
+		IoWrite,          ///< H5Dwrite calls
+		IoOpen,           ///< opening of groups and datasets
+		IoConvertToPOD,   ///< assignToPOD of the elements before a write
+		IoConvertFromPOD, ///< assignFromPOD of the elements after a read
+		NumIoOperations
+	};
+
+	const char* getIoOperationName(IoOperation operation);
+
+	/**
+	 * Plain copy of the counters of IoStatistics at one point in time
+	 */
+	struct IoSummary {
+			/// histogram bucket i counts calls taking less than 2^i ns (and at least 2^(i-1) ns)
+			static const size_t NumBuckets = 40;
+
+			struct Operation {
+					uint64_t calls;
+					uint64_t bytes;
+					uint64_t nanoseconds;
+					uint64_t histogram[NumBuckets];
+
+					inline double getSeconds() const { return nanoseconds * 1e-9; }
+					/// upper bound of the latency in seconds of the given fraction (0..1) of all calls
+					double getPercentile(double fraction) const;
+			};
+
+			Operation operations[NumIoOperations];
+
+			/// hit rate of the metadata cache since the last reset (files only, -1 if unknown)
+			double mdcHitRate;
+			/// current size of the metadata cache in bytes (files only)
+			size_t mdcSize;
+
+			/// chunk cache configuration (chunked datasets only)
+			size_t chunkCacheSlots;
+			size_t chunkCacheBytes;
+			double chunkCachePreemption;
+
+			IoSummary();
+
+			inline const Operation& operator[](IoOperation operation) const { return operations[operation]; }
+	};
+
+	std::ostream& operator<<(std::ostream& os, const IoSummary& summary);
+
+	/**
+	 * Counts calls, bytes and time per IoOperation and keeps a log2 latency
+	 * histogram of each.
+	 *
+	 * Every thread records into one of several slots, selected by a thread
+	 * local index, with relaxed atomic additions. Recording therefore takes
+	 * no locks and threads rarely share cache lines. getSummary() adds up
+	 * all slots.
+	 */
+	class IoStatistics: private boost::noncopyable
+	{
+		public:
+			explicit IoStatistics(size_t nSlots = 16);
+			~IoStatistics();
+
+			inline void record(IoOperation operation, uint64_t bytes, uint64_t nanoseconds) {
+				Counters& counters = fSlots[getThreadIndex() % fNumSlots].operations[operation];
+				counters.calls.fetch_add(1, std::memory_order_relaxed);
+				counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+				counters.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+				counters.histogram[getBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+			}
+
+			IoSummary getSummary() const;
+			void reset();
+
+		private:
+			struct Counters {
+					std::atomic<uint64_t> calls;
+					std::atomic<uint64_t> bytes;
+					std::atomic<uint64_t> nanoseconds;
+					std::atomic<uint64_t> histogram[IoSummary::NumBuckets];
+			};
+			struct Slot {
+					Counters operations[NumIoOperations];
+					/// keeps neighbouring slots off the same cache line
+					char padding[64];
+			};
+
+			static inline size_t getBucket(uint64_t nanoseconds) {
+				size_t bucket = nanoseconds ? 64 - __builtin_clzll(nanoseconds) : 0;
+				return bucket < IoSummary::NumBuckets ? bucket : IoSummary::NumBuckets - 1;
+			}
+			/// small number assigned to each thread on its first record
+			static size_t getThreadIndex();
+
+			size_t fNumSlots;
+			Slot* fSlots;
+	};
+
+	/**
+	 * Statistics that the operations of the current thread are accounted to.
+	 * Dataset installs a context for the duration of each read and write, the
+	 * container interfaces record into it through IoTimer.
+	 */
+	class IoContext: private boost::noncopyable
+	{
+		public:
+			IoContext(IoStatistics* file, IoStatistics* dataset): fFile(file), fDataset(dataset), fPrevious(current()) {
+				current() = this;
+			}
+			~IoContext() { current() = fPrevious; }
+
+			inline void record(IoOperation operation, uint64_t bytes, uint64_t nanoseconds) {
+				if (fFile) {
+					fFile->record(operation, bytes, nanoseconds);
+				}
+				if (fDataset) {
+					fDataset->record(operation, bytes, nanoseconds);
+				}
+			}
+
+			/// context of the current thread, 0 if none is installed
+			static inline IoContext*& current() {
+				static thread_local IoContext* context = 0;
+				return context;
+			}
+
+		private:
+			IoStatistics* fFile;
+			IoStatistics* fDataset;
+			IoContext* fPrevious;
+	};
+
+	/**
+	 * Measures its own lifetime and records it as one call of operation in
+	 * the context of the current thread. Without context nothing is measured.
+	 */
+	class IoTimer: private boost::noncopyable
+	{
+		public:
+			IoTimer(IoOperation operation, uint64_t bytes = 0): fContext(IoContext::current()), fOperation(operation), fBytes(bytes) {
+				if (fContext) {
+					fStart = std::chrono::steady_clock::now();
+				}
+			}
+			~IoTimer() {
+				if (fContext) {
+					std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - fStart;
+					fContext->record(fOperation, fBytes, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+				}
+			}
+
+		private:
+			IoContext* fContext;
+			IoOperation fOperation;
+			uint64_t fBytes;
+			std::chrono::steady_clock::time_point fStart;
+	};
+
+} /* namespace hdf5 */
+#endif /* HDF5_IOSTATISTICS_H_ */
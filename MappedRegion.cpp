@@ -0,0 +1,69 @@
+/*
+ * MappedRegion.cpp
+ */
+
+#include "MappedRegion.h"
+#include <sstream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+namespace hdf5
+{
+
+	MappedRegion::MappedRegion(const std::string& fileName, haddr_t offset, size_t size, bool writable):
+		fMapping(0), fMappingLength(0), fData(0), fSize(size), fWritable(writable)
+	{
+		if (size == 0) {
+			return;
+		}
+
+		int fd = open(fileName.c_str(), writable ? O_RDWR : O_RDONLY);
+		if (fd < 0) {
+			stringstream ss;
+			ss << "MappedRegion: Could not open file \"" << fileName << "\": " << strerror(errno);
+			throw Exception(ss);
+		}
+
+		// mmap requires the file offset to be a multiple of the page size
+		const haddr_t pageSize = static_cast<haddr_t>(sysconf(_SC_PAGESIZE));
+		const haddr_t alignedOffset = offset - (offset % pageSize);
+		const size_t delta = static_cast<size_t>(offset - alignedOffset);
+
+		fMappingLength = size + delta;
+		int protection = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+		fMapping = mmap(0, fMappingLength, protection, MAP_SHARED, fd, static_cast<off_t>(alignedOffset));
+		int mapErrno = errno;
+		// the mapping holds its own reference to the file
+		close(fd);
+
+		if (fMapping == MAP_FAILED) {
+			fMapping = 0;
+			stringstream ss;
+			ss << "MappedRegion: Could not map " << size << " bytes at offset " << offset << " of \"" << fileName << "\": " << strerror(mapErrno);
+			throw Exception(ss);
+		}
+		fData = static_cast<char*>(fMapping) + delta;
+	}
+
+	MappedRegion::~MappedRegion()
+	{
+		if (fMapping) {
+			munmap(fMapping, fMappingLength);
+		}
+	}
+
+	void MappedRegion::sync()
+	{
+		if (fMapping && fWritable && msync(fMapping, fMappingLength, MS_SYNC) != 0) {
+			stringstream ss;
+			ss << "MappedRegion::sync(): msync failed: " << strerror(errno);
+			throw Exception(ss);
+		}
+	}
+
+} /* namespace hdf5 */
@@ -0,0 +1,106 @@
+/*
+ * MappedRegion.h
+ *
+ * Memory mapping of the raw data of contiguous datasets
+ */
+
+#ifndef HDF5_MAPPEDREGION_H_
+#define HDF5_MAPPEDREGION_H_
+
+#include "Exception.h"
+#include <hdf5.h>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/multi_array.hpp>
+
+namespace hdf5
+{
+	/**
+	 * Owns an mmap of a byte range of an HDF5 file.
+	 *
+	 * The mapping bypasses the HDF5 library completely, therefore it is only
+	 * valid for datasets whose raw data is stored as one contiguous, unfiltered
+	 * block inside the file (see Dataset::map()). The mapping stays valid even
+	 * if the dataset or the file are closed.
+	 */
+	class MappedRegion
+	{
+		public:
+			typedef boost::shared_ptr<MappedRegion> Ptr;
+
+			/**
+			 * Maps size bytes starting at offset of fileName.
+			 * @param fileName file to map
+			 * @param offset absolute byte offset within the file
+			 * @param size number of bytes to map
+			 * @param writable map read & write (MAP_SHARED) instead of read-only
+			 */
+			MappedRegion(const std::string& fileName, haddr_t offset, size_t size, bool writable);
+			virtual ~MappedRegion();
+
+			inline const void* data() const { return fData; }
+			inline void* data() { return fData; }
+			inline size_t size() const { return fSize; }
+			inline bool isWritable() const { return fWritable; }
+
+			/// writes modified pages of a writable mapping synchronously back to the file
+			void sync();
+
+		private:
+			MappedRegion(const MappedRegion&);
+			MappedRegion& operator=(const MappedRegion&);
+
+			void* fMapping;
+			size_t fMappingLength;
+			void* fData;
+			size_t fSize;
+			bool fWritable;
+	};
+
+	/**
+	 * Read-only multi_array view onto a mapped dataset. The view keeps the
+	 * mapping alive, copies of it share the same mapping.
+	 */
+	template<typename T, std::size_t NumDims> class ConstMappedArray: public boost::const_multi_array_ref<T, NumDims>
+	{
+		public:
+			typedef boost::const_multi_array_ref<T, NumDims> ArrayRef;
+
+			ConstMappedArray(const MappedRegion::Ptr& region, const std::vector<size_t>& extents):
+				ArrayRef(static_cast<const T*>(region->data()), extents), fRegion(region) {}
+
+			inline const MappedRegion::Ptr& getRegion() const { return fRegion; }
+
+		private:
+			MappedRegion::Ptr fRegion;
+	};
+
+	/**
+	 * Writable multi_array view onto a mapped dataset. Elements can be written
+	 * concurrently from several threads, as long as they do not touch the same
+	 * elements. The HDF5 library does not know about these writes, so the
+	 * dataset must not be read or written through HDF5 while it is mapped.
+	 */
+	template<typename T, std::size_t NumDims> class MappedArray: public boost::multi_array_ref<T, NumDims>
+	{
+		public:
+			typedef boost::multi_array_ref<T, NumDims> ArrayRef;
+
+			MappedArray(const MappedRegion::Ptr& region, const std::vector<size_t>& extents):
+				ArrayRef(static_cast<T*>(region->data()), extents), fRegion(region) {}
+			MappedArray(const MappedArray& original): ArrayRef(original), fRegion(original.fRegion) {}
+
+			inline const MappedRegion::Ptr& getRegion() const { return fRegion; }
+			/// writes the data synchronously to the file
+			inline void sync() { fRegion->sync(); }
+
+		private:
+			// multi_array_ref would copy the elements instead of the view
+			MappedArray& operator=(const MappedArray&);
+
+			MappedRegion::Ptr fRegion;
+	};
+
+} /* namespace hdf5 */
+#endif /* HDF5_MAPPEDREGION_H_ */
@@ -20,7 +20,7 @@ using namespace std;
 namespace hdf5
 {
 
-	Object::Object() : fType(Unknown), fObjectId(-1)
+	Object::Object() : fType(Unknown)
 	{
 		// TODO Auto-generated constructor stub
 
@@ -31,7 +31,10 @@ namespace hdf5
 		operator=(original);
 	}
 
-	Object::~Object() {}
+	Object::~Object()
+	{
+		discardPendingAttributes();
+	}
 
 	Object& Object::operator=(const Object& original)
 	{
@@ -45,37 +48,53 @@ namespace hdf5
 	{
 		fAttributes.clear();
 
-		if (fObjectId < 0)
+		if (!fHandle)
 			return;
 
-		// get attributes
-		int nAttrs = H5Aget_num_attrs(fObjectId);
+		hid_t objectId = fHandle->get();
+		int nAttrs = H5Aget_num_attrs(objectId);
 		if (nAttrs < 0) {
 			throw Exception("Could not retrieve number of attributes");
 		}
 
+		char nameBuffer[256];
 		for (size_t iAttr = 0; iAttr < static_cast<size_t>(nAttrs); ++iAttr) {
-			char* attrName;
 			char objName[] = ".";
-			ssize_t nameLen = H5Aget_name_by_idx(fObjectId, objName, H5_INDEX_NAME, H5_ITER_INC, iAttr, 0, 0, H5P_DEFAULT);
+			ssize_t nameLen = H5Aget_name_by_idx(objectId, objName, H5_INDEX_NAME, H5_ITER_INC, iAttr, nameBuffer, sizeof(nameBuffer), H5P_DEFAULT);
 
 			if (nameLen > 0) {
-				// fetch name of this attribute
-				attrName = new char[++nameLen];
-				H5Aget_name_by_idx(fObjectId, objName, H5_INDEX_NAME, H5_ITER_INC, iAttr, attrName, nameLen, H5P_DEFAULT);
-				string sAttrName(attrName);
-				delete[] attrName;
+				// fetch name of this attribute, only long names need a second call
+				string sAttrName;
+				if (static_cast<size_t>(nameLen) < sizeof(nameBuffer)) {
+					sAttrName.assign(nameBuffer, nameLen);
+				}
+				else {
+					sAttrName.resize(nameLen + 1);
+					H5Aget_name_by_idx(objectId, objName, H5_INDEX_NAME, H5_ITER_INC, iAttr, &sAttrName[0], nameLen + 1, H5P_DEFAULT);
+					sAttrName.resize(nameLen);
+				}
 
 				// open attribute
-				hid_t attrId = H5Aopen_by_idx(fObjectId, objName, H5_INDEX_NAME, H5_ITER_INC, iAttr, H5P_DEFAULT, H5P_DEFAULT);
+				HDF5PP_TRACE_SCOPE(trace, "decodeAttribute", getPath() + "@" + sAttrName);
+				hid_t attrId = H5Aopen_by_idx(objectId, objName, H5_INDEX_NAME, H5_ITER_INC, iAttr, H5P_DEFAULT, H5P_DEFAULT);
 				if (attrId < 0) {
 					cerr << "Could not open attribute '" << sAttrName << "'" << endl;
 					continue;
 				}
 
+				HDF5PP_TRACE_BYTES(trace, H5Aget_storage_size(attrId));
+
 				// parse type info
 //				cout << "Reading attribute: " << sAttrName << endl;
-				fAttributes[sAttrName] = llReadAttribute(attrId);
+				// one attribute which cannot be decoded must not fail the whole object
+				try {
+					AttributeValue value = llReadAttribute(attrId);
+					// names are visited in increasing order, so appending is constant time
+					fAttributes.emplace_hint(fAttributes.end(), std::move(sAttrName), std::move(value));
+				}
+				catch (const exception& e) {
+					cerr << "Could not decode attribute '" << sAttrName << "': " << e.what() << endl;
+				}
 
 				// close attribute
 				H5Aclose(attrId);
@@ -84,6 +103,152 @@ namespace hdf5
 	}
 
 
+	void Object::releasePending(PendingAttribute& attribute)
+	{
+		if (attribute.release) {
+			attribute.release(attribute);
+		}
+		if (attribute.memType > -1) {
+			H5Tclose(attribute.memType);
+			attribute.memType = -1;
+		}
+	}
+
+	AttributeValue Object::decodePending(PendingAttribute& attribute)
+	{
+		HdfType type;
+		type.dataType = attribute.memType;
+		type.typeClass = H5Tget_class(attribute.memType);
+
+		RawData data;
+		data.rank = attribute.dims.size();
+		data.dimensions = attribute.dims.empty() ? 0 : &attribute.dims[0];
+		data.typeSize = AttributeData::getElementSize(type);
+		data.memorySize = attribute.buffer.size();
+		data.memory = &attribute.buffer[0];
+		// the strings are still needed for the write
+		data.releaseStrings = false;
+		return AttributeData::parseValue(type, data);
+	}
+
+	void Object::discardPendingAttributes()
+	{
+		for (PendingAttributeMap::iterator it = fPendingAttributes.begin(); it != fPendingAttributes.end(); ++it) {
+			releasePending(it->second);
+		}
+		fPendingAttributes.clear();
+	}
+
+	void Object::flushAttributes()
+	{
+		if (!hasPendingAttributes()) {
+			return;
+		}
+		if (!fHandle) {
+			throw Exception("Object::flushAttributes(): Object '" + fName + "' is not open");
+		}
+		H5AC_cache_config_t cacheConfig;
+		suspendMetadataFlushes(cacheConfig);
+		try {
+			writePendingAttributes();
+		}
+		catch (...) {
+			resumeMetadataFlushes(cacheConfig);
+			throw;
+		}
+		resumeMetadataFlushes(cacheConfig);
+	}
+
+	void Object::writePendingAttributes()
+	{
+		if (fPendingAttributes.empty()) {
+			return;
+		}
+		if (!fHandle) {
+			throw Exception("Object::flushAttributes(): Object '" + fName + "' is not open");
+		}
+		HandlePin pin = pinHandle();
+		hid_t objectId = pin.get();
+
+		while (!fPendingAttributes.empty()) {
+			PendingAttributeMap::iterator it = fPendingAttributes.begin();
+			const std::string& name = it->first;
+			PendingAttribute& attribute = it->second;
+
+			hid_t space;
+			if (attribute.dims.empty()) {
+				space = H5Screate(H5S_SCALAR);
+			}
+			else {
+				space = H5Screate_simple(attribute.dims.size(), &attribute.dims[0], 0);
+			}
+
+			// attributes cannot be resized or retyped, therefore existing ones are only overwritten if both match
+			bool success = true;
+			hid_t attrId;
+			H5E_BEGIN_TRY {
+				attrId = H5Aopen(objectId, name.c_str(), H5P_DEFAULT);
+			} H5E_END_TRY;
+			if (attrId > -1) {
+				hid_t fileType = H5Aget_type(attrId);
+				hid_t fileSpace = H5Aget_space(attrId);
+				bool matches = H5Tequal(fileType, attribute.memType) > 0 && H5Sextent_equal(fileSpace, space) > 0;
+				H5Sclose(fileSpace);
+				H5Tclose(fileType);
+				if (!matches) {
+					H5Aclose(attrId);
+					attrId = -1;
+					success = H5Adelete(objectId, name.c_str()) > -1;
+				}
+			}
+			if (success && attrId < 0) {
+				attrId = H5Acreate2(objectId, name.c_str(), attribute.memType, space, H5P_DEFAULT, H5P_DEFAULT);
+			}
+			success = success && attrId > -1 && H5Awrite(attrId, attribute.memType, &attribute.buffer[0]) > -1;
+			if (attrId > -1) {
+				H5Aclose(attrId);
+			}
+			H5Sclose(space);
+
+			string failedName = name;
+			releasePending(attribute);
+			fPendingAttributes.erase(it);
+			if (!success) {
+				throw Exception("Object::flushAttributes(): Could not write attribute '" + failedName + "' of '" + fName + "'");
+			}
+		}
+	}
+
+	void Object::suspendMetadataFlushes(H5AC_cache_config_t& savedConfig)
+	{
+		hid_t fileId = H5Iget_file_id(getIdentifier());
+		savedConfig.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+		if (H5Fget_mdc_config(fileId, &savedConfig) < 0) {
+			H5Fclose(fileId);
+			throw Exception("Object::suspendMetadataFlushes(): Could not retrieve metadata cache configuration");
+		}
+
+		// evictions can only be disabled if the cache does not resize automatically
+		H5AC_cache_config_t config = savedConfig;
+		config.evictions_enabled = false;
+		config.incr_mode = H5C_incr__off;
+		config.flash_incr_mode = H5C_flash_incr__off;
+		config.decr_mode = H5C_decr__off;
+		config.set_initial_size = false;
+		H5Fset_mdc_config(fileId, &config);
+		H5Fclose(fileId);
+	}
+
+	void Object::resumeMetadataFlushes(const H5AC_cache_config_t& savedConfig)
+	{
+		hid_t fileId = H5Iget_file_id(getIdentifier());
+		H5AC_cache_config_t config = savedConfig;
+		config.set_initial_size = false;
+		H5Fset_mdc_config(fileId, &config);
+		H5Fflush(fileId, H5F_SCOPE_LOCAL);
+		H5Fclose(fileId);
+	}
+
 	Object::TypeName Object::getStlType(hid_t hType) const
 	{
 		H5T_class_t attrType = H5Tget_class(hType);
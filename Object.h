@@ -9,16 +9,20 @@
 #define HDF5_OBJECT_H_
 
 #include "hdfLLReading.h"
+#include "Exception.h"
+#include "DataTypes.h"
+#include "AttributeValue.h"
+#include "HandleManager.h"
+#include "Tracing.h"
 #include <map>
 #include <string>
-#include <boost/any.hpp>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 #include <hdf5.h>
 
 namespace hdf5
 {
-	typedef any Attribute;
-	typedef std::map<std::string, Attribute> CompoundAttribute;
+	typedef AttributeValue Attribute;
 
 //	struct Type {
 //			std::type_info typeInfo;
@@ -44,6 +48,19 @@ namespace hdf5
 			Object& operator=(const Object& original);
 
 			const std::string& getName() const { return fName; }
+			/// absolute path of the object within its file
+			std::string getPath() const { return fHandle ? fHandle->getPath() : std::string(); }
+
+			/**
+			 * Returns the HDF5 identifier to directly use C methods on the object.
+			 *
+			 * If the file was opened with a limit of open objects, the handle is
+			 * opened on demand and may be closed again once other objects have
+			 * been used. Keep a pinHandle() while the identifier is needed longer.
+			 */
+			hid_t getIdentifier() const { return fHandle ? fHandle->get() : -1; }
+			/// keeps the HDF5 identifier of this object open as long as the pin exists
+			HandlePin pinHandle() const { return HandlePin(fHandle); }
 
 			/// returns type of HdfObject
 			inline ObjectType getType() const { return fType; }
@@ -55,18 +72,59 @@ namespace hdf5
 			template <typename T> T& getAttribute(const std::string& name) {
 				AttributeIterator it = fAttributes.find(name);
 				if (it != fAttributes.end())
-					return boost::any_cast<T&>(it->second);
+					return it->second.get<T>();
 				else
 					throw std::out_of_range("Attribute \"" + name + "\" not found!");
 			}
 			template <typename T> const T& getAttribute(const std::string& name) const {
 				AttributeConstIterator it = fAttributes.find(name);
 				if (it != fAttributes.end())
-					return boost::any_cast<const T&>(it->second);
+					return it->second.get<T>();
 				else
 					throw std::out_of_range("Attribute \"" + name + "\" not found!");
 			}
-//			inline void setAttribute(const std::string& name, const Attribute& value) { fAttributes[name] = value; };
+			/// type erased value of an attribute, e.g. to test its type with is<T>()
+			const AttributeValue& getAttributeValue(const std::string& name) const {
+				AttributeConstIterator it = fAttributes.find(name);
+				if (it != fAttributes.end())
+					return it->second;
+				else
+					throw std::out_of_range("Attribute \"" + name + "\" not found!");
+			}
+
+			/**
+			 * Sets a scalar attribute of any type with a DataType<T> specialisation,
+			 * including compound types.
+			 *
+			 * Attributes are not written immediately. They are staged in memory and
+			 * written all together by flushAttributes(), which is called when the
+			 * object or file is flushed or closed. Setting the same attribute twice
+			 * before that writes it only once. getAttribute() returns the new value
+			 * right away, decoded as it is after reopening the file, e.g. compound
+			 * values as CompoundAttribute.
+			 */
+			template<typename T> void setAttribute(const std::string& name, const T& value) {
+				stageAttribute(name, &value, 1, std::vector<hsize_t>());
+			}
+			/// sets an attribute of rank 1
+			template<typename T> void setAttribute(const std::string& name, const std::vector<T>& value) {
+				if (value.empty()) {
+					throw Exception("Object::setAttribute(): Attribute \"" + name + "\" must not be empty");
+				}
+				stageAttribute(name, &value[0], value.size(), std::vector<hsize_t>(1, value.size()));
+			}
+			/// sets a string attribute
+			void setAttribute(const std::string& name, const char* value) { setAttribute(name, std::string(value)); }
+
+			/// number of attributes which have not been written to the file yet
+			inline size_t getNumPendingAttributes() const { return fPendingAttributes.size(); }
+			/**
+			 * Writes all staged attributes to the file, for groups also those of
+			 * the objects below. Existing attributes of the same type and shape
+			 * are overwritten in place, other ones of the same name are replaced.
+			 * Metadata stays in the cache until all attributes are written.
+			 */
+			virtual void flushAttributes();
 			inline AttributeConstIterator attributesBegin() const { return fAttributes.begin(); }
 			inline AttributeConstIterator attributesEnd() const { return fAttributes.end(); }
 			inline AttributeIterator attributesBegin() { return fAttributes.begin(); }
@@ -75,14 +133,93 @@ namespace hdf5
 		protected:
 			ObjectType fType;
 			std::string fName;
-			hid_t fObjectId;
+			ObjectHandle::Ptr fHandle;
 
 			void updateAttributes();
 
 			TypeName getStlType(hid_t hdfTypeId) const;
 
+			/// drops all staged attributes without writing them
+			void discardPendingAttributes();
+			/// true if this object or, for groups, one below has staged attributes
+			virtual bool hasPendingAttributes() const { return !fPendingAttributes.empty(); }
+			/// writes the staged attributes of this object or, for groups, of all objects below
+			virtual void writePendingAttributes();
+
+			/// keeps all metadata in the cache until resumeMetadataFlushes is called
+			void suspendMetadataFlushes(H5AC_cache_config_t& savedConfig);
+			/// restores the cache configuration and flushes the metadata to the file
+			void resumeMetadataFlushes(const H5AC_cache_config_t& savedConfig);
+
 		private:
+			friend class Group;
+
+			/**
+			 * Attribute value converted to its POD representation, waiting to be
+			 * written to the file.
+			 */
+			struct PendingAttribute {
+					hid_t memType;
+					std::vector<hsize_t> dims;
+					size_t nElements;
+					std::vector<char> buffer;
+					/// frees memory held by the POD elements (e.g. strings)
+					void (*release)(PendingAttribute& attribute);
+
+					PendingAttribute(): memType(-1), nElements(0), release(0) {}
+			};
+			typedef std::map<std::string, PendingAttribute> PendingAttributeMap;
+
+			template<typename T> static void releasePOD(PendingAttribute& attribute) {
+				typedef typename DataType<T>::PODType POD;
+				POD* pods = reinterpret_cast<POD*>(&attribute.buffer[0]);
+				for (size_t i = 0; i < attribute.nElements; ++i) {
+					DataType<T>::freePOD(pods[i]);
+				}
+				attribute.nElements = 0;
+			}
+
+			/// stages the values and caches them decoded from the staged memory
+			template<typename T> void stageAttribute(const std::string& name, const T* values, size_t nElements, const std::vector<hsize_t>& dims) {
+				typedef typename DataType<T>::PODType POD;
+
+				PendingAttribute staged;
+				hid_t memType = DataType<T>::hdfType();
+				staged.memType = H5Tcopy(memType);
+				// predefined types cannot be closed, string and compound ones have been created for us
+				H5E_BEGIN_TRY {
+					H5Tclose(memType);
+				} H5E_END_TRY;
+				staged.dims = dims;
+				staged.buffer.resize(nElements * sizeof(POD));
+				staged.release = &Object::releasePOD<T>;
+
+				AttributeValue decoded;
+				try {
+					POD* pods = reinterpret_cast<POD*>(&staged.buffer[0]);
+					for (size_t i = 0; i < nElements; ++i) {
+						DataType<T>::assignToPOD(values[i], pods[i]);
+						staged.nElements = i + 1;
+					}
+					decoded = decodePending(staged);
+				}
+				catch (...) {
+					releasePending(staged);
+					throw;
+				}
+
+				PendingAttribute& attribute = fPendingAttributes[name];
+				releasePending(attribute);
+				attribute = std::move(staged);
+				fAttributes[name] = std::move(decoded);
+			}
+
+			static void releasePending(PendingAttribute& attribute);
+			/// the value of a staged attribute as updateAttributes() decodes it, throws if it cannot be decoded
+			static AttributeValue decodePending(PendingAttribute& attribute);
+
 			AttributeMap fAttributes;
+			PendingAttributeMap fPendingAttributes;
 	};
 
 } /* namespace hdf5 */
@@ -0,0 +1,125 @@
+/*
+ * RaggedArray.h
+ *
+ * Rows of different length stored as flattened values plus row offsets
+ */
+
+#ifndef HDF5_RAGGEDARRAY_H_
+#define HDF5_RAGGEDARRAY_H_
+
+#include "Exception.h"
+#include "Dataset.h"
+#include "Hyperslab.h"
+#include <hdf5.h>
+#include <stdint.h>
+#include <vector>
+
+namespace hdf5
+{
+	/// name of the dataset holding the values of all rows of a ragged array
+	const char* const RaggedValuesName = "values";
+	/// name of the dataset holding the first value of each row, plus the total number of values
+	const char* const RaggedOffsetsName = "offsets";
+	/// largest batch of short rows Group::createRaggedArray() gathers for a single write
+	const size_t RaggedWriteBatchBytes = 4 << 20;
+
+	/**
+	 * Gives access to a ragged array written by Group::createRaggedArray(),
+	 * i.e. a group with the datasets "values" (all rows concatenated) and
+	 * "offsets" (rows+1 entries, row i is [offsets[i], offsets[i+1]) ).
+	 *
+	 * Single rows and row ranges are read through hyperslabs, nothing
+	 * besides the requested rows and their offsets is touched.
+	 *
+	 * Usage:
+	 *   RaggedArrayView<float> hits = group.openRaggedArray<float>("hits");
+	 *   std::vector<float> event;
+	 *   hits.readRow(42, event);
+	 */
+	template<typename T> class RaggedArrayView
+	{
+		public:
+			typedef std::vector<T> Row;
+
+			/**
+			 * @param values Dataset holding the concatenated rows
+			 * @param offsets Dataset holding the row offsets
+			 */
+			RaggedArrayView(const Dataset::Ptr& values, const Dataset::Ptr& offsets): fValues(values), fOffsets(offsets), fNumRows(0), fNumValues(0) {
+				if (!fValues || !fOffsets) {
+					throw Exception("RaggedArrayView: No dataset given");
+				}
+				if (fValues->getRank() != 1 || fOffsets->getRank() != 1) {
+					throw Exception("RaggedArrayView: Values and offsets have to be of rank 1");
+				}
+				if (fOffsets->getDimension(0) == 0) {
+					throw Exception("RaggedArrayView: Offsets must not be empty");
+				}
+				fNumRows = fOffsets->getDimension(0) - 1;
+				fNumValues = fValues->getDimension(0);
+			}
+
+			/// number of rows
+			inline size_t size() const { return fNumRows; }
+			/// number of values of all rows
+			inline size_t getNumValues() const { return fNumValues; }
+
+			/// reads a single row into dst
+			void readRow(size_t row, Row& dst) const {
+				if (row >= fNumRows) {
+					throw Exception("RaggedArrayView::readRow(): Row out of range");
+				}
+				std::vector<uint64_t> offsets;
+				readOffsets(row, 1, offsets);
+				HandlePin pin = fValues->pinHandle();
+				readHyperslab(pin.get(), std::vector<hsize_t>(1, offsets[0]), std::vector<hsize_t>(1, offsets[1] - offsets[0]), dst);
+			}
+
+			/// reads the rows [first, first+count) into dst, dst is resized to count
+			void readRows(size_t first, size_t count, std::vector<Row>& dst) const {
+				if (first + count > fNumRows) {
+					throw Exception("RaggedArrayView::readRows(): Rows out of range");
+				}
+				std::vector<uint64_t> offsets;
+				readOffsets(first, count, offsets);
+
+				// all rows in one transfer, then split
+				Row values;
+				{
+					HandlePin pin = fValues->pinHandle();
+					readHyperslab(pin.get(), std::vector<hsize_t>(1, offsets[0]), std::vector<hsize_t>(1, offsets[count] - offsets[0]), values);
+				}
+				dst.resize(count);
+				for (size_t i = 0; i < count; ++i) {
+					dst[i].assign(values.begin() + (offsets[i] - offsets[0]), values.begin() + (offsets[i + 1] - offsets[0]));
+				}
+			}
+
+			/// reads all rows into dst
+			inline void readAll(std::vector<Row>& dst) const { readRows(0, fNumRows, dst); }
+
+		private:
+			/// reads the count+1 offsets bounding the rows [first, first+count) and validates them
+			void readOffsets(size_t first, size_t count, std::vector<uint64_t>& offsets) const {
+				{
+					HandlePin pin = fOffsets->pinHandle();
+					readHyperslab(pin.get(), std::vector<hsize_t>(1, first), std::vector<hsize_t>(1, count + 1), offsets);
+				}
+				for (size_t i = 0; i < count; ++i) {
+					if (offsets[i + 1] < offsets[i]) {
+						throw Exception("RaggedArrayView: Offsets are not increasing");
+					}
+				}
+				if (offsets[count] > fNumValues) {
+					throw Exception("RaggedArrayView: Offsets exceed the number of values");
+				}
+			}
+
+			Dataset::Ptr fValues;
+			Dataset::Ptr fOffsets;
+			size_t fNumRows;
+			size_t fNumValues;
+	};
+
+} /* namespace hdf5 */
+#endif /* HDF5_RAGGEDARRAY_H_ */
@@ -0,0 +1,178 @@
+/*
+ * RowRange.h
+ *
+ * Block-wise streaming of datasets along their first dimension
+ */
+
+#ifndef HDF5_ROWRANGE_H_
+#define HDF5_ROWRANGE_H_
+
+#include "Exception.h"
+#include "Hyperslab.h"
+#include <hdf5.h>
+#include <vector>
+#include <iterator>
+#include <future>
+#include <boost/shared_ptr.hpp>
+
+namespace hdf5
+{
+	/**
+	 * A block of consecutive rows of a dataset. A row is everything sharing
+	 * the same index in the first dimension, data holds nRows * rowLength
+	 * elements in C order.
+	 */
+	template<typename T> struct RowBlock {
+			hsize_t firstRow;
+			hsize_t nRows;
+			size_t rowLength;
+			std::vector<T> data;
+
+			RowBlock(): firstRow(0), nRows(0), rowLength(0) {}
+	};
+
+	/**
+	 * Input range reading a dataset block by block via hyperslabs.
+	 *
+	 * While the caller works on block N the next block is read by a
+	 * background thread, so at most two blocks are held in memory. If the
+	 * HDF5 library has not been built thread-safe, the blocks are read
+	 * synchronously instead.
+	 *
+	 * Usage:
+	 *   RowRange<double> rows = dataset.rows<double>(4096);
+	 *   for (RowRange<double>::iterator it = rows.begin(); it != rows.end(); ++it) { ... }
+	 */
+	template<typename T> class RowRange
+	{
+		public:
+			typedef RowBlock<T> Block;
+
+		private:
+			struct State {
+					hid_t dataSet;
+					std::vector<hsize_t> dims;
+					hsize_t blockSize;
+					hsize_t nextRow;
+					bool started;
+					bool prefetch;
+					Block current;
+					std::future<Block> pending;
+
+					State(hid_t ds, hsize_t blockSize): dataSet(ds), blockSize(blockSize), nextRow(0), started(false), prefetch(false) {
+						H5Iinc_ref(dataSet);
+
+						hid_t space = H5Dget_space(dataSet);
+						int rank = H5Sget_simple_extent_ndims(space);
+						if (rank < 1) {
+							H5Sclose(space);
+							H5Idec_ref(dataSet);
+							throw Exception("RowRange: Only datasets of rank >= 1 can be read row by row");
+						}
+						dims.resize(rank);
+						H5Sget_simple_extent_dims(space, &dims[0], 0);
+						H5Sclose(space);
+
+						hbool_t threadSafe = 0;
+						prefetch = H5is_library_threadsafe(&threadSafe) > -1 && threadSafe;
+					}
+					~State() {
+						// wait for a running prefetch before releasing the dataset
+						if (pending.valid()) {
+							pending.wait();
+						}
+						H5Idec_ref(dataSet);
+					}
+
+					static Block fetch(hid_t ds, std::vector<hsize_t> dims, hsize_t firstRow, hsize_t blockSize, std::vector<T> buffer) {
+						Block block;
+						block.firstRow = firstRow;
+						block.nRows = std::min(blockSize, dims[0] - firstRow);
+						block.rowLength = 1;
+						for (size_t i = 1; i < dims.size(); ++i) {
+							block.rowLength *= dims[i];
+						}
+						block.data.swap(buffer);
+
+						std::vector<hsize_t> start(dims.size(), 0);
+						std::vector<hsize_t> count(dims);
+						start[0] = firstRow;
+						count[0] = block.nRows;
+						readHyperslab(ds, start, count, block.data);
+						return block;
+					}
+
+					/// makes the next block the current one and schedules the one after
+					void advance() {
+						std::vector<T> buffer;
+						buffer.swap(current.data);
+
+						if (pending.valid()) {
+							current = pending.get();
+						}
+						else if (nextRow < dims[0]) {
+							current = fetch(dataSet, dims, nextRow, blockSize, std::move(buffer));
+							buffer = std::vector<T>();
+							nextRow += current.nRows;
+						}
+						else {
+							current = Block();
+							current.firstRow = dims[0];
+						}
+
+						if (prefetch && nextRow < dims[0]) {
+							pending = std::async(std::launch::async, &State::fetch, dataSet, dims, nextRow, blockSize, std::move(buffer));
+							nextRow = std::min(nextRow + blockSize, dims[0]);
+						}
+					}
+			};
+
+		public:
+			class iterator: public std::iterator<std::input_iterator_tag, Block>
+			{
+				public:
+					iterator(): fState(0) {}
+					explicit iterator(State* state): fState(state) {}
+
+					const Block& operator*() const { return fState->current; }
+					const Block* operator->() const { return &fState->current; }
+					iterator& operator++() { fState->advance(); return *this; }
+
+					bool operator==(const iterator& other) const { return atEnd() == other.atEnd(); }
+					bool operator!=(const iterator& other) const { return !operator==(other); }
+
+				private:
+					bool atEnd() const { return fState == 0 || fState->current.nRows == 0; }
+
+					State* fState;
+			};
+
+			/**
+			 * @param dataSet HDF5 identifier of the dataset, the range keeps its own reference
+			 * @param blockSize Number of rows per block
+			 */
+			RowRange(hid_t dataSet, hsize_t blockSize): fState(new State(dataSet, blockSize)) {
+				if (blockSize == 0) {
+					throw Exception("RowRange: Block size must be larger than zero");
+				}
+			}
+
+			/// total number of rows of the dataset
+			inline hsize_t getNumRows() const { return fState->dims[0]; }
+
+			/// starts reading; a range can be iterated only once
+			iterator begin() {
+				if (!fState->started) {
+					fState->started = true;
+					fState->advance();
+				}
+				return iterator(fState.get());
+			}
+			iterator end() { return iterator(); }
+
+		private:
+			boost::shared_ptr<State> fState;
+	};
+
+} /* namespace hdf5 */
+#endif /* HDF5_ROWRANGE_H_ */
@@ -0,0 +1,155 @@
+/*
+ * ScratchAllocator.cpp
+ *
+ * Reusable temporary buffers for the conversion between containers and HDF5
+ */
+
+#include "ScratchAllocator.h"
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace hdf5
+{
+
+	namespace
+	{
+		void* allocateAligned(size_t bytes)
+		{
+			void* block = 0;
+			if (posix_memalign(&block, ScratchAllocator::Alignment, bytes > 0 ? bytes : 1) != 0) {
+				throw std::bad_alloc();
+			}
+			return block;
+		}
+
+		ScratchAllocator::Ptr& defaultScratchAllocator()
+		{
+			static ScratchAllocator::Ptr allocator(new PoolAllocator());
+			return allocator;
+		}
+	}
+
+	void* SystemAllocator::allocate(size_t bytes)
+	{
+		return allocateAligned(bytes);
+	}
+
+	void SystemAllocator::deallocate(void* block, size_t bytes)
+	{
+		free(block);
+	}
+
+	PoolAllocator::PoolAllocator(size_t maxCachedBytes): fMaxCachedBytes(maxCachedBytes), fCachedBytes(0), fNumSystemAllocations(0)
+	{
+		for (size_t i = 0; i < NumClasses; ++i) {
+			fFree[i] = 0;
+		}
+	}
+
+	PoolAllocator::~PoolAllocator()
+	{
+		release();
+	}
+
+	size_t PoolAllocator::getClass(size_t bytes)
+	{
+		if (bytes <= (size_t(1) << MinClass)) {
+			return 0;
+		}
+		return 64 - __builtin_clzll(bytes - 1) - MinClass;
+	}
+
+	void* PoolAllocator::allocate(size_t bytes)
+	{
+		size_t sizeClass = getClass(bytes);
+		if (!isCacheable(sizeClass)) {
+			{
+				std::lock_guard<std::mutex> lock(fMutex);
+				++fNumSystemAllocations;
+			}
+			return allocateAligned(bytes);
+		}
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			FreeBlock* block = fFree[sizeClass];
+			if (block) {
+				fFree[sizeClass] = block->next;
+				fCachedBytes -= size_t(1) << (sizeClass + MinClass);
+				return block;
+			}
+			++fNumSystemAllocations;
+		}
+		return allocateAligned(size_t(1) << (sizeClass + MinClass));
+	}
+
+	void PoolAllocator::deallocate(void* block, size_t bytes)
+	{
+		if (block == 0) {
+			return;
+		}
+		size_t sizeClass = getClass(bytes);
+		if (!isCacheable(sizeClass)) {
+			free(block);
+			return;
+		}
+		size_t classBytes = size_t(1) << (sizeClass + MinClass);
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			if (fCachedBytes + classBytes <= fMaxCachedBytes) {
+				FreeBlock* freeBlock = static_cast<FreeBlock*>(block);
+				freeBlock->next = fFree[sizeClass];
+				fFree[sizeClass] = freeBlock;
+				fCachedBytes += classBytes;
+				return;
+			}
+		}
+		free(block);
+	}
+
+	void PoolAllocator::release()
+	{
+		std::lock_guard<std::mutex> lock(fMutex);
+		for (size_t i = 0; i < NumClasses; ++i) {
+			while (fFree[i]) {
+				FreeBlock* block = fFree[i];
+				fFree[i] = block->next;
+				free(block);
+			}
+		}
+		fCachedBytes = 0;
+	}
+
+	size_t PoolAllocator::getNumSystemAllocations() const
+	{
+		std::lock_guard<std::mutex> lock(fMutex);
+		return fNumSystemAllocations;
+	}
+
+	size_t PoolAllocator::getCachedBytes() const
+	{
+		std::lock_guard<std::mutex> lock(fMutex);
+		return fCachedBytes;
+	}
+
+	ScratchAllocator::Ptr getDefaultScratchAllocator()
+	{
+		return defaultScratchAllocator();
+	}
+
+	void setDefaultScratchAllocator(const ScratchAllocator::Ptr& allocator)
+	{
+		defaultScratchAllocator() = allocator ? allocator : ScratchAllocator::Ptr(new PoolAllocator());
+	}
+
+	ScratchAllocator* ScratchContext::getAllocator()
+	{
+		ScratchContext* context = current();
+		if (context && context->fAllocator) {
+			return context->fAllocator;
+		}
+		return defaultScratchAllocator().get();
+	}
+
+} /* namespace hdf5 */
@@ -0,0 +1,151 @@
+/*
+ * ScratchAllocator.h
+ *
+ * Reusable temporary buffers for the conversion between containers and HDF5
+ */
+
+#ifndef HDF5_SCRATCHALLOCATOR_H_
+#define HDF5_SCRATCHALLOCATOR_H_
+
+#include <cstddef>
+#include <mutex>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace hdf5
+{
+	/**
+	 * Provides the temporary buffers the container interfaces convert
+	 * elements in. Implementations have to be thread-safe, a dataset may be
+	 * read by several threads at once.
+	 */
+	class ScratchAllocator: private boost::noncopyable
+	{
+		public:
+			typedef boost::shared_ptr<ScratchAllocator> Ptr;
+
+			/// alignment of all returned blocks
+			static const size_t Alignment = 64;
+
+			virtual ~ScratchAllocator() {}
+
+			/// returns a block of at least bytes, aligned to Alignment
+			virtual void* allocate(size_t bytes) = 0;
+			/// returns a block obtained from allocate(bytes)
+			virtual void deallocate(void* block, size_t bytes) = 0;
+	};
+
+	/**
+	 * Allocates every block from the system and releases it immediately.
+	 */
+	class SystemAllocator: public ScratchAllocator
+	{
+		public:
+			virtual void* allocate(size_t bytes);
+			virtual void deallocate(void* block, size_t bytes);
+	};
+
+	/**
+	 * Keeps released blocks in power-of-two size classes and hands them out
+	 * again, so repeated transfers of the same size do not touch the system
+	 * allocator after the first one. At most maxCachedBytes are kept, larger
+	 * surpluses are returned to the system. Blocks whose size class exceeds
+	 * maxCachedBytes could never be cached, they are allocated at their
+	 * exact size and released immediately.
+	 */
+	class PoolAllocator: public ScratchAllocator
+	{
+		public:
+			static const size_t DefaultMaxCachedBytes = 16 << 20;
+
+			explicit PoolAllocator(size_t maxCachedBytes = DefaultMaxCachedBytes);
+			virtual ~PoolAllocator();
+
+			virtual void* allocate(size_t bytes);
+			virtual void deallocate(void* block, size_t bytes);
+
+			/// returns all cached blocks to the system
+			void release();
+
+			/// number of blocks that have been requested from the system
+			size_t getNumSystemAllocations() const;
+			size_t getCachedBytes() const;
+			inline size_t getMaxCachedBytes() const { return fMaxCachedBytes; }
+
+		private:
+			/// smallest size class is 2^MinClass bytes
+			static const size_t MinClass = 6;
+			static const size_t NumClasses = 64 - MinClass;
+
+			/// released blocks are linked through their first bytes
+			struct FreeBlock {
+					FreeBlock* next;
+			};
+
+			static size_t getClass(size_t bytes);
+			/// false for blocks which are too large to be ever cached
+			inline bool isCacheable(size_t sizeClass) const { return (size_t(1) << (sizeClass + MinClass)) <= fMaxCachedBytes; }
+
+			mutable std::mutex fMutex;
+			size_t fMaxCachedBytes;
+			size_t fCachedBytes;
+			size_t fNumSystemAllocations;
+			FreeBlock* fFree[NumClasses];
+	};
+
+	/**
+	 * Allocator used for all temporary buffers outside of a dataset context,
+	 * a PoolAllocator unless replaced. Only replace it while no transfer is
+	 * running, 0 restores a new PoolAllocator.
+	 */
+	ScratchAllocator::Ptr getDefaultScratchAllocator();
+	void setDefaultScratchAllocator(const ScratchAllocator::Ptr& allocator);
+
+	/**
+	 * Allocator that the temporary buffers of the current thread are taken
+	 * from. Dataset installs its own allocator for the duration of each read
+	 * and write.
+	 */
+	class ScratchContext: private boost::noncopyable
+	{
+		public:
+			explicit ScratchContext(ScratchAllocator* allocator): fAllocator(allocator), fPrevious(current()) {
+				current() = this;
+			}
+			~ScratchContext() { current() = fPrevious; }
+
+			/// allocator of the innermost context, the default one without context
+			static ScratchAllocator* getAllocator();
+
+		private:
+			static inline ScratchContext*& current() {
+				static thread_local ScratchContext* context = 0;
+				return context;
+			}
+
+			ScratchAllocator* fAllocator;
+			ScratchContext* fPrevious;
+	};
+
+	/**
+	 * Uninitialised temporary array of nElements T, taken from the allocator
+	 * of the current ScratchContext and given back on destruction.
+	 */
+	template<typename T> class ScratchBuffer: private boost::noncopyable
+	{
+		public:
+			explicit ScratchBuffer(size_t nElements): fAllocator(ScratchContext::getAllocator()), fBytes(nElements * sizeof(T)),
+					fData(static_cast<T*>(fAllocator->allocate(fBytes))) {}
+			~ScratchBuffer() { fAllocator->deallocate(fData, fBytes); }
+
+			inline T* get() const { return fData; }
+			inline T& operator[](size_t i) const { return fData[i]; }
+
+		private:
+			ScratchAllocator* fAllocator;
+			size_t fBytes;
+			T* fData;
+	};
+
+} /* namespace hdf5 */
+#endif /* HDF5_SCRATCHALLOCATOR_H_ */
@@ -0,0 +1,245 @@
+/*
+ * SortedMapView.h
+ *
+ * Point and range lookups in map datasets without reading them completely
+ */
+
+#ifndef HDF5_SORTEDMAPVIEW_H_
+#define HDF5_SORTEDMAPVIEW_H_
+
+#include "Exception.h"
+#include "ContainerInterface.h"
+#include "Dataset.h"
+#include "ScratchAllocator.h"
+#include <hdf5.h>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace hdf5
+{
+	/// name suffix of the dataset holding the sampled keys of a map dataset
+	const char* const KeyIndexSuffix = ".keyindex";
+	/// default number of entries per sampled key
+	const hsize_t DefaultKeySampleInterval = 4096;
+
+	/**
+	 * Reads count keys starting at entry start, taking every stride-th one,
+	 * from a dataset written from a std::map<Key, Value>. Only the key member
+	 * of the entries is transferred.
+	 */
+	template<typename Key, typename Value> void readMapKeys(hid_t dataSet, hsize_t start, hsize_t count, hsize_t stride, std::vector<Key>& keys) {
+		typedef typename ContainerInterface< std::map<Key, Value> >::KeyPOD KeyPOD;
+
+		keys.resize(count);
+		if (count == 0) {
+			return;
+		}
+
+		hid_t fileSpace = H5Dget_space(dataSet);
+		if (H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, &start, &stride, &count, 0) < 0) {
+			H5Sclose(fileSpace);
+			throw Exception("hdf5::readMapKeys(): Could not select entries");
+		}
+		hid_t memSpace = H5Screate_simple(1, &count, 0);
+		// compound with only the key member, the values are not read at all
+		hid_t memType = H5Tcreate(H5T_COMPOUND, sizeof(KeyPOD));
+		hid_t keyType = DataType<KeyPOD>::hdfType();
+		H5Tinsert(memType, "Key", 0, keyType);
+		// predefined types cannot be closed, compound ones have been created for us
+		H5E_BEGIN_TRY {
+			H5Tclose(keyType);
+		} H5E_END_TRY;
+
+		ScratchBuffer<KeyPOD> buffer(count);
+		herr_t status;
+		{
+			IoTimer timer(IoRead, count * sizeof(KeyPOD));
+			status = H5Dread(dataSet, memType, memSpace, fileSpace, H5P_DEFAULT, buffer.get());
+		}
+		H5Tclose(memType);
+		H5Sclose(memSpace);
+		H5Sclose(fileSpace);
+		if (status < 0) {
+			throw Exception("hdf5::readMapKeys(): Error while reading keys from file");
+		}
+
+		for (hsize_t i = 0; i < count; ++i) {
+			DataType<Key>::assignFromPOD(buffer[i], keys[i]);
+			DataType<Key>::freePOD(buffer[i]);
+		}
+	}
+
+	/**
+	 * Gives access to single keys and key ranges of a dataset written from a
+	 * std::map<Key, Value, Compare>, whose entries are stored in key order.
+	 *
+	 * With a key index (see Group::createSortedMap() and
+	 * Group::createKeyIndex()) the index is loaded once and every search
+	 * reads a single block of sampleInterval keys. Each block is checked
+	 * against the index; if the map has been rewritten since the index was
+	 * created, the search falls back to a binary search reading one key per
+	 * step.
+	 *
+	 * Usage:
+	 *   SortedMapView<int64_t, double> view = group.openSortedMap<int64_t, double>("calibration");
+	 *   double value;
+	 *   if (view.lookup(42, value)) { ... }
+	 */
+	template<typename Key, typename Value, typename Compare = std::less<Key> > class SortedMapView
+	{
+		public:
+			typedef std::pair<Key, Value> Entry;
+			typedef std::map<Key, Value, Compare> Container;
+
+			/**
+			 * @param data Dataset holding the map
+			 * @param index Dataset holding the sampled keys, may be empty
+			 */
+			SortedMapView(const Dataset::Ptr& data, const Dataset::Ptr& index = Dataset::Ptr()): fData(data), fSize(0), fSampleInterval(0) {
+				if (!fData) {
+					throw Exception("SortedMapView: No dataset given");
+				}
+				HandlePin pin = fData->pinHandle();
+				hid_t space = H5Dget_space(pin.get());
+				try {
+					ContainerInterface<Container>::checkType(pin.get(), space);
+				}
+				catch (...) {
+					H5Sclose(space);
+					throw;
+				}
+				H5Sclose(space);
+				fSize = fData->getDimension(0);
+
+				// an index of another size belongs to an older version of the map
+				if (index && index->hasAttribute("SampleInterval") && index->hasAttribute("Entries")
+						&& index->getAttribute<uint64_t>("Entries") == fSize) {
+					fSampleInterval = index->getAttribute<uint64_t>("SampleInterval");
+					index->read(fIndex);
+				}
+			}
+
+			/// number of entries of the map
+			inline hsize_t size() const { return fSize; }
+			inline bool hasIndex() const { return fSampleInterval > 0 && !fIndex.empty(); }
+
+			/// position of the first entry whose key is not less than key
+			hsize_t lowerBound(const Key& key) const {
+				HandlePin pin = fData->pinHandle();
+				if (hasIndex()) {
+					// the block starting at the last sample not greater than key
+					size_t nSamples = std::upper_bound(fIndex.begin(), fIndex.end(), key, fCompare) - fIndex.begin();
+					size_t block = nSamples > 0 ? nSamples - 1 : 0;
+					hsize_t start = block * fSampleInterval;
+					hsize_t blockSize = std::min<hsize_t>(fSampleInterval, fSize - start);
+					// one key more to compare the start of the next block with the index
+					hsize_t count = std::min<hsize_t>(blockSize + 1, fSize - start);
+
+					std::vector<Key> keys;
+					readMapKeys<Key, Value>(pin.get(), start, count, 1, keys);
+					bool valid = isEqual(keys[0], fIndex[block]);
+					if (block + 1 < fIndex.size()) {
+						valid &= count > blockSize && isEqual(keys[blockSize], fIndex[block + 1]);
+					}
+					if (valid) {
+						return start + (std::lower_bound(keys.begin(), keys.begin() + blockSize, key, fCompare) - keys.begin());
+					}
+				}
+
+				// binary search on the dataset itself
+				hsize_t lo = 0, hi = fSize;
+				std::vector<Key> probe;
+				while (lo < hi) {
+					hsize_t mid = lo + (hi - lo) / 2;
+					readMapKeys<Key, Value>(pin.get(), mid, 1, 1, probe);
+					if (fCompare(probe[0], key)) {
+						lo = mid + 1;
+					}
+					else {
+						hi = mid;
+					}
+				}
+				return lo;
+			}
+
+			/**
+			 * Looks up a single key.
+			 * @return true if the key has been found, value is set then
+			 */
+			bool lookup(const Key& key, Value& value) const {
+				hsize_t pos = lowerBound(key);
+				if (pos >= fSize) {
+					return false;
+				}
+				std::vector<Entry> entries;
+				readEntries(pos, 1, entries);
+				if (!isEqual(entries[0].first, key)) {
+					return false;
+				}
+				value = entries[0].second;
+				return true;
+			}
+
+			/// reads all entries with lo <= key < hi in key order
+			void range(const Key& lo, const Key& hi, std::vector<Entry>& dst) const {
+				hsize_t first = lowerBound(lo);
+				hsize_t last = fCompare(lo, hi) ? lowerBound(hi) : first;
+				readEntries(first, last - first, dst);
+			}
+
+			/// reads count entries starting at position start
+			void readEntries(hsize_t start, hsize_t count, std::vector<Entry>& dst) const {
+				typedef typename ContainerInterface<Container>::ElementPOD ElementPOD;
+
+				dst.resize(count);
+				if (count == 0) {
+					return;
+				}
+				if (start + count > fSize) {
+					throw Exception("SortedMapView::readEntries(): Entries out of range");
+				}
+
+				HandlePin pin = fData->pinHandle();
+				hid_t fileSpace = H5Dget_space(pin.get());
+				H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, &start, 0, &count, 0);
+				hid_t memSpace = H5Screate_simple(1, &count, 0);
+				hid_t memType = DataType<ElementPOD>::hdfType();
+
+				ScratchBuffer<ElementPOD> buffer(count);
+				herr_t status;
+				{
+					IoTimer timer(IoRead, count * sizeof(ElementPOD));
+					status = H5Dread(pin.get(), memType, memSpace, fileSpace, H5P_DEFAULT, buffer.get());
+				}
+				H5Tclose(memType);
+				H5Sclose(memSpace);
+				H5Sclose(fileSpace);
+				if (status < 0) {
+					throw Exception("SortedMapView::readEntries(): Error while reading entries from file");
+				}
+
+				for (hsize_t i = 0; i < count; ++i) {
+					DataType<Key>::assignFromPOD(buffer[i].k, dst[i].first);
+					DataType<Value>::assignFromPOD(buffer[i].v, dst[i].second);
+					DataType<Key>::freePOD(buffer[i].k);
+					DataType<Value>::freePOD(buffer[i].v);
+				}
+			}
+
+		private:
+			inline bool isEqual(const Key& a, const Key& b) const { return !fCompare(a, b) && !fCompare(b, a); }
+
+			Dataset::Ptr fData;
+			hsize_t fSize;
+			hsize_t fSampleInterval;
+			/// every fSampleInterval-th key, starting with the first one
+			std::vector<Key> fIndex;
+			Compare fCompare;
+	};
+
+} /* namespace hdf5 */
+#endif /* HDF5_SORTEDMAPVIEW_H_ */
@@ -0,0 +1,212 @@
+/*
+ * SparseMatrix.h
+ *
+ * Sparse matrices in compressed sparse row (CSR) format
+ */
+
+#ifndef HDF5_SPARSEMATRIX_H_
+#define HDF5_SPARSEMATRIX_H_
+
+#include "Exception.h"
+#include "Dataset.h"
+#include "Hyperslab.h"
+#include <hdf5.h>
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace hdf5
+{
+	/// names of the datasets and attributes of a sparse matrix group, as used by scipy/anndata
+	const char* const SparseDataName = "data";
+	const char* const SparseIndicesName = "indices";
+	const char* const SparseIndptrName = "indptr";
+	const char* const SparseShapeAttribute = "shape";
+	const char* const SparseEncodingAttribute = "encoding-type";
+
+	/// assigns value to shape if it holds two non-negative integers of type T
+	template<typename T> bool assignSparseShape(const AttributeValue& value, std::vector<uint64_t>& shape) {
+		if (!value.is< std::vector<T> >()) {
+			return false;
+		}
+		const std::vector<T>& dims = value.get< std::vector<T> >();
+		if (dims.size() != 2 || dims[0] < T() || dims[1] < T()) {
+			return false;
+		}
+		shape.assign(dims.begin(), dims.end());
+		return true;
+	}
+
+	/**
+	 * Converts the shape attribute of a sparse matrix into shape. scipy and
+	 * anndata store it as signed integers, createSparseMatrix() as unsigned
+	 * ones, both of 32 or 64 bits are accepted.
+	 * @return false if the attribute is no valid shape
+	 */
+	inline bool convertSparseShape(const AttributeValue& value, std::vector<uint64_t>& shape) {
+		return assignSparseShape<int64_t>(value, shape) || assignSparseShape<uint64_t>(value, shape) ||
+				assignSparseShape<int32_t>(value, shape) || assignSparseShape<uint32_t>(value, shape);
+	}
+
+	/**
+	 * Matrix in compressed sparse row format: the non-zero values of row i
+	 * are data[indptr[i]..indptr[i+1]) in the columns given by indices at
+	 * the same positions. Columns within a row are sorted.
+	 */
+	template<typename T> struct SparseMatrix {
+			size_t rows;
+			size_t cols;
+			std::vector<T> data;
+			/// column of each value in data
+			std::vector<uint64_t> indices;
+			/// rows+1 offsets into data and indices
+			std::vector<uint64_t> indptr;
+
+			SparseMatrix(): rows(0), cols(0), indptr(1, 0) {}
+			SparseMatrix(size_t rows, size_t cols): rows(rows), cols(cols), indptr(rows + 1, 0) {}
+
+			inline size_t getNumNonZeros() const { return data.size(); }
+
+			/// value at (row, col), zero if not stored
+			T get(size_t row, size_t col) const {
+				if (row >= rows || col >= cols) {
+					throw Exception("SparseMatrix::get(): Index out of range");
+				}
+				std::vector<uint64_t>::const_iterator begin = indices.begin() + indptr[row];
+				std::vector<uint64_t>::const_iterator end = indices.begin() + indptr[row + 1];
+				std::vector<uint64_t>::const_iterator it = std::lower_bound(begin, end, col);
+				return (it != end && *it == col) ? data[it - indices.begin()] : T();
+			}
+
+			/**
+			 * Builds the matrix from coordinate (COO) format, i.e. one
+			 * (row, column, value) triplet per non-zero. Triplets may come in
+			 * any order, duplicates are summed up.
+			 */
+			static SparseMatrix fromCoordinates(size_t rows, size_t cols, const std::vector<uint64_t>& rowIndices,
+					const std::vector<uint64_t>& colIndices, const std::vector<T>& values) {
+				if (rowIndices.size() != values.size() || colIndices.size() != values.size()) {
+					throw Exception("SparseMatrix::fromCoordinates(): Number of row indices, column indices and values does not match");
+				}
+				SparseMatrix result(rows, cols);
+
+				// counting sort by row
+				for (size_t i = 0; i < values.size(); ++i) {
+					if (rowIndices[i] >= rows || colIndices[i] >= cols) {
+						throw Exception("SparseMatrix::fromCoordinates(): Index out of range");
+					}
+					++result.indptr[rowIndices[i] + 1];
+				}
+				for (size_t r = 0; r < rows; ++r) {
+					result.indptr[r + 1] += result.indptr[r];
+				}
+				std::vector<uint64_t> position(result.indptr.begin(), result.indptr.end() - 1);
+				std::vector<std::pair<uint64_t, T> > entries(values.size());
+				for (size_t i = 0; i < values.size(); ++i) {
+					entries[position[rowIndices[i]]++] = std::make_pair(colIndices[i], values[i]);
+				}
+
+				// sort the columns of each row and merge duplicates
+				result.indices.reserve(entries.size());
+				result.data.reserve(entries.size());
+				uint64_t begin = 0;
+				for (size_t r = 0; r < rows; ++r) {
+					uint64_t end = result.indptr[r + 1];
+					std::sort(entries.begin() + begin, entries.begin() + end);
+					result.indptr[r] = result.data.size();
+					for (uint64_t i = begin; i < end; ++i) {
+						if (i > begin && entries[i].first == result.indices.back()) {
+							result.data.back() += entries[i].second;
+						}
+						else {
+							result.indices.push_back(entries[i].first);
+							result.data.push_back(entries[i].second);
+						}
+					}
+					begin = end;
+				}
+				result.indptr[rows] = result.data.size();
+				return result;
+			}
+	};
+
+	/**
+	 * Gives access to a sparse matrix written by Group::createSparseMatrix().
+	 * Row ranges are read through hyperslabs selected by the row offsets,
+	 * nothing outside of the requested rows is transferred.
+	 *
+	 * Usage:
+	 *   SparseMatrixView<float> response = group.openSparseMatrix<float>("response");
+	 *   SparseMatrix<float> block;
+	 *   response.readRows(1000, 100, block);
+	 */
+	template<typename T> class SparseMatrixView
+	{
+		public:
+			SparseMatrixView(const Dataset::Ptr& data, const Dataset::Ptr& indices, const Dataset::Ptr& indptr, size_t rows, size_t cols):
+					fData(data), fIndices(indices), fIndptr(indptr), fRows(rows), fCols(cols) {
+				if (!fData || !fIndices || !fIndptr) {
+					throw Exception("SparseMatrixView: No dataset given");
+				}
+				if (fData->getRank() != 1 || fIndices->getRank() != 1 || fIndptr->getRank() != 1) {
+					throw Exception("SparseMatrixView: Data, indices and indptr have to be of rank 1");
+				}
+				if (fIndptr->getDimension(0) != rows + 1 || fData->getDimension(0) != fIndices->getDimension(0)) {
+					throw Exception("SparseMatrixView: Sizes of data, indices and indptr do not fit the shape");
+				}
+			}
+
+			inline size_t getNumRows() const { return fRows; }
+			inline size_t getNumCols() const { return fCols; }
+			inline size_t getNumNonZeros() const { return fData->getDimension(0); }
+
+			/// reads the rows [first, first+count) into dst, a matrix of count rows
+			void readRows(size_t first, size_t count, SparseMatrix<T>& dst) const {
+				if (first + count > fRows) {
+					throw Exception("SparseMatrixView::readRows(): Rows out of range");
+				}
+				{
+					HandlePin pin = fIndptr->pinHandle();
+					readHyperslab(pin.get(), std::vector<hsize_t>(1, first), std::vector<hsize_t>(1, count + 1), dst.indptr);
+				}
+				uint64_t begin = dst.indptr[0];
+				uint64_t end = dst.indptr[count];
+				for (size_t i = 0; i < count; ++i) {
+					if (dst.indptr[i + 1] < dst.indptr[i]) {
+						throw Exception("SparseMatrixView::readRows(): Row offsets are not increasing");
+					}
+				}
+				if (end > getNumNonZeros()) {
+					throw Exception("SparseMatrixView::readRows(): Row offsets exceed the number of values");
+				}
+
+				std::vector<hsize_t> start(1, begin), nValues(1, end - begin);
+				{
+					HandlePin pin = fData->pinHandle();
+					readHyperslab(pin.get(), start, nValues, dst.data);
+				}
+				{
+					HandlePin pin = fIndices->pinHandle();
+					readHyperslab(pin.get(), start, nValues, dst.indices);
+				}
+				for (size_t i = 0; i <= count; ++i) {
+					dst.indptr[i] -= begin;
+				}
+				dst.rows = count;
+				dst.cols = fCols;
+			}
+
+			/// reads the whole matrix into dst
+			inline void readAll(SparseMatrix<T>& dst) const { readRows(0, fRows, dst); }
+
+		private:
+			Dataset::Ptr fData;
+			Dataset::Ptr fIndices;
+			Dataset::Ptr fIndptr;
+			size_t fRows;
+			size_t fCols;
+	};
+
+} /* namespace hdf5 */
+#endif /* HDF5_SPARSEMATRIX_H_ */
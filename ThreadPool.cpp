@@ -0,0 +1,127 @@
+/*
+ * ThreadPool.cpp
+ *
+ * Work-stealing pool of worker threads
+ */
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace hdf5
+{
+
+	namespace
+	{
+		/// pool and queue index of the worker running on this thread
+		struct WorkerIdentity {
+				const ThreadPool* pool;
+				size_t index;
+		};
+
+		WorkerIdentity& currentWorker()
+		{
+			static thread_local WorkerIdentity worker = { 0, 0 };
+			return worker;
+		}
+	}
+
+	ThreadPool::ThreadPool(size_t nThreads): fNumQueued(0), fNextQueue(0), fStop(false)
+	{
+		if (nThreads == 0) {
+			nThreads = max(1u, thread::hardware_concurrency());
+		}
+		for (size_t i = 0; i < nThreads; ++i) {
+			fQueues.push_back(boost::shared_ptr<Queue>(new Queue()));
+		}
+		for (size_t i = 0; i < nThreads; ++i) {
+			fThreads.push_back(thread(&ThreadPool::run, this, i));
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			lock_guard<mutex> lock(fWakeMutex);
+			fStop = true;
+		}
+		fWake.notify_all();
+		for (size_t i = 0; i < fThreads.size(); ++i) {
+			fThreads[i].join();
+		}
+	}
+
+	int ThreadPool::getWorkerIndex() const
+	{
+		const WorkerIdentity& worker = currentWorker();
+		return worker.pool == this ? static_cast<int>(worker.index) : -1;
+	}
+
+	void ThreadPool::submit(const Task& task)
+	{
+		int worker = getWorkerIndex();
+		size_t index = worker >= 0 ? worker : fNextQueue.fetch_add(1, memory_order_relaxed) % fQueues.size();
+		{
+			// under the wake lock, so a worker cannot miss it between checking and waiting
+			lock_guard<mutex> wakeLock(fWakeMutex);
+			lock_guard<mutex> lock(fQueues[index]->mutex);
+			fQueues[index]->tasks.push_back(task);
+			++fNumQueued;
+		}
+		fWake.notify_one();
+	}
+
+	bool ThreadPool::takeTask(size_t index, Task& task)
+	{
+		// newest task of the own queue, it is most likely still in the cache
+		{
+			Queue& queue = *fQueues[index];
+			lock_guard<mutex> lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				task.swap(queue.tasks.back());
+				queue.tasks.pop_back();
+				--fNumQueued;
+				return true;
+			}
+		}
+		// oldest task of another queue
+		for (size_t i = 1; i < fQueues.size(); ++i) {
+			Queue& queue = *fQueues[(index + i) % fQueues.size()];
+			lock_guard<mutex> lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				task.swap(queue.tasks.front());
+				queue.tasks.pop_front();
+				--fNumQueued;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ThreadPool::run(size_t index)
+	{
+		WorkerIdentity& worker = currentWorker();
+		worker.pool = this;
+		worker.index = index;
+
+		for (;;) {
+			Task task;
+			if (takeTask(index, task)) {
+				task();
+				continue;
+			}
+			unique_lock<mutex> lock(fWakeMutex);
+			fWake.wait(lock, [this]() { return fStop || fNumQueued > 0; });
+			if (fStop && fNumQueued == 0) {
+				return;
+			}
+		}
+	}
+
+	ThreadPool& getDefaultThreadPool()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+
+} /* namespace hdf5 */
@@ -0,0 +1,72 @@
+/*
+ * ThreadPool.h
+ *
+ * Work-stealing pool of worker threads
+ */
+
+#ifndef HDF5_THREADPOOL_H_
+#define HDF5_THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace hdf5
+{
+	/**
+	 * Fixed number of worker threads, each with its own task queue. Tasks
+	 * submitted from outside are distributed round robin, tasks submitted
+	 * by a worker go to its own queue. A worker takes the newest task of
+	 * its own queue and steals the oldest one of another queue when its
+	 * own is empty.
+	 *
+	 * Tasks must not throw and must not wait for other tasks of the same
+	 * pool. The destructor runs all queued tasks before joining the threads.
+	 */
+	class ThreadPool: private boost::noncopyable
+	{
+		public:
+			typedef std::function<void()> Task;
+
+			/// @param nThreads Number of workers, 0 for one per hardware thread
+			explicit ThreadPool(size_t nThreads = 0);
+			~ThreadPool();
+
+			void submit(const Task& task);
+
+			inline size_t getNumThreads() const { return fThreads.size(); }
+
+		private:
+			struct Queue {
+					std::mutex mutex;
+					std::deque<Task> tasks;
+			};
+
+			void run(size_t index);
+			/// takes a task from queue index or steals one from another queue
+			bool takeTask(size_t index, Task& task);
+
+			/// index of the worker of this pool running on the current thread, -1 if none
+			int getWorkerIndex() const;
+
+			std::vector< boost::shared_ptr<Queue> > fQueues;
+			std::vector<std::thread> fThreads;
+			std::mutex fWakeMutex;
+			std::condition_variable fWake;
+			/// number of tasks in all queues
+			std::atomic<size_t> fNumQueued;
+			std::atomic<size_t> fNextQueue;
+			bool fStop;
+	};
+
+	/// pool shared by all parallel operations that are not given one explicitly
+	ThreadPool& getDefaultThreadPool();
+
+} /* namespace hdf5 */
+#endif /* HDF5_THREADPOOL_H_ */
@@ -0,0 +1,88 @@
+/*
+ * Tracing.cpp
+ *
+ * Hooks reporting individual operations to an exchangeable sink
+ */
+
+#include "Tracing.h"
+#include "Exception.h"
+#include <cstdio>
+#include <iomanip>
+#include <unistd.h>
+
+using namespace std;
+
+namespace hdf5
+{
+
+	TraceSink* setTraceSink(TraceSink* sink)
+	{
+		return traceSinkInstance().exchange(sink, std::memory_order_acq_rel);
+	}
+
+	namespace
+	{
+		/// small number per thread, used as tid of the trace events
+		size_t getTraceThreadId()
+		{
+			static std::atomic<size_t> nextId(1);
+			static thread_local size_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+			return id;
+		}
+
+		void writeJsonString(std::ostream& os, const std::string& s)
+		{
+			os << '"';
+			for (size_t i = 0; i < s.size(); ++i) {
+				char c = s[i];
+				if (c == '"' || c == '\\') {
+					os << '\\' << c;
+				}
+				else if (static_cast<unsigned char>(c) < 0x20) {
+					char escaped[8];
+					snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+					os << escaped;
+				}
+				else {
+					os << c;
+				}
+			}
+			os << '"';
+		}
+	}
+
+	ChromeTraceSink::ChromeTraceSink(const std::string& fileName):
+			fStream(fileName.c_str()), fStart(std::chrono::steady_clock::now()), fFirst(true)
+	{
+		if (!fStream) {
+			throw Exception("ChromeTraceSink: Could not open trace file '" + fileName + "'");
+		}
+		fStream << std::fixed << std::setprecision(3);
+		fStream << "{\"traceEvents\":[" << endl;
+	}
+
+	ChromeTraceSink::~ChromeTraceSink()
+	{
+		std::lock_guard<std::mutex> lock(fMutex);
+		fStream << endl << "],\"displayTimeUnit\":\"ms\"}" << endl;
+	}
+
+	void ChromeTraceSink::record(const TraceEvent& event)
+	{
+		// timestamps in microseconds since the creation of the sink
+		double ts = std::chrono::duration<double, std::micro>(event.start - fStart).count();
+		double dur = event.nanoseconds * 1e-3;
+		size_t tid = getTraceThreadId();
+
+		std::lock_guard<std::mutex> lock(fMutex);
+		if (!fFirst) {
+			fStream << "," << endl;
+		}
+		fFirst = false;
+		fStream << "{\"name\":\"" << event.operation << "\",\"cat\":\"hdf5pp\",\"ph\":\"X\",\"ts\":" << ts << ",\"dur\":" << dur
+				<< ",\"pid\":" << getpid() << ",\"tid\":" << tid << ",\"args\":{\"path\":";
+		writeJsonString(fStream, event.path);
+		fStream << ",\"bytes\":" << event.bytes << "}}";
+	}
+
+} /* namespace hdf5 */
@@ -0,0 +1,124 @@
+/*
+ * Tracing.h
+ *
+ * Hooks reporting individual operations to an exchangeable sink
+ */
+
+#ifndef HDF5_TRACING_H_
+#define HDF5_TRACING_H_
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <stdint.h>
+#include <boost/noncopyable.hpp>
+
+namespace hdf5
+{
+	/// one traced operation
+	struct TraceEvent {
+			/// e.g. "read", "write", "open", "createDataset", "decodeAttribute", "scanGroup"
+			const char* operation;
+			/// object path within the file, attributes are given as path@name
+			std::string path;
+			uint64_t bytes;
+			std::chrono::steady_clock::time_point start;
+			uint64_t nanoseconds;
+	};
+
+	/**
+	 * Receives all traced operations. record() is called from every thread
+	 * doing I/O, implementations have to be thread-safe.
+	 */
+	class TraceSink
+	{
+		public:
+			virtual ~TraceSink() {}
+			virtual void record(const TraceEvent& event) = 0;
+	};
+
+	/**
+	 * Installs sink for all files, 0 disables tracing. The sink is not owned
+	 * and must stay alive until all operations started before it has been
+	 * replaced have finished.
+	 * @return previously installed sink
+	 */
+	TraceSink* setTraceSink(TraceSink* sink);
+
+	inline std::atomic<TraceSink*>& traceSinkInstance() {
+		static std::atomic<TraceSink*> sink(0);
+		return sink;
+	}
+	inline TraceSink* getTraceSink() { return traceSinkInstance().load(std::memory_order_acquire); }
+
+	/**
+	 * Times its own lifetime and reports it to the installed sink. Without a
+	 * sink the constructor costs one load and one branch. Use it through the
+	 * HDF5PP_TRACE_* macros, which compile to nothing if HDF5PP_DISABLE_TRACING
+	 * is defined.
+	 */
+	class TraceScope: private boost::noncopyable
+	{
+		public:
+			explicit TraceScope(const char* operation): fSink(getTraceSink()) {
+				if (fSink) {
+					fEvent.operation = operation;
+					fEvent.bytes = 0;
+					fEvent.start = std::chrono::steady_clock::now();
+				}
+			}
+			~TraceScope() {
+				if (fSink) {
+					std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - fEvent.start;
+					fEvent.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+					fSink->record(fEvent);
+				}
+			}
+
+			inline bool isActive() const { return fSink != 0; }
+			inline void setPath(const std::string& path) { fEvent.path = path; }
+			inline void setBytes(uint64_t bytes) { fEvent.bytes = bytes; }
+
+		private:
+			TraceSink* fSink;
+			TraceEvent fEvent;
+	};
+
+	/**
+	 * Writes all events as Chrome trace-event JSON ("complete" events), which
+	 * can be loaded into chrome://tracing or Perfetto. The file is completed
+	 * when the sink is destroyed.
+	 */
+	class ChromeTraceSink: public TraceSink, private boost::noncopyable
+	{
+		public:
+			explicit ChromeTraceSink(const std::string& fileName);
+			virtual ~ChromeTraceSink();
+
+			virtual void record(const TraceEvent& event);
+
+		private:
+			std::mutex fMutex;
+			std::ofstream fStream;
+			std::chrono::steady_clock::time_point fStart;
+			bool fFirst;
+	};
+
+} /* namespace hdf5 */
+
+#ifndef HDF5PP_DISABLE_TRACING
+/// traces the rest of the enclosing block as operation on path
+#define HDF5PP_TRACE_SCOPE(scope, operation, path) \
+	hdf5::TraceScope scope(operation); \
+	(scope.isActive() ? scope.setPath(path) : (void) 0)
+/// sets the byte count of a trace scope, bytes is only evaluated while tracing
+#define HDF5PP_TRACE_BYTES(scope, bytes) \
+	(scope.isActive() ? scope.setBytes(bytes) : (void) 0)
+#else
+#define HDF5PP_TRACE_SCOPE(scope, operation, path)
+#define HDF5PP_TRACE_BYTES(scope, bytes)
+#endif
+
+#endif /* HDF5_TRACING_H_ */
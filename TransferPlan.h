@@ -0,0 +1,137 @@
+/*
+ * TransferPlan.h
+ *
+ * Repeated transfers between a dataset and containers validated only once
+ */
+
+#ifndef HDF5_TRANSFERPLAN_H_
+#define HDF5_TRANSFERPLAN_H_
+
+#include "Exception.h"
+#include "ContainerInterface.h"
+#include "HandleManager.h"
+#include "IoStatistics.h"
+#include "ScratchAllocator.h"
+#include "Tracing.h"
+#include "ZoneMap.h"
+#include <hdf5.h>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace hdf5
+{
+	/**
+	 * Reads and writes containers of type T from and to one dataset. Element
+	 * type and rank are validated once when the plan is created, the memory
+	 * type and the extents of the dataset are cached. Each transfer then
+	 * only compares the number of elements of the container with the
+	 * dataset and calls H5Dread/H5Dwrite on the whole dataset.
+	 *
+	 * The plan keeps the dataset handle pinned and takes its conversion
+	 * buffers from the scratch allocator of the dataset. It must not outlive
+	 * the Dataset it has been prepared from, and the dataset must not be
+	 * resized while the plan is in use. Whether writes are counted for a
+	 * zone map is taken from the metadata snapshot, prepare the plan again
+	 * after Group::createZoneMap().
+	 *
+	 * Usage:
+	 *   TransferPlan< std::vector<double> > plan = dataset->prepare< std::vector<double> >();
+	 *   for (;;) { plan.write(frame); }
+	 */
+	template<typename T> class TransferPlan
+	{
+		private:
+			struct State: private boost::noncopyable {
+					HandlePin pin;
+					std::string path;
+					IoStatistics* fileStatistics;
+					IoStatistics* datasetStatistics;
+					ScratchAllocator* scratch;
+					bool tracksWriteGeneration;
+					hid_t memType;
+					std::vector<hsize_t> dims;
+					hsize_t nElements;
+					hsize_t nBytes;
+
+					State(const HandlePin& pin, const std::string& path, IoStatistics* fileStatistics, IoStatistics* datasetStatistics, ScratchAllocator* scratch,
+							bool tracksWriteGeneration):
+							pin(pin), path(path), fileStatistics(fileStatistics), datasetStatistics(datasetStatistics), scratch(scratch),
+							tracksWriteGeneration(tracksWriteGeneration), memType(-1), nElements(1) {
+						hid_t space = H5Dget_space(pin.get());
+						if (space < 0) {
+							throw Exception("TransferPlan: Could not retrieve dataspace of dataset '" + path + "'");
+						}
+						try {
+							ContainerInterface<T>::checkType(pin.get(), space);
+						}
+						catch (...) {
+							H5Sclose(space);
+							throw;
+						}
+						dims.resize(H5Sget_simple_extent_ndims(space));
+						H5Sget_simple_extent_dims(space, dims.data(), 0);
+						H5Sclose(space);
+
+						for (size_t i = 0; i < dims.size(); ++i) {
+							nElements *= dims[i];
+						}
+						memType = ContainerInterface<T>::hdfElementType();
+						nBytes = nElements * H5Tget_size(memType);
+					}
+					~State() {
+						// predefined types cannot be closed, compound ones have been created for us
+						H5E_BEGIN_TRY {
+							H5Tclose(memType);
+						} H5E_END_TRY;
+					}
+			};
+
+		public:
+			/**
+			 * @param pin Pinned handle of the dataset
+			 * @param path Path of the dataset, used for tracing
+			 * @param fileStatistics Statistics the transfers are accounted to, may be 0
+			 * @param datasetStatistics Statistics the transfers are accounted to, may be 0
+			 * @param scratch Allocator of the conversion buffers, 0 for the default one
+			 * @param tracksWriteGeneration True if writes are counted for a zone map, see DatasetInfo
+			 */
+			TransferPlan(const HandlePin& pin, const std::string& path, IoStatistics* fileStatistics, IoStatistics* datasetStatistics, ScratchAllocator* scratch,
+					bool tracksWriteGeneration = false):
+					fState(new State(pin, path, fileStatistics, datasetStatistics, scratch, tracksWriteGeneration)) {}
+
+			/// writes src, which has to hold as many elements as the dataset
+			void write(const T& src) const {
+				HDF5PP_TRACE_SCOPE(trace, "write", fState->path);
+				HDF5PP_TRACE_BYTES(trace, fState->nBytes);
+				if (ContainerInterface<T>::getNumElements(src) != fState->nElements) {
+					throw Exception("TransferPlan::write(): Number of elements of container and dataset '" + fState->path + "' does not match");
+				}
+				IoContext context(fState->fileStatistics, fState->datasetStatistics);
+				ScratchContext scratch(fState->scratch);
+				if (fState->tracksWriteGeneration) {
+					advanceWriteGeneration(fState->pin.get());
+				}
+				ContainerInterface<T>::writeData(src, fState->pin.get(), fState->memType);
+			}
+
+			/// reads the whole dataset into dst, dst is resized if necessary
+			void read(T& dst) const {
+				HDF5PP_TRACE_SCOPE(trace, "read", fState->path);
+				HDF5PP_TRACE_BYTES(trace, fState->nBytes);
+				IoContext context(fState->fileStatistics, fState->datasetStatistics);
+				ScratchContext scratch(fState->scratch);
+				ContainerInterface<T>::readData(dst, fState->pin.get(), fState->memType, fState->dims.data());
+			}
+
+			/// extents of the dataset at the time the plan has been prepared
+			inline const std::vector<hsize_t>& getExtents() const { return fState->dims; }
+			inline hsize_t getNumElements() const { return fState->nElements; }
+
+		private:
+			boost::shared_ptr<State> fState;
+	};
+
+} /* namespace hdf5 */
+#endif /* HDF5_TRANSFERPLAN_H_ */
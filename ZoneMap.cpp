@@ -0,0 +1,391 @@
+/*
+ * ZoneMap.cpp
+ *
+ * Per-chunk minimum/maximum of fields for skipping chunks on filtered reads
+ */
+
+#include "ZoneMap.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+namespace hdf5
+{
+
+	ZonePredicate& ZonePredicate::greater(const std::string& field, double value)
+	{
+		return add(field, value, true, numeric_limits<double>::infinity(), false);
+	}
+
+	ZonePredicate& ZonePredicate::greaterEqual(const std::string& field, double value)
+	{
+		return add(field, value, false, numeric_limits<double>::infinity(), false);
+	}
+
+	ZonePredicate& ZonePredicate::less(const std::string& field, double value)
+	{
+		return add(field, -numeric_limits<double>::infinity(), false, value, true);
+	}
+
+	ZonePredicate& ZonePredicate::lessEqual(const std::string& field, double value)
+	{
+		return add(field, -numeric_limits<double>::infinity(), false, value, false);
+	}
+
+	ZonePredicate& ZonePredicate::between(const std::string& field, double lo, double hi)
+	{
+		return add(field, lo, false, hi, false);
+	}
+
+	ZonePredicate& ZonePredicate::add(const std::string& field, double lo, bool loOpen, double hi, bool hiOpen)
+	{
+		Range range;
+		range.field = field;
+		range.lo = lo;
+		range.hi = hi;
+		range.loOpen = loOpen;
+		range.hiOpen = hiOpen;
+		fRanges.push_back(range);
+		return *this;
+	}
+
+	bool ZonePredicate::accepts(size_t range, double value) const
+	{
+		const Range& r = fRanges[range];
+		// comparisons with NaN are false
+		return (r.loOpen ? value > r.lo : value >= r.lo) && (r.hiOpen ? value < r.hi : value <= r.hi);
+	}
+
+	bool ZonePredicate::mayMatch(size_t range, double min, double max) const
+	{
+		const Range& r = fRanges[range];
+		// a block without any value has min > max
+		if (!(min <= max)) {
+			return false;
+		}
+		if (r.loOpen ? max <= r.lo : max < r.lo) {
+			return false;
+		}
+		if (r.hiOpen ? min >= r.hi : min > r.hi) {
+			return false;
+		}
+		return true;
+	}
+
+	ZoneMap::ZoneMap(const std::vector<std::string>& fields, hsize_t blockSize, hsize_t nRows, const std::vector<ZoneMapEntry>& entries):
+			fFields(fields), fBlockSize(blockSize), fNumRows(nRows), fEntries(entries)
+	{
+		if (fBlockSize == 0 || fEntries.size() != getNumBlocks() * getNumFields()) {
+			throw Exception("ZoneMap::ZoneMap(): Number of entries does not fit the number of rows and fields");
+		}
+	}
+
+	namespace
+	{
+		/**
+		 * Memory type holding the given fields as consecutive doubles, the
+		 * element itself for numeric datasets if fields is empty
+		 */
+		hid_t createFieldType(hid_t dataSet, const std::vector<std::string>& fields)
+		{
+			hid_t fileType = H5Dget_type(dataSet);
+			try {
+				ZoneMap::checkFields(fileType, fields);
+			}
+			catch (...) {
+				H5Tclose(fileType);
+				throw;
+			}
+			H5Tclose(fileType);
+			if (fields.empty()) {
+				return H5Tcopy(H5T_NATIVE_DOUBLE);
+			}
+
+			hid_t memType = H5Tcreate(H5T_COMPOUND, fields.size() * sizeof(double));
+			for (size_t i = 0; i < fields.size(); ++i) {
+				H5Tinsert(memType, fields[i].c_str(), i * sizeof(double), H5T_NATIVE_DOUBLE);
+			}
+			return memType;
+		}
+
+		/// rows read per H5Dread while building a zone map
+		const hsize_t BuildBatchRows = 1 << 20;
+	}
+
+	void ZoneMap::checkFields(hid_t type, const std::vector<std::string>& fields)
+	{
+		H5T_class_t typeClass = H5Tget_class(type);
+		if (fields.empty()) {
+			if (typeClass != H5T_INTEGER && typeClass != H5T_FLOAT) {
+				throw Exception("hdf5::ZoneMap: Datasets of a compound type need fields");
+			}
+			return;
+		}
+
+		if (typeClass != H5T_COMPOUND) {
+			throw Exception("hdf5::ZoneMap: Fields are only available for datasets of a compound type");
+		}
+		for (size_t i = 0; i < fields.size(); ++i) {
+			if (fields[i].empty() || fields[i].find(',') != string::npos) {
+				throw Exception("hdf5::ZoneMap: Invalid field name '" + fields[i] + "'");
+			}
+			int member = H5Tget_member_index(type, fields[i].c_str());
+			H5T_class_t memberClass = member < 0 ? H5T_NO_CLASS : H5Tget_member_class(type, member);
+			if (memberClass != H5T_INTEGER && memberClass != H5T_FLOAT) {
+				throw Exception("hdf5::ZoneMap: '" + fields[i] + "' is no numeric field of the dataset");
+			}
+		}
+	}
+
+	ZoneMap ZoneMap::build(hid_t dataSet, const std::vector<std::string>& fields, hsize_t blockSize)
+	{
+		if (blockSize == 0) {
+			throw Exception("ZoneMap::build(): Block size must be larger than zero");
+		}
+		hid_t fileSpace = H5Dget_space(dataSet);
+		if (H5Sget_simple_extent_ndims(fileSpace) != 1) {
+			H5Sclose(fileSpace);
+			throw Exception("ZoneMap::build(): Zone maps are only supported for datasets of rank 1");
+		}
+		hsize_t nRows;
+		H5Sget_simple_extent_dims(fileSpace, &nRows, 0);
+
+		hid_t memType;
+		try {
+			memType = createFieldType(dataSet, fields);
+		}
+		catch (...) {
+			H5Sclose(fileSpace);
+			throw;
+		}
+		size_t nFields = fields.empty() ? 1 : fields.size();
+		hsize_t nBlocks = (nRows + blockSize - 1) / blockSize;
+		vector<ZoneMapEntry> entries(nBlocks * nFields);
+
+		// whole blocks per read, at least one
+		hsize_t batchRows = max<hsize_t>(1, BuildBatchRows / blockSize) * blockSize;
+		ScratchBuffer<double> values(min(batchRows, nRows) * nFields);
+		for (hsize_t first = 0; first < nRows; first += batchRows) {
+			hsize_t count = min(batchRows, nRows - first);
+			H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, &first, 0, &count, 0);
+			hid_t memSpace = H5Screate_simple(1, &count, 0);
+			herr_t status;
+			{
+				IoTimer timer(IoRead, count * nFields * sizeof(double));
+				status = H5Dread(dataSet, memType, memSpace, fileSpace, H5P_DEFAULT, values.get());
+			}
+			H5Sclose(memSpace);
+			if (status < 0) {
+				H5Tclose(memType);
+				H5Sclose(fileSpace);
+				throw Exception("ZoneMap::build(): Error while reading fields from file");
+			}
+
+			for (hsize_t row = 0; row < count; row += blockSize) {
+				hsize_t block = (first + row) / blockSize;
+				hsize_t end = min(row + blockSize, count);
+				for (size_t field = 0; field < nFields; ++field) {
+					ZoneMapEntry& entry = entries[block * nFields + field];
+					entry.min = numeric_limits<double>::infinity();
+					entry.max = -numeric_limits<double>::infinity();
+					entry.nullCount = 0;
+					for (hsize_t i = row; i < end; ++i) {
+						double value = values[i * nFields + field];
+						if (std::isnan(value)) {
+							++entry.nullCount;
+						}
+						else {
+							entry.min = min(entry.min, value);
+							entry.max = max(entry.max, value);
+						}
+					}
+				}
+			}
+		}
+		H5Tclose(memType);
+		H5Sclose(fileSpace);
+
+		return ZoneMap(fields, blockSize, nRows, entries);
+	}
+
+	int ZoneMap::findField(const std::string& field) const
+	{
+		if (fFields.empty()) {
+			return field.empty() ? 0 : -1;
+		}
+		vector<string>::const_iterator it = find(fFields.begin(), fFields.end(), field);
+		return it == fFields.end() ? -1 : static_cast<int>(it - fFields.begin());
+	}
+
+	std::vector<ZoneMap::Run> ZoneMap::selectRuns(const ZonePredicate& predicate, hsize_t nRows) const
+	{
+		vector<Run> runs;
+		if (nRows == 0) {
+			return runs;
+		}
+		if (empty() || fNumRows != nRows) {
+			runs.push_back(Run(0, nRows));
+			return runs;
+		}
+
+		// fields of the predicate covered by the zone map, others cannot exclude anything
+		vector<int> fields(predicate.getNumRanges());
+		for (size_t range = 0; range < fields.size(); ++range) {
+			fields[range] = findField(predicate.getField(range));
+		}
+
+		for (hsize_t block = 0; block < getNumBlocks(); ++block) {
+			bool candidate = true;
+			for (size_t range = 0; range < fields.size() && candidate; ++range) {
+				if (fields[range] >= 0) {
+					const ZoneMapEntry& entry = getEntry(block, fields[range]);
+					candidate = predicate.mayMatch(range, entry.min, entry.max);
+				}
+			}
+			if (!candidate) {
+				continue;
+			}
+			hsize_t first = block * fBlockSize;
+			hsize_t count = min(fBlockSize, fNumRows - first);
+			if (!runs.empty() && runs.back().first + runs.back().second == first) {
+				runs.back().second += count;
+			}
+			else {
+				runs.push_back(Run(first, count));
+			}
+		}
+		return runs;
+	}
+
+	bool getWriteGeneration(hid_t dataSet, uint64_t& generation)
+	{
+		if (H5Aexists(dataSet, WriteGenerationAttribute) <= 0) {
+			return false;
+		}
+		hid_t attribute = H5Aopen(dataSet, WriteGenerationAttribute, H5P_DEFAULT);
+		herr_t status = attribute < 0 ? -1 : H5Aread(attribute, H5T_NATIVE_UINT64, &generation);
+		if (attribute >= 0) {
+			H5Aclose(attribute);
+		}
+		if (status < 0) {
+			throw Exception("hdf5::getWriteGeneration(): Could not read the write generation of the dataset");
+		}
+		return true;
+	}
+
+	uint64_t trackWriteGeneration(hid_t dataSet)
+	{
+		uint64_t generation = 0;
+		if (getWriteGeneration(dataSet, generation)) {
+			return generation;
+		}
+		hid_t space = H5Screate(H5S_SCALAR);
+		hid_t attribute = H5Acreate2(dataSet, WriteGenerationAttribute, H5T_NATIVE_UINT64, space, H5P_DEFAULT, H5P_DEFAULT);
+		H5Sclose(space);
+		herr_t status = attribute < 0 ? -1 : H5Awrite(attribute, H5T_NATIVE_UINT64, &generation);
+		if (attribute >= 0) {
+			H5Aclose(attribute);
+		}
+		if (status < 0) {
+			throw Exception("hdf5::trackWriteGeneration(): Could not create the write generation of the dataset");
+		}
+		return generation;
+	}
+
+	void advanceWriteGeneration(hid_t dataSet)
+	{
+		// the attribute may have been removed since the snapshot of the caller
+		hid_t attribute;
+		H5E_BEGIN_TRY {
+			attribute = H5Aopen(dataSet, WriteGenerationAttribute, H5P_DEFAULT);
+		} H5E_END_TRY;
+		if (attribute < 0) {
+			return;
+		}
+		uint64_t generation;
+		herr_t status = H5Aread(attribute, H5T_NATIVE_UINT64, &generation);
+		if (status >= 0) {
+			++generation;
+			status = H5Awrite(attribute, H5T_NATIVE_UINT64, &generation);
+		}
+		H5Aclose(attribute);
+		if (status < 0) {
+			throw Exception("hdf5::advanceWriteGeneration(): Could not update the write generation of the dataset");
+		}
+	}
+
+	void selectRuns(hid_t space, const std::vector<ZoneMap::Run>& runs)
+	{
+		H5Sselect_none(space);
+		for (size_t i = 0; i < runs.size(); ++i) {
+			if (H5Sselect_hyperslab(space, H5S_SELECT_OR, &runs[i].first, 0, &runs[i].second, 0) < 0) {
+				throw Exception("hdf5::selectRuns(): Could not select rows");
+			}
+		}
+	}
+
+	std::vector<char> matchRows(hid_t dataSet, const std::vector<ZoneMap::Run>& runs, const ZonePredicate& predicate)
+	{
+		hsize_t nSelected = 0;
+		for (size_t i = 0; i < runs.size(); ++i) {
+			nSelected += runs[i].second;
+		}
+		vector<char> matches(nSelected, 1);
+		if (nSelected == 0 || predicate.getNumRanges() == 0) {
+			return matches;
+		}
+
+		// each field is read once, even if several ranges refer to it
+		vector<string> fields;
+		vector<size_t> rangeField(predicate.getNumRanges());
+		for (size_t range = 0; range < predicate.getNumRanges(); ++range) {
+			const string& field = predicate.getField(range);
+			vector<string>::iterator it = find(fields.begin(), fields.end(), field);
+			rangeField[range] = it - fields.begin();
+			if (it == fields.end()) {
+				fields.push_back(field);
+			}
+		}
+		if (fields.size() == 1 && fields[0].empty()) {
+			fields.clear();
+		}
+		size_t nFields = fields.empty() ? 1 : fields.size();
+
+		hid_t memType = createFieldType(dataSet, fields);
+		hid_t fileSpace = H5Dget_space(dataSet);
+		try {
+			selectRuns(fileSpace, runs);
+		}
+		catch (...) {
+			H5Sclose(fileSpace);
+			H5Tclose(memType);
+			throw;
+		}
+		hid_t memSpace = H5Screate_simple(1, &nSelected, 0);
+		ScratchBuffer<double> values(nSelected * nFields);
+		herr_t status;
+		{
+			IoTimer timer(IoRead, nSelected * nFields * sizeof(double));
+			status = H5Dread(dataSet, memType, memSpace, fileSpace, H5P_DEFAULT, values.get());
+		}
+		H5Sclose(memSpace);
+		H5Sclose(fileSpace);
+		H5Tclose(memType);
+		if (status < 0) {
+			throw Exception("hdf5::matchRows(): Error while reading fields from file");
+		}
+
+		for (hsize_t row = 0; row < nSelected; ++row) {
+			for (size_t range = 0; range < rangeField.size(); ++range) {
+				if (!predicate.accepts(range, values[row * nFields + rangeField[range]])) {
+					matches[row] = 0;
+					break;
+				}
+			}
+		}
+		return matches;
+	}
+
+} /* namespace hdf5 */
@@ -0,0 +1,273 @@
+/*
+ * ZoneMap.h
+ *
+ * Per-chunk minimum/maximum of fields for skipping chunks on filtered reads
+ */
+
+#ifndef HDF5_ZONEMAP_H_
+#define HDF5_ZONEMAP_H_
+
+#include "Exception.h"
+#include "DataTypes.h"
+#include "ContainerInterface.h"
+#include "IoStatistics.h"
+#include "ScratchAllocator.h"
+#include <hdf5.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace hdf5
+{
+	/// name suffix of the dataset holding the zone map of a dataset
+	const char* const ZoneMapSuffix = ".zonemap";
+	/// attribute of a dataset with a zone map, counting the writes to the dataset
+	const char* const WriteGenerationAttribute = "WriteGeneration";
+
+	/// summary of one field within one block of rows
+	struct ZoneMapEntry {
+			double min;
+			double max;
+			/// number of NaN values, they are not included in min and max
+			uint64_t nullCount;
+	};
+
+	template<> struct DataType<ZoneMapEntry> {
+			typedef ZoneMapEntry ElementType;
+			typedef ZoneMapEntry PODType;
+			static hid_t hdfType() {
+				hid_t t = H5Tcreate(H5T_COMPOUND, sizeof(PODType));
+				H5Tinsert(t, "Min", HOFFSET(PODType, min), H5T_NATIVE_DOUBLE);
+				H5Tinsert(t, "Max", HOFFSET(PODType, max), H5T_NATIVE_DOUBLE);
+				H5Tinsert(t, "NullCount", HOFFSET(PODType, nullCount), H5T_NATIVE_ULLONG);
+				return t;
+			}
+			inline static hid_t isStructType() { return true; }
+			inline static hid_t isPOD() { return true; }
+			inline static hsize_t size() { return sizeof(ElementType); }
+			inline static void freePOD(PODType& pod) {};
+			inline static void assignToPOD(const ElementType& in, PODType& out) { out = in; }
+			inline static void assignFromPOD(const PODType& in, ElementType& out) { out = in; };
+	};
+
+	/**
+	 * Conjunction of value ranges on fields of a dataset, e.g.
+	 * ZonePredicate().greater("Energy", 5.).less("Time", 100.). For datasets
+	 * of a numeric type the field name is "". All values are compared as
+	 * double, NaN never matches.
+	 */
+	class ZonePredicate
+	{
+		public:
+			ZonePredicate& greater(const std::string& field, double value);
+			ZonePredicate& greaterEqual(const std::string& field, double value);
+			ZonePredicate& less(const std::string& field, double value);
+			ZonePredicate& lessEqual(const std::string& field, double value);
+			/// lo <= value <= hi
+			ZonePredicate& between(const std::string& field, double lo, double hi);
+			inline ZonePredicate& equal(const std::string& field, double value) { return between(field, value, value); }
+
+			inline size_t getNumRanges() const { return fRanges.size(); }
+			inline const std::string& getField(size_t range) const { return fRanges[range].field; }
+			/// true if value satisfies the given range
+			bool accepts(size_t range, double value) const;
+			/// false if no value within [min, max] can satisfy the given range
+			bool mayMatch(size_t range, double min, double max) const;
+
+		private:
+			struct Range {
+					std::string field;
+					double lo;
+					double hi;
+					bool loOpen;
+					bool hiOpen;
+			};
+
+			ZonePredicate& add(const std::string& field, double lo, bool loOpen, double hi, bool hiOpen);
+
+			std::vector<Range> fRanges;
+	};
+
+	/**
+	 * Minimum, maximum and NaN count of selected fields for every block of
+	 * blockSize rows of a rank 1 dataset. Group::createZoneMap() builds it
+	 * with the chunk size as block size and stores it next to the dataset.
+	 */
+	class ZoneMap
+	{
+		public:
+			/// rows [first, first+second) of a dataset
+			typedef std::pair<hsize_t, hsize_t> Run;
+
+			ZoneMap(): fBlockSize(0), fNumRows(0) {}
+			ZoneMap(const std::vector<std::string>& fields, hsize_t blockSize, hsize_t nRows, const std::vector<ZoneMapEntry>& entries);
+
+			/**
+			 * Scans the fields of a dataset, reading only these fields.
+			 * @param fields Members of a compound dataset, empty for numeric datasets
+			 */
+			static ZoneMap build(hid_t dataSet, const std::vector<std::string>& fields, hsize_t blockSize);
+			/// throws if a zone map of fields cannot be built for a dataset of the given type
+			static void checkFields(hid_t type, const std::vector<std::string>& fields);
+
+			inline bool empty() const { return fBlockSize == 0; }
+			/// fields covered, empty for a numeric dataset
+			inline const std::vector<std::string>& getFields() const { return fFields; }
+			inline hsize_t getBlockSize() const { return fBlockSize; }
+			/// number of rows of the dataset when the zone map has been built
+			inline hsize_t getNumRows() const { return fNumRows; }
+			inline hsize_t getNumBlocks() const { return fBlockSize ? (fNumRows + fBlockSize - 1) / fBlockSize : 0; }
+			inline const ZoneMapEntry& getEntry(hsize_t block, size_t field) const { return fEntries[block * getNumFields() + field]; }
+			inline const std::vector<ZoneMapEntry>& getEntries() const { return fEntries; }
+
+			/**
+			 * Rows of the blocks which may contain rows matching predicate,
+			 * adjacent blocks are merged. If the zone map does not cover nRows
+			 * rows, e.g. because the dataset has been resized, all rows are
+			 * returned.
+			 */
+			std::vector<Run> selectRuns(const ZonePredicate& predicate, hsize_t nRows) const;
+
+		private:
+			inline size_t getNumFields() const { return fFields.empty() ? 1 : fFields.size(); }
+			/// index of field in fFields, -1 if not covered
+			int findField(const std::string& field) const;
+
+			std::vector<std::string> fFields;
+			hsize_t fBlockSize;
+			hsize_t fNumRows;
+			std::vector<ZoneMapEntry> fEntries;
+	};
+
+	/**
+	 * Reads the write generation of a dataset into generation.
+	 * @return false if the writes of the dataset are not counted
+	 */
+	bool getWriteGeneration(hid_t dataSet, uint64_t& generation);
+	/// starts counting the writes of a dataset if necessary and returns the current write generation
+	uint64_t trackWriteGeneration(hid_t dataSet);
+	/**
+	 * Increments the write generation of a dataset whose writes are counted.
+	 * Dataset and TransferPlan call it before every write if the metadata
+	 * snapshot says so, see DatasetInfo::tracksWriteGeneration. A zone map
+	 * records the generation it has been built at and is not used once the
+	 * dataset has been written again.
+	 */
+	void advanceWriteGeneration(hid_t dataSet);
+
+	/// selects the rows of all runs in the dataspace of a rank 1 dataset
+	void selectRuns(hid_t space, const std::vector<ZoneMap::Run>& runs);
+
+	/**
+	 * Evaluates predicate on the rows of runs, reading only the fields of
+	 * the predicate.
+	 * @return one flag per selected row, in the order of the runs
+	 */
+	std::vector<char> matchRows(hid_t dataSet, const std::vector<ZoneMap::Run>& runs, const ZonePredicate& predicate);
+
+	/**
+	 * Reads the rows of a rank 1 dataset matching predicate into dst. Only
+	 * the blocks selected by the zone map are read.
+	 *
+	 * @param rowIndices If given, receives the position of each row in the dataset
+	 * @return number of rows that have been read and tested
+	 */
+	template<typename T> hsize_t readWhere(hid_t dataSet, const ZoneMap& zones, const ZonePredicate& predicate, std::vector<T>& dst,
+			std::vector<hsize_t>* rowIndices = 0) {
+		typedef typename DataType<T>::PODType POD;
+
+		hid_t fileSpace = H5Dget_space(dataSet);
+		hsize_t nRows = 0;
+		try {
+			ContainerInterface< std::vector<T> >::checkType(dataSet, fileSpace);
+			H5Sget_simple_extent_dims(fileSpace, &nRows, 0);
+		}
+		catch (...) {
+			H5Sclose(fileSpace);
+			throw;
+		}
+
+		std::vector<ZoneMap::Run> runs = zones.selectRuns(predicate, nRows);
+		hsize_t nSelected = 0;
+		for (size_t i = 0; i < runs.size(); ++i) {
+			nSelected += runs[i].second;
+		}
+		dst.clear();
+		if (rowIndices) {
+			rowIndices->clear();
+		}
+		if (nSelected == 0) {
+			H5Sclose(fileSpace);
+			return 0;
+		}
+
+		// only the matching rows are read in full
+		std::vector<ZoneMap::Run> matchingRuns;
+		hsize_t nMatching = 0;
+		try {
+			std::vector<char> matches = matchRows(dataSet, runs, predicate);
+			hsize_t iRow = 0;
+			for (size_t i = 0; i < runs.size(); ++i) {
+				for (hsize_t row = runs[i].first; row < runs[i].first + runs[i].second; ++row, ++iRow) {
+					if (!matches[iRow]) {
+						continue;
+					}
+					if (!matchingRuns.empty() && matchingRuns.back().first + matchingRuns.back().second == row) {
+						++matchingRuns.back().second;
+					}
+					else {
+						matchingRuns.push_back(ZoneMap::Run(row, 1));
+					}
+					++nMatching;
+				}
+			}
+			if (nMatching > 0) {
+				selectRuns(fileSpace, matchingRuns);
+			}
+		}
+		catch (...) {
+			H5Sclose(fileSpace);
+			throw;
+		}
+		if (nMatching == 0) {
+			H5Sclose(fileSpace);
+			return nSelected;
+		}
+
+		hid_t memSpace = H5Screate_simple(1, &nMatching, 0);
+		hid_t memType = DataType<T>::hdfType();
+		ScratchBuffer<POD> buffer(nMatching);
+		herr_t status;
+		{
+			IoTimer timer(IoRead, nMatching * sizeof(POD));
+			status = H5Dread(dataSet, memType, memSpace, fileSpace, H5P_DEFAULT, buffer.get());
+		}
+		H5E_BEGIN_TRY {
+			H5Tclose(memType);
+		} H5E_END_TRY;
+		H5Sclose(memSpace);
+		H5Sclose(fileSpace);
+		if (status < 0) {
+			throw Exception("hdf5::readWhere(): Error while reading data from file");
+		}
+
+		IoTimer timer(IoConvertFromPOD);
+		dst.resize(nMatching);
+		for (hsize_t i = 0; i < nMatching; ++i) {
+			DataType<T>::assignFromPOD(buffer[i], dst[i]);
+			DataType<T>::freePOD(buffer[i]);
+		}
+		if (rowIndices) {
+			rowIndices->reserve(nMatching);
+			for (size_t i = 0; i < matchingRuns.size(); ++i) {
+				for (hsize_t row = matchingRuns[i].first; row < matchingRuns[i].first + matchingRuns[i].second; ++row) {
+					rowIndices->push_back(row);
+				}
+			}
+		}
+		return nSelected;
+	}
+
+} /* namespace hdf5 */
+#endif /* HDF5_ZONEMAP_H_ */
@@ -0,0 +1,451 @@
+/*
+ * hdfBench.cpp
+ *
+ * Read/write throughput of all ContainerInterface paths against the plain C API
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <list>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <boost/multi_array.hpp>
+#include <boost/program_options.hpp>
+
+#include "File.h"
+
+using namespace std;
+namespace po = boost::program_options;
+
+/// number of calls of operator new, used by --check-allocations
+static std::atomic<size_t> gAllocations(0);
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+	gAllocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = malloc(size > 0 ? size : 1);
+	if (p == 0) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+struct Measurement {
+	string container;
+	string operation;
+	string api;
+	hsize_t elements;
+	hsize_t bytes;
+	vector<double> seconds;
+
+	double min() const { return *min_element(seconds.begin(), seconds.end()); }
+	double mean() const {
+		double sum = 0;
+		for (size_t i = 0; i < seconds.size(); ++i) {
+			sum += seconds[i];
+		}
+		return sum / seconds.size();
+	}
+	double median() const {
+		vector<double> s(seconds);
+		sort(s.begin(), s.end());
+		return s.size() % 2 ? s[s.size() / 2] : 0.5 * (s[s.size() / 2 - 1] + s[s.size() / 2]);
+	}
+};
+
+class Stopwatch {
+	public:
+		Stopwatch(): fStart(chrono::steady_clock::now()) {}
+		double elapsed() const { return chrono::duration<double>(chrono::steady_clock::now() - fStart).count(); }
+	private:
+		chrono::steady_clock::time_point fStart;
+};
+
+// container factories, n is the number of elements
+template<typename Container> struct Factory;
+
+template<> struct Factory< vector<double> > {
+	static string name() { return "std::vector<double>"; }
+	static hsize_t elements(hsize_t n) { return n; }
+	static vector<double> make(hsize_t n) {
+		vector<double> c(n);
+		for (hsize_t i = 0; i < n; ++i) {
+			c[i] = i;
+		}
+		return c;
+	}
+};
+
+template<> struct Factory< list<double> > {
+	static string name() { return "std::list<double>"; }
+	static hsize_t elements(hsize_t n) { return n; }
+	static list<double> make(hsize_t n) {
+		list<double> c;
+		for (hsize_t i = 0; i < n; ++i) {
+			c.push_back(i);
+		}
+		return c;
+	}
+};
+
+template<> struct Factory< map<int64_t, double> > {
+	static string name() { return "std::map<int64_t,double>"; }
+	static hsize_t elements(hsize_t n) { return n; }
+	static map<int64_t, double> make(hsize_t n) {
+		map<int64_t, double> c;
+		for (hsize_t i = 0; i < n; ++i) {
+			c.insert(c.end(), make_pair(static_cast<int64_t>(i), 0.5 * i));
+		}
+		return c;
+	}
+};
+
+template<> struct Factory< boost::multi_array<double, 2> > {
+	static const hsize_t Columns = 64;
+	static string name() { return "boost::multi_array<double,2>"; }
+	static hsize_t elements(hsize_t n) { return max<hsize_t>(1, n / Columns) * Columns; }
+	static boost::multi_array<double, 2> make(hsize_t n) {
+		hsize_t rows = elements(n) / Columns;
+		boost::multi_array<double, 2> c(boost::extents[rows][Columns]);
+		for (hsize_t i = 0; i < rows * Columns; ++i) {
+			c.data()[i] = i;
+		}
+		return c;
+	}
+};
+
+template<> struct Factory< vector<hdf5::Vector> > {
+	static string name() { return "std::vector<hdf5::Vector>"; }
+	static hsize_t elements(hsize_t n) { return n; }
+	static vector<hdf5::Vector> make(hsize_t n) {
+		vector<hdf5::Vector> c(n);
+		for (hsize_t i = 0; i < n; ++i) {
+			c[i] = hdf5::Vector(i, 2. * i, 3. * i);
+		}
+		return c;
+	}
+};
+
+/**
+ * Measures write and read of Container through the wrapper and the same
+ * transfer of an equivalent contiguous buffer through H5Dwrite/H5Dread.
+ */
+template<typename Container> void benchmark(hdf5::File& file, hsize_t bytes, size_t repetitions, vector<Measurement>& results)
+{
+	typedef Factory<Container> F;
+
+	hid_t memType = H5Tcopy(hdf5::ContainerInterface<Container>::hdfElementType());
+	size_t elementSize = H5Tget_size(memType);
+	hsize_t nElements = F::elements(max<hsize_t>(1, bytes / elementSize));
+
+	Measurement m;
+	m.container = F::name();
+	m.elements = nElements;
+	m.bytes = nElements * elementSize;
+	cerr << "  " << m.container << ": " << m.bytes << " bytes" << endl;
+
+	Container src = F::make(nElements);
+	hdf5::Dataset::Ptr ds = file.createDataset("bench", src);
+
+	// baseline dataset with same type and shape
+	hid_t space = hdf5::ContainerInterface<Container>::hdfSpace(src);
+	hid_t raw = H5Dcreate2(file.getIdentifier(), "bench_raw", memType, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+	H5Sclose(space);
+	if (raw < 0) {
+		throw hdf5::Exception("Could not create baseline dataset");
+	}
+	vector<char> buffer(m.bytes);
+	H5Dwrite(raw, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, &buffer[0]);
+
+	m.operation = "write";
+	m.api = "hdf5++";
+	m.seconds.clear();
+	for (size_t i = 0; i < repetitions; ++i) {
+		Stopwatch t;
+		ds->write(src);
+		m.seconds.push_back(t.elapsed());
+	}
+	results.push_back(m);
+
+	m.api = "c";
+	m.seconds.clear();
+	for (size_t i = 0; i < repetitions; ++i) {
+		Stopwatch t;
+		H5Dwrite(raw, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, &buffer[0]);
+		m.seconds.push_back(t.elapsed());
+	}
+	results.push_back(m);
+
+	m.operation = "read";
+	m.api = "hdf5++";
+	m.seconds.clear();
+	for (size_t i = 0; i < repetitions; ++i) {
+		Container dst;
+		Stopwatch t;
+		ds->read(dst);
+		m.seconds.push_back(t.elapsed());
+	}
+	results.push_back(m);
+
+	m.api = "c";
+	m.seconds.clear();
+	for (size_t i = 0; i < repetitions; ++i) {
+		Stopwatch t;
+		H5Dread(raw, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, &buffer[0]);
+		m.seconds.push_back(t.elapsed());
+	}
+	results.push_back(m);
+
+	// same transfers through a prepared plan, which must be gone before the dataset
+	{
+		hdf5::TransferPlan<Container> plan = ds->prepare<Container>();
+		m.api = "hdf5++ plan";
+		m.operation = "write";
+		m.seconds.clear();
+		for (size_t i = 0; i < repetitions; ++i) {
+			Stopwatch t;
+			plan.write(src);
+			m.seconds.push_back(t.elapsed());
+		}
+		results.push_back(m);
+
+		m.operation = "read";
+		m.seconds.clear();
+		for (size_t i = 0; i < repetitions; ++i) {
+			Container dst;
+			Stopwatch t;
+			plan.read(dst);
+			m.seconds.push_back(t.elapsed());
+		}
+		results.push_back(m);
+	}
+
+	H5Dclose(raw);
+	H5Ldelete(file.getIdentifier(), "bench_raw", H5P_DEFAULT);
+	ds.reset();
+	file.deleteObject("bench");
+	H5Tclose(memType);
+}
+
+/**
+ * Repeats write and read of a Container of the same size and counts the
+ * heap allocations of the wrapper after the first transfer. Allocations
+ * inside the HDF5 library are not visible here.
+ * @return true if the steady state did not allocate
+ */
+template<typename Container> bool checkAllocations(hdf5::File& file, hsize_t bytes, size_t repetitions)
+{
+	typedef Factory<Container> F;
+
+	hid_t memType = H5Tcopy(hdf5::ContainerInterface<Container>::hdfElementType());
+	hsize_t nElements = F::elements(max<hsize_t>(1, bytes / H5Tget_size(memType)));
+	H5Tclose(memType);
+
+	Container src = F::make(nElements);
+	Container dst;
+	hdf5::Dataset::Ptr ds = file.createDataset("allocations", src);
+
+	// the first transfer sizes dst and fills the scratch pool
+	ds->write(src);
+	ds->read(dst);
+
+	hdf5::PoolAllocator* pool = dynamic_cast<hdf5::PoolAllocator*>(ds->getScratchAllocator());
+	size_t poolBefore = pool ? pool->getNumSystemAllocations() : 0;
+	size_t before = gAllocations.load();
+	for (size_t i = 0; i < repetitions; ++i) {
+		ds->write(src);
+		ds->read(dst);
+	}
+	size_t allocations = gAllocations.load() - before;
+	size_t poolAllocations = pool ? pool->getNumSystemAllocations() - poolBefore : 0;
+
+	cerr << "  " << F::name() << ": " << allocations << " allocations, " << poolAllocations << " new scratch blocks in "
+			<< repetitions << " write/read cycles" << endl;
+
+	ds.reset();
+	file.deleteObject("allocations");
+	return allocations == 0 && poolAllocations == 0;
+}
+
+void writeJson(ostream& os, const vector<Measurement>& results)
+{
+	unsigned int major, minor, release;
+	H5get_libversion(&major, &minor, &release);
+
+	os << "{" << endl;
+	os << "  \"hdf5_version\": \"" << major << "." << minor << "." << release << "\"," << endl;
+	os << "  \"results\": [" << endl;
+	for (size_t i = 0; i < results.size(); ++i) {
+		const Measurement& m = results[i];
+
+		// overhead of the wrapper relative to the matching C API measurement
+		double baseline = 0;
+		for (size_t j = 0; j < results.size(); ++j) {
+			const Measurement& b = results[j];
+			if (b.api == "c" && b.container == m.container && b.operation == m.operation && b.bytes == m.bytes) {
+				baseline = b.median();
+			}
+		}
+
+		os << "    {\"container\": \"" << m.container << "\", \"operation\": \"" << m.operation << "\", \"api\": \"" << m.api << "\""
+				<< ", \"elements\": " << m.elements << ", \"bytes\": " << m.bytes << ", \"repetitions\": " << m.seconds.size()
+				<< ", \"min_s\": " << m.min() << ", \"median_s\": " << m.median() << ", \"mean_s\": " << m.mean()
+				<< ", \"mb_per_s\": " << (m.median() > 0 ? m.bytes / m.median() / 1e6 : 0)
+				<< ", \"relative_to_c\": " << (baseline > 0 ? m.median() / baseline : 0) << "}"
+				<< (i + 1 < results.size() ? "," : "") << endl;
+	}
+	os << "  ]" << endl;
+	os << "}" << endl;
+}
+
+/// parses sizes like 1024, 64K, 16M or 4G
+hsize_t parseSize(const string& s)
+{
+	istringstream is(s);
+	double value = 0;
+	string unit;
+	is >> value >> unit;
+	if (!is.eof() && is.fail()) {
+		throw hdf5::Exception("Invalid size '" + s + "'");
+	}
+	if (unit == "K" || unit == "k") {
+		value *= 1024.;
+	}
+	else if (unit == "M" || unit == "m") {
+		value *= 1024. * 1024.;
+	}
+	else if (unit == "G" || unit == "g") {
+		value *= 1024. * 1024. * 1024.;
+	}
+	else if (!unit.empty()) {
+		throw hdf5::Exception("Invalid size unit in '" + s + "'");
+	}
+	return static_cast<hsize_t>(value);
+}
+
+int main (int argc, char** argv) {
+	string fileName, output, minSize, maxSize, containers;
+	size_t repetitions, factor;
+
+	po::options_description desc("hdf5pp_bench: throughput of hdf5++ containers compared to the HDF5 C API");
+	desc.add_options()
+		("help,h", "show this help")
+		("file,f", po::value<string>(&fileName)->default_value("hdfBench.h5"), "scratch HDF5 file, removed afterwards")
+		("output,o", po::value<string>(&output)->default_value("-"), "JSON output file (- for stdout)")
+		("min-size", po::value<string>(&minSize)->default_value("1K"), "smallest dataset size in bytes (suffixes K, M, G)")
+		("max-size", po::value<string>(&maxSize)->default_value("4G"), "largest dataset size in bytes (suffixes K, M, G), "
+				"the peak memory use is several times this size, for std::list and std::map even more")
+		("factor", po::value<size_t>(&factor)->default_value(16), "growth factor between two sizes")
+		("repetitions,r", po::value<size_t>(&repetitions)->default_value(5), "repetitions of each measurement")
+		("containers,c", po::value<string>(&containers)->default_value("vector,list,map,multi_array,Vector"), "comma separated list of containers to measure")
+		("check-allocations", "instead of measuring, verify that repeated transfers of min-size bytes do not allocate")
+	;
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);
+	}
+	catch (const po::error& e) {
+		cerr << e.what() << endl << desc << endl;
+		return 1;
+	}
+	if (vm.count("help")) {
+		cout << desc << endl;
+		return 0;
+	}
+	if (factor < 2 || repetitions < 1) {
+		cerr << "factor must be at least 2 and repetitions at least 1" << endl;
+		return 1;
+	}
+
+	if (vm.count("check-allocations")) {
+		bool success = true;
+		try {
+			hsize_t bytes = parseSize(minSize);
+			containers = "," + containers + ",";
+
+			hdf5::File file(hdf5::OpenFile(fileName).readWrite().create().overwrite());
+			if (containers.find(",vector,") != string::npos) {
+				success &= checkAllocations< vector<double> >(file, bytes, repetitions);
+			}
+			if (containers.find(",list,") != string::npos) {
+				success &= checkAllocations< list<double> >(file, bytes, repetitions);
+			}
+			if (containers.find(",map,") != string::npos) {
+				success &= checkAllocations< map<int64_t, double> >(file, bytes, repetitions);
+			}
+			if (containers.find(",multi_array,") != string::npos) {
+				success &= checkAllocations< boost::multi_array<double, 2> >(file, bytes, repetitions);
+			}
+			if (containers.find(",Vector,") != string::npos) {
+				success &= checkAllocations< vector<hdf5::Vector> >(file, bytes, repetitions);
+			}
+			file.closeFile();
+		}
+		catch (const std::exception& e) {
+			cerr << "hdf5pp_bench: " << e.what() << endl;
+			success = false;
+		}
+		remove(fileName.c_str());
+		cerr << (success ? "no allocations in steady state" : "steady state allocates") << endl;
+		return success ? 0 : 1;
+	}
+
+	vector<Measurement> results;
+	try {
+		hsize_t minBytes = parseSize(minSize);
+		hsize_t maxBytes = parseSize(maxSize);
+		containers = "," + containers + ",";
+
+		hdf5::File file(hdf5::OpenFile(fileName).readWrite().create().overwrite());
+		for (hsize_t bytes = max<hsize_t>(1, minBytes); bytes <= maxBytes; bytes *= factor) {
+			cerr << "size " << bytes << " bytes" << endl;
+			if (containers.find(",vector,") != string::npos) {
+				benchmark< vector<double> >(file, bytes, repetitions, results);
+			}
+			if (containers.find(",list,") != string::npos) {
+				benchmark< list<double> >(file, bytes, repetitions, results);
+			}
+			if (containers.find(",map,") != string::npos) {
+				benchmark< map<int64_t, double> >(file, bytes, repetitions, results);
+			}
+			if (containers.find(",multi_array,") != string::npos) {
+				benchmark< boost::multi_array<double, 2> >(file, bytes, repetitions, results);
+			}
+			if (containers.find(",Vector,") != string::npos) {
+				benchmark< vector<hdf5::Vector> >(file, bytes, repetitions, results);
+			}
+		}
+		file.closeFile();
+	}
+	catch (const std::exception& e) {
+		cerr << "hdf5pp_bench: " << e.what() << endl;
+		remove(fileName.c_str());
+		return 1;
+	}
+	remove(fileName.c_str());
+
+	if (output == "-") {
+		writeJson(cout, results);
+	}
+	else {
+		ofstream os(output.c_str());
+		writeJson(os, results);
+	}
+
+	return 0;
+}
@@ -3,6 +3,7 @@
 #include <sstream>
 #include <string>
 #include <map>
+#include <cstring>
 #include "Exception.h"
 #include <boost/preprocessor/repetition/repeat.hpp>
 
@@ -24,27 +25,6 @@
 
 #define BASIC_TYPE_CNT 13
 
-#define ANYCAST_BASIC(TYPE, SRC, DST) if (SRC.type() == typeid(TYPE)) DST << boost::any_cast<TYPE>(SRC);
-
-
-namespace std {
-	// this is just a convenience stream operator to pipe c++ default types
-	std::ostream& operator<<(std::ostream& os, const boost::any& in) {
-		ANYCAST_BASIC(double, in, os)
-		else ANYCAST_BASIC(float, in, os)
-		else ANYCAST_BASIC(std::string, in, os)
-		else ANYCAST_BASIC(uint8_t, in, os)
-		else ANYCAST_BASIC(uint16_t, in, os)
-		else ANYCAST_BASIC(uint32_t, in, os)
-		else ANYCAST_BASIC(uint64_t, in, os)
-		else ANYCAST_BASIC(int8_t, in, os)
-		else ANYCAST_BASIC(int16_t, in, os)
-		else ANYCAST_BASIC(int32_t, in, os)
-		else ANYCAST_BASIC(int64_t, in, os)
-		else ANYCAST_BASIC(uint8_t, in, os)
-		return os;
-	}
-}
 
 namespace hdf5 {
 	/**
@@ -55,107 +35,186 @@ namespace hdf5 {
 	{
 		using namespace std;
 
-		// getting properties of the memory
-		int rank = H5Sget_simple_extent_ndims(type.space);
-		if (rank >= 0) {
+		bool isRead = false;
+		try {
+			// getting properties of the memory
+			int rank = H5Sget_simple_extent_ndims(type.space);
+			if (rank < 0) {
+				throw Exception("AttributeData: H5Sget_simple_extent_ndims returned an error");
+			}
 			data.rank = static_cast<size_t>(rank);
-		}
-		delete[] data.dimensions;
-
-		data.dimensions = new hsize_t[rank];
-		if (H5Sget_simple_extent_dims(type.space, data.dimensions, 0) < 0) {
-			throw Exception("AttributeData: H5Sget_simple_extent_dims returned an error");
-		}
-
-		// checking if it is a simple type or compound
-		data.typeSize = 0;
-		data.memorySize = 0;
-		free(data.memory);
-		if (type.typeClass == H5T_COMPOUND) {
-			int nMembers = H5Tget_nmembers(type.dataType);
-			if (nMembers < 0) {
-				throw Exception("AttributeData: H5Tget_nmembers returned an error");
+			data.dimensions = (rank <= static_cast<int>(InlineRank)) ? inlineDimensions : new hsize_t[rank];
+			if (H5Sget_simple_extent_dims(type.space, data.dimensions, 0) < 0) {
+				throw Exception("AttributeData: H5Sget_simple_extent_dims returned an error");
 			}
 
-			for(size_t iMember = 0; iMember < static_cast<size_t>(nMembers); ++iMember) {
-				hid_t memberType = H5Tget_member_type(type.dataType, iMember);
-				H5T_class_t tClass = H5Tget_class(memberType);
-				if (tClass != H5T_COMPOUND) {
-					data.typeSize += H5Tget_precision(memberType) / 8 * 2;
+			// checking if it is a simple type or compound
+			data.typeSize = 0;
+			data.memorySize = 0;
+			if (type.typeClass == H5T_COMPOUND) {
+				int nMembers = H5Tget_nmembers(type.dataType);
+				if (nMembers < 0) {
+					throw Exception("AttributeData: H5Tget_nmembers returned an error");
 				}
-				else {
-					throw Exception("AttributeData: Found a Compound in a Compound Attribute!!!");
+
+				for(size_t iMember = 0; iMember < static_cast<size_t>(nMembers); ++iMember) {
+					hid_t memberType = H5Tget_member_type(type.dataType, iMember);
+					H5T_class_t tClass = H5Tget_class(memberType);
+					H5Tclose(memberType);
+					if (tClass == H5T_COMPOUND) {
+						throw Exception("AttributeData: Found a Compound in a Compound Attribute!!!");
+					}
 				}
 			}
-			data.memorySize = data.typeSize;
+			data.typeSize = data.memorySize = getElementSize(type);
+
+			for (size_t i = 0; i < static_cast<size_t>(data.rank); ++i) {
+				data.memorySize *= data.dimensions[i];
+			}
+
+			// ensure a memory alignment of 8Bytes
+			size_t memSizeRest = 8 - (data.memorySize % 8);
+			data.memorySize += (memSizeRest < 8 ? memSizeRest : 0);
+//			cout << "Allocation " << data.memorySize << " Bytes / alignment rest " << memSizeRest << endl;
+			if (data.memorySize < 1) {
+				throw Exception("Error while determining required memory size --> got 0 Bytes!");
+			}
+			data.memory = (data.memorySize <= InlineMemorySize) ? static_cast<void*>(inlineMemory) : malloc(data.memorySize);
+			if (data.memory == 0) {
+				throw Exception("AttributeData: Could not allocate memory");
+			}
+
+			// reading data into ram
+			herr_t status = H5Aread(attributeId, type.dataType, data.memory);
+			if (status < 0) {
+				throw hdf5::Exception("AttributeData: H5Aread returned with an error");
+			}
+			isRead = true;
+
+			parsedAttributeValue = parseValue(type, data);
 		}
-		else {
+		catch (...) {
+			// the destructor does not run, variable length strings not decoded yet are still allocated
+			if (isRead) {
+				H5E_BEGIN_TRY {
+					H5Dvlen_reclaim(type.dataType, type.space, H5P_DEFAULT, data.memory);
+				} H5E_END_TRY;
+			}
+			release();
+			throw;
+		}
+	}
+
+	void AttributeData::release()
+	{
+		if (type.dataType > -1) {
+			H5Tclose(type.dataType);
+			type.dataType = -1;
+		}
+		if (type.space > -1) {
+			H5Sclose(type.space);
+			type.space = -1;
+		}
+		if (data.memory != inlineMemory) {
 			free(data.memory);
-			// allocating memory for this type
-			data.typeSize = data.memorySize = H5Tget_precision(type.dataType) / 8;
 		}
+		data.memory = 0;
+		if (data.dimensions != inlineDimensions) {
+			delete[] data.dimensions;
+		}
+		data.dimensions = 0;
+	}
 
-		for (size_t i = 0; i < static_cast<size_t>(data.rank); ++i) {
-			data.memorySize *= data.dimensions[i];
+	size_t AttributeData::getElementSize(const HdfType& aType)
+	{
+		// elements of compound arrays follow each other with the size of the type, strings are stored with their full size or as pointers
+		if (aType.typeClass == H5T_COMPOUND || aType.typeClass == H5T_STRING) {
+			return H5Tget_size(aType.dataType);
 		}
+		return H5Tget_precision(aType.dataType) / 8;
+	}
 
-		// ensure a memory alignment of 8Bytes
-		size_t memSizeRest = 8 - (data.memorySize % 8);
-		data.memorySize += (memSizeRest < 8 ? memSizeRest : 0);
-//		cout << "Allocation " << data.memorySize << " Bytes / alignment rest " << memSizeRest << endl;
-		if (data.memorySize < 1) {
-			throw Exception("Error while determining required memory size --> got 0 Bytes!");
+	AttributeValue AttributeData::parseValue(const HdfType& aType, RawData& aData)
+	{
+		if (aType.typeClass != H5T_COMPOUND) {
+			return parseRawValue(aType, aData);
 		}
-		data.memory = malloc(data.memorySize);
 
-		// reading data into ram
-		herr_t status = H5Aread(attributeId, type.dataType, data.memory);
-		if (status < 0) {
-			throw hdf5::Exception("AttributeData: H5Aread returned with an error");
+		AttributeValue result;
+		uint8_t* memory = static_cast<uint8_t*>(aData.memory);
+		if (aData.rank == 0) {
+			result = parseCompound(aType, memory, aData.releaseStrings);
+			return result;
 		}
 
-		if (type.typeClass == H5T_COMPOUND) {
-			if (rank != 0) {
-				throw Exception("AttributeData: Compound types are currently only supported at rank 0");
+		size_t nElements = 1;
+		for (size_t i = 0; i < aData.rank; ++i) {
+			nElements *= aData.dimensions[i];
+		}
+		std::vector<CompoundAttribute>* elements;
+		if (aData.rank == 1) {
+			elements = &result.emplace< std::vector<CompoundAttribute> >();
+		}
+		else {
+			ArrayAttribute<CompoundAttribute>& array = result.emplace< ArrayAttribute<CompoundAttribute> >();
+			array.shape.assign(aData.dimensions, aData.dimensions + aData.rank);
+			elements = &array.data;
+		}
+		elements->reserve(nElements);
+		for (size_t i = 0; i < nElements; ++i) {
+			elements->push_back(parseCompound(aType, memory + i * aData.typeSize, aData.releaseStrings));
+		}
+		return result;
+	}
+
+	CompoundAttribute AttributeData::parseCompound(const HdfType& aType, void* memory, bool releaseStrings)
+	{
+		using namespace std;
+
+		CompoundAttribute result;
+		int nMembers = H5Tget_nmembers(aType.dataType);
+		if (nMembers < 0) {
+			throw Exception("AttributeData: H5Tget_nmembers returned an error");
+		}
+		for(size_t iMember = 0; iMember < static_cast<size_t>(nMembers); ++iMember) {
+			// retrieving current members name
+			char* memberName = H5Tget_member_name(aType.dataType, iMember);
+			if (memberName == 0) {
+				throw Exception("AttributeData:Invalid memberName=0 retrieved");
 			}
-			int nMembers = H5Tget_nmembers(type.dataType);
-			map<std::string, any> result;
-			for(size_t iMember = 0; iMember < static_cast<size_t>(nMembers); ++iMember) {
-				// retrieving current members name
-				char* memberName = H5Tget_member_name(type.dataType, iMember);
-				if (memberName == 0) {
-					throw Exception("AttributeData:Invalid memberName=0 retrieved");
-				}
-				string name(memberName);
-				free(memberName);
+			string name(memberName);
+			free(memberName);
 
-				// prepare for parsing the data
-				HdfType memberType;
-				memberType.attributeId = attributeId;
-				memberType.dataType = H5Tget_member_type(type.dataType, iMember);
-				size_t offset = H5Tget_member_offset(type.dataType, iMember);
+			// prepare for parsing the data
+			HdfType memberType;
+			memberType.attributeId = aType.attributeId;
+			memberType.dataType = H5Tget_member_type(aType.dataType, iMember);
+			size_t offset = H5Tget_member_offset(aType.dataType, iMember);
 
-				memberType.typeClass = H5Tget_class(memberType.dataType);
-				RawData memberData;
-				memberData.rank = 0;
-				memberData.typeSize = H5Tget_precision(memberType.dataType) / 8;
-				memberData.memory = static_cast<void*>( static_cast<uint8_t*>(data.memory) + offset );
+			memberType.typeClass = H5Tget_class(memberType.dataType);
+			RawData memberData;
+			memberData.rank = 0;
+			memberData.typeSize = H5Tget_precision(memberType.dataType) / 8;
+			memberData.memory = static_cast<void*>( static_cast<uint8_t*>(memory) + offset );
+			memberData.releaseStrings = releaseStrings;
 
 
-				result[name] = parseRawValue(memberType, memberData);
+			try {
+				result.insert(result.end(), CompoundAttribute::value_type(name, parseRawValue(memberType, memberData)));
 			}
-			parsedAttributeValue = result;
-		}
-		else {
-			parsedAttributeValue = parseRawValue(type, data);
+			catch (...) {
+				H5Tclose(memberType.dataType);
+				throw;
+			}
+			H5Tclose(memberType.dataType);
 		}
-
+		return result;
 	}
 
-	any AttributeData::parseRawValue(HdfType aType, RawData& aData) {
+	AttributeValue AttributeData::parseRawValue(HdfType aType, RawData& aData) {
 		using namespace std;
 
-		any result;
+		AttributeValue result;
 
 		switch(aType.typeClass) {
 			case H5T_INTEGER:
@@ -173,10 +232,10 @@ namespace hdf5 {
 				else if (sign == H5T_SGN_2) {
 					// signed integers
 					switch (aData.typeSize * 8) {
-						case 8:  result = convertToCPP<uint8_t>::get(aData); break;
-						case 16: result = convertToCPP<uint16_t>::get(aData); break;
-						case 32: result = convertToCPP<uint32_t>::get(aData); break;
-						case 64: result = convertToCPP<uint64_t>::get(aData); break;
+						case 8:  result = convertToCPP<int8_t>::get(aData); break;
+						case 16: result = convertToCPP<int16_t>::get(aData); break;
+						case 32: result = convertToCPP<int32_t>::get(aData); break;
+						case 64: result = convertToCPP<int64_t>::get(aData); break;
 					}
 				}
 				else {
@@ -210,25 +269,39 @@ namespace hdf5 {
 					throw Exception("AttributeData: Could not retrieve information if member is of variable len");
 				}
 
+				size_t nElements = 1;
+				for (size_t i = 0; i < aData.rank; ++i) {
+					nElements *= aData.dimensions[i];
+				}
+				std::vector<std::string> strings(nElements);
 				if (!isVariableLen) {
-					// the memory is already initialized so do the usual typecasting stuff
-					result = convertToCPP<char*>::get(aData);
+					// the memory holds nElements strings of fixed size, not necessarily null terminated
+					size_t size = H5Tget_size(aType.dataType);
+					bool spacePadded = H5Tget_strpad(aType.dataType) == H5T_STR_SPACEPAD;
+					const char* memory = static_cast<const char*>(aData.memory);
+					for (size_t i = 0; i < nElements; ++i) {
+						const char* value = memory + i * size;
+						size_t length = strnlen(value, size);
+						while (spacePadded && length > 0 && value[length - 1] == ' ') {
+							--length;
+						}
+						strings[i].assign(value, length);
+					}
 				}
 				else {
-					// than it is a variable string ... the hdf5 C-api takes care of the memory allocation
-					RawData sMemory(aData);
-					char* varString;
-					herr_t status = H5Aread(aType.attributeId, aType.dataType, &varString);
-					if (status < 0)
-						throw Exception("AttributeData::parseRawValue: failed to read variable length string");
-					sMemory.memory = static_cast<void*>(varString);
-
-					// do the usual conversion stuff
-					result = convertToCPP<char*>::get(sMemory);
-
-					// but we need to free it
-					free (sMemory.memory);
+					// the memory holds pointers to the strings, which the library allocated for us when they were read
+					char** values = static_cast<char**>(aData.memory);
+					for (size_t i = 0; i < nElements; ++i) {
+						if (values[i]) {
+							strings[i].assign(values[i]);
+						}
+						if (aData.releaseStrings) {
+							free(values[i]);
+							values[i] = 0;
+						}
+					}
 				}
+				result = convertToCPP<std::string>::get(aData, strings);
 			}
 				break;
 			default:
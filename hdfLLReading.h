@@ -11,20 +11,13 @@
 #define HDF5_HDFLLREADING_H_
 
 #include "Exception.h"
+#include "AttributeValue.h"
 #include <hdf5.h>
 #include <string>
-#include <iostream>
-#include <boost/any.hpp>
-#include <boost/spirit/home/support/detail/hold_any.hpp>
+#include <vector>
 #include <boost/multi_array.hpp>
 
-namespace std {
-	std::ostream& operator<<(std::ostream& os, const boost::any& in);
-}
-
 namespace hdf5 {
-//	typedef boost::spirit::hold_any any;
-	typedef boost::any any;
 
 	/**
 	 * Container holding raw data including information about its geometry
@@ -35,8 +28,10 @@ namespace hdf5 {
 			size_t typeSize;
 			size_t memorySize;
 			void* memory;
+			/// variable length strings in memory are freed once they are decoded
+			bool releaseStrings;
 
-			RawData(): rank(0), dimensions(0), typeSize(0), memorySize(0), memory(0) {}
+			RawData(): rank(0), dimensions(0), typeSize(0), memorySize(0), memory(0), releaseStrings(true) {}
 			RawData(const RawData& z) { operator=(z); }
 			virtual ~RawData() {};
 
@@ -53,6 +48,7 @@ namespace hdf5 {
 					typeSize = z.typeSize;
 					memorySize = z.memorySize;
 					memory = z.memory;
+					releaseStrings = z.releaseStrings;
 				}
 				return *this;
 			}
@@ -90,58 +86,54 @@ namespace hdf5 {
 
 	/**
 	 *  Single values shall be converted its closest type.
-	 *  Arrays are converted into boost::multi_array
-	 *
-	 *  We are using ugly code to allow matrized upto rank 4.
+	 *  Arrays of rank 1 are converted into std::vector, arrays of higher
+	 *  rank into ArrayAttribute. Both are filled with one bulk copy.
 	 */
 	template<typename T> struct convertToCPP {
-			static any get(const RawData& data) {
-				any result;
+			static AttributeValue get(const RawData& data) {
+				AttributeValue result;
+				const T* x = static_cast<const T*>(data.memory);
 				if (data.rank == 0) {
-					T* x = static_cast<T*>(data.memory);
 					result = T(*x);
 				}
 				else if (data.rank == 1)
 				{
-					// store it into stl vector
-					std::vector<T> tmp;
-					tmp.reserve(data.dimensions[0]);
-					const T* x = static_cast<const T*>(data.memory);
-					for (size_t i = 0; i < data.dimensions[0]; ++i) {
-						tmp.push_back(T(x[i]));
-					}
-					result = tmp;
+					// store it into stl vector with one bulk copy
+					result.emplace< std::vector<T> >().assign(x, x + data.dimensions[0]);
 				}
-//				else if (data.rank == 2) {
-//					// store it into boost::multi_array
-//					result = boost::multi_array<T, 2>();
-//				}
-//				else if (data.rank == 3) {
-//					// store it into boost::multi_array
-//					result = boost::multi_array<T, 3>();
-//				}
-//				else if (data.rank == 4) {
-//					// store it into boost::multi_array
-//					result = boost::multi_array<T, 4>();
-//				}
 				else {
-					throw Exception("You wanted to read a data structure from a rank higher than 1, which is not yet supported.");
+					// store shape and elements in C order
+					ArrayAttribute<T>& array = result.emplace< ArrayAttribute<T> >();
+					array.shape.assign(data.dimensions, data.dimensions + data.rank);
+					size_t nElements = 1;
+					for (size_t i = 0; i < data.rank; ++i) {
+						nElements *= data.dimensions[i];
+					}
+					array.data.assign(x, x + nElements);
 				}
 				return result;
 			}
 	};
 
-	template<> struct convertToCPP<char*> {
-			static any get(RawData& data) {
-				using namespace std;
-				any result;
-
+	/**
+	 * Strings decoded from an attribute. Single strings and arrays of one
+	 * string are converted into std::string, arrays of rank 1 into
+	 * std::vector<std::string> and arrays of higher rank into
+	 * ArrayAttribute<std::string>. The strings are moved out of strings.
+	 */
+	template<> struct convertToCPP<std::string> {
+			static AttributeValue get(const RawData& data, std::vector<std::string>& strings) {
+				AttributeValue result;
 				if (data.rank == 0 || (data.rank == 1 && data.dimensions[0] == 1)) {
-					char* tmp = static_cast<char*>(data.memory);
-					result = std::string(tmp);
+					result.emplace<std::string>().swap(strings.at(0));
+				}
+				else if (data.rank == 1) {
+					result.emplace< std::vector<std::string> >().swap(strings);
 				}
 				else {
-					cerr << "Error: string of rank=" << data.rank << " other than 0 or rank=1 & dim[0]=1!!!!!" << endl;
+					ArrayAttribute<std::string>& array = result.emplace< ArrayAttribute<std::string> >();
+					array.shape.assign(data.dimensions, data.dimensions + data.rank);
+					array.data.swap(strings);
 				}
 				return result;
 			}
@@ -151,20 +143,32 @@ namespace hdf5 {
 	 * Attribute data converter
 	 */
 	struct AttributeData {
+			/// attributes up to this size are decoded without heap allocations
+			static const size_t InlineMemorySize = 64;
+			static const size_t InlineRank = 4;
+
 			hid_t attributeId;
 			std::string attributeName;
 
 			HdfType type;
 			RawData data;
 
-			any parsedAttributeValue;
+			AttributeValue parsedAttributeValue;
 
 			AttributeData(): attributeId(-1), attributeName("") {}
 			AttributeData(const AttributeData& x) { operator=(x); }
 			AttributeData(hid_t attributeId, const std::string& name);
-			virtual ~AttributeData() { free(data.memory); delete[] data.dimensions; };
+			virtual ~AttributeData() { release(); };
 
-			static any parseRawValue(HdfType aType, RawData& aData);
+			/**
+			 * Decodes values of any type class. Compounds of rank 0 are converted
+			 * into CompoundAttribute, of rank 1 into std::vector<CompoundAttribute>
+			 * and of higher rank into ArrayAttribute<CompoundAttribute>.
+			 */
+			static AttributeValue parseValue(const HdfType& aType, RawData& aData);
+			/// size of one element of aType in RawData::memory
+			static size_t getElementSize(const HdfType& aType);
+			static AttributeValue parseRawValue(HdfType aType, RawData& aData);
 
 			AttributeData& operator=(const AttributeData& x) {
 				if (&x != this) {
@@ -172,11 +176,20 @@ namespace hdf5 {
 				}
 				return *this;
 			}
+
+		private:
+			/// members of the compound value at memory
+			static CompoundAttribute parseCompound(const HdfType& aType, void* memory, bool releaseStrings);
+			/// closes the type and space, frees the memory
+			void release();
+
+			hsize_t inlineDimensions[InlineRank];
+			uint64_t inlineMemory[InlineMemorySize / sizeof(uint64_t)];
 	};
 
-	any llReadAttribute(hid_t attrId) {
-		AttributeData attr(attrId, "No Name");
-		return attr.parsedAttributeValue;
+	inline AttributeValue llReadAttribute(hid_t attrId) {
+		AttributeData attr(attrId, "");
+		return std::move(attr.parsedAttributeValue);
 	}
 
 	std::string getTypeClassName(hid_t typeID);
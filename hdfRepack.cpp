@@ -0,0 +1,1132 @@
+/*
+ * hdfRepack.cpp
+ *
+ * Copies an HDF5 file with new chunking and compression per dataset
+ */
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+#include <boost/program_options.hpp>
+#include <boost/regex.hpp>
+
+#include "File.h"
+#include "ThreadPool.h"
+
+using namespace std;
+namespace po = boost::program_options;
+
+class Stopwatch {
+	public:
+		Stopwatch(): fStart(chrono::steady_clock::now()) {}
+		double elapsed() const { return chrono::duration<double>(chrono::steady_clock::now() - fStart).count(); }
+	private:
+		chrono::steady_clock::time_point fStart;
+};
+
+/// parses sizes like 1024, 64K, 16M or 4G
+hsize_t parseSize(const string& s)
+{
+	istringstream is(s);
+	double value = 0;
+	string unit;
+	is >> value >> unit;
+	if (!is.eof() && is.fail()) {
+		throw hdf5::Exception("Invalid size '" + s + "'");
+	}
+	if (unit == "K" || unit == "k") {
+		value *= 1024.;
+	}
+	else if (unit == "M" || unit == "m") {
+		value *= 1024. * 1024.;
+	}
+	else if (unit == "G" || unit == "g") {
+		value *= 1024. * 1024. * 1024.;
+	}
+	else if (!unit.empty()) {
+		throw hdf5::Exception("Invalid size unit in '" + s + "'");
+	}
+	return static_cast<hsize_t>(value);
+}
+
+/// parses rows[=N], columns[=N], tiles=AxB.. and append, false for anything else
+bool parsePattern(const string& s, hdf5::AccessPattern& pattern)
+{
+	size_t equal = s.find('=');
+	string name = s.substr(0, equal);
+	vector<hsize_t> values;
+	if (equal != string::npos) {
+		istringstream is(s.substr(equal + 1));
+		string value;
+		while (getline(is, value, 'x')) {
+			values.push_back(parseSize(value));
+		}
+	}
+	if (name == "rows" && values.size() <= 1) {
+		pattern = hdf5::AccessPattern::rows(values.empty() ? 1 : values[0]);
+	}
+	else if (name == "columns" && values.size() <= 1) {
+		pattern = hdf5::AccessPattern::columns(values.empty() ? 1 : values[0]);
+	}
+	else if (name == "tiles" && !values.empty()) {
+		pattern = hdf5::AccessPattern::tiles(values);
+	}
+	else if (name == "append" && values.empty()) {
+		pattern = hdf5::AccessPattern::append();
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * New layout and filters of the datasets whose path matches pattern.
+ * Whatever a rule does not mention is taken over from the source dataset.
+ */
+struct Rule {
+	boost::regex pattern;
+	bool keepLayout;
+	bool keepFilters;
+	/// layout, chunk dimensions (0 for the whole dimension) and filters
+	hdf5::DatasetProperties properties;
+
+	Rule(): keepLayout(true), keepFilters(true) {}
+};
+
+/**
+ * parses PATTERN:SPEC with SPEC a comma separated list of chunk=AxB, an
+ * access pattern, contiguous, compact, deflate=N, shuffle and nofilter
+ */
+Rule parseRule(const string& s, const hdf5::ChunkAdvisor& advisor)
+{
+	size_t colon = s.rfind(':');
+	if (colon == string::npos) {
+		throw hdf5::Exception("Rule '" + s + "' has no ':' between pattern and layout");
+	}
+	Rule rule;
+	rule.pattern = boost::regex(s.substr(0, colon));
+
+	istringstream spec(s.substr(colon + 1));
+	string item;
+	while (getline(spec, item, ',')) {
+		hdf5::AccessPattern pattern;
+		if (parsePattern(item, pattern)) {
+			rule.properties.chunkedFor(pattern, advisor);
+			rule.keepLayout = false;
+		}
+		else if (item.compare(0, 6, "chunk=") == 0) {
+			vector<hsize_t> dims;
+			istringstream is(item.substr(6));
+			string dim;
+			while (getline(is, dim, 'x')) {
+				dims.push_back(parseSize(dim));
+			}
+			if (dims.empty()) {
+				throw hdf5::Exception("Rule '" + s + "' has no chunk dimensions");
+			}
+			rule.properties.chunked(dims);
+			rule.keepLayout = false;
+		}
+		else if (item == "contiguous") {
+			rule.properties.contiguous();
+			rule.keepLayout = false;
+		}
+		else if (item == "compact") {
+			rule.properties.compact();
+			rule.keepLayout = false;
+		}
+		else if (item.compare(0, 8, "deflate=") == 0) {
+			rule.properties.deflate(atoi(item.c_str() + 8));
+			rule.keepFilters = false;
+		}
+		else if (item == "shuffle") {
+			rule.properties.shuffle();
+			rule.keepFilters = false;
+		}
+		else if (item == "nofilter") {
+			rule.properties.noFilters();
+			rule.keepFilters = false;
+		}
+		else if (!item.empty()) {
+			throw hdf5::Exception("Rule '" + s + "' contains the unknown setting '" + item + "'");
+		}
+	}
+	return rule;
+}
+
+struct Totals {
+	size_t repacked;
+	size_t copied;
+	size_t links;
+	/// data size of the repacked datasets before filtering
+	hsize_t bytes;
+
+	Totals(): repacked(0), copied(0), links(0), bytes(0) {}
+};
+
+/**
+ * Copies the objects of a file into another one. Datasets matching a rule
+ * are created with the new layout. Their data is read in slabs of whole
+ * rows of chunks on the calling thread. If the new filters are shuffle
+ * and deflate only, the chunks of a slab are encoded on the pool while
+ * the next slab is read, and written with H5Dwrite_chunk. Otherwise the
+ * library encodes them in H5Dwrite. Likewise, chunks of sources filtered
+ * by shuffle and deflate only are read with H5Dread_chunk and decoded on
+ * the pool, other sources are decoded by the library in H5Dread. All
+ * other objects are copied with H5Ocopy.
+ */
+class Repacker
+{
+	public:
+		Repacker(const vector<Rule>& rules, hdf5::ThreadPool& pool, hsize_t memoryBudget):
+			fRules(rules), fPool(pool), fMemoryBudget(memoryBudget) {}
+
+		/// copies all links of src into the open group dst
+		void copyGroup(const hdf5::Group& src, hid_t dst);
+		/// copies all attributes of the object src to the object dst
+		static void copyAttributes(hid_t src, hid_t dst);
+
+		inline const Totals& getTotals() const { return fTotals; }
+
+	private:
+		/// chunk raw data as passed to H5Dwrite_chunk
+		struct EncodedChunk {
+			vector<hsize_t> offset;
+			vector<unsigned char> data;
+		};
+
+		/// chunk raw data as returned by H5Dread_chunk
+		struct StoredChunk {
+			vector<hsize_t> offset;
+			uint32_t filterMask;
+			vector<unsigned char> data;
+		};
+
+		/// rows [firstRow, firstRow+nRows) of a dataset, its stored source chunks and its encoded chunks
+		struct Slab {
+			hsize_t firstRow;
+			hsize_t nRows;
+			vector<unsigned char> raw;
+			vector<StoredChunk> stored;
+			vector<EncodedChunk> chunks;
+			/// encoding tasks not finished yet
+			size_t pending;
+			bool failed;
+
+			Slab(): firstRow(0), nRows(0), pending(0), failed(false) {}
+		};
+
+		const Rule* findRule(const string& path) const;
+		void copyDataset(hid_t srcGroup, const hdf5::Dataset& src, hid_t dstGroup, const string& name);
+		/// creation properties of the repacked dataset, H5Pclose() by the caller
+		hid_t createPropertyList(hid_t srcId, const hdf5::DatasetInfo& info, const Rule& rule) const;
+		/// rows per slab for a dataset with unit rows per row of chunks
+		hsize_t getSlabRows(const hdf5::DatasetInfo& info, const string& path, hsize_t unitRows, hsize_t reserved, size_t nSlabBuffers) const;
+
+		void transferLibrary(hid_t srcId, hid_t dstId, const hdf5::DatasetInfo& info, const hdf5::DatasetInfo& dstInfo, const string& path);
+		void transferEncoded(hid_t srcId, hid_t dstId, const hdf5::DatasetInfo& info, const hdf5::DatasetInfo& dstInfo, const string& path);
+		/// copies chunk index of slab into a full chunk and runs the filter pipeline of dstInfo on it
+		static bool encodeChunk(const Slab& slab, const hdf5::DatasetInfo& dstInfo, hsize_t index, EncodedChunk& chunk);
+		void submitSlab(Slab& slab, const hdf5::DatasetInfo& dstInfo);
+		/// reads the rows of slab as stored chunks, unallocated chunks are read through the library into slab.raw
+		static void readStoredChunks(hid_t srcId, const hdf5::DatasetInfo& info, Slab& slab, const string& path);
+		/// reverts the filter pipeline of info on a stored chunk and copies it into slab.raw
+		static bool decodeChunk(Slab& slab, const hdf5::DatasetInfo& info, const StoredChunk& chunk);
+		void submitStoredChunks(Slab& slab, const hdf5::DatasetInfo& info);
+		void waitForSlab(Slab& slab);
+
+		const vector<Rule>& fRules;
+		hdf5::ThreadPool& fPool;
+		hsize_t fMemoryBudget;
+		Totals fTotals;
+
+		mutex fMutex;
+		condition_variable fDone;
+};
+
+const Rule* Repacker::findRule(const string& path) const
+{
+	for (size_t i = 0; i < fRules.size(); ++i) {
+		if (boost::regex_match(path, fRules[i].pattern)) {
+			return &fRules[i];
+		}
+	}
+	return 0;
+}
+
+namespace
+{
+	herr_t copyAttribute(hid_t src, const char* name, const H5A_info_t*, void* data)
+	{
+		hid_t dst = *static_cast<hid_t*>(data);
+		hid_t attr = H5Aopen(src, name, H5P_DEFAULT);
+		if (attr < 0) {
+			return -1;
+		}
+		hid_t fileType = H5Aget_type(attr);
+		hid_t memType = H5Tget_native_type(fileType, H5T_DIR_DEFAULT);
+		hid_t space = H5Aget_space(attr);
+		hssize_t nElements = H5Sget_simple_extent_npoints(space);
+		vector<char> buffer(max<hssize_t>(nElements, 1) * H5Tget_size(memType));
+
+		herr_t status = H5Aread(attr, memType, &buffer[0]);
+		if (status >= 0) {
+			hid_t out = H5Acreate2(dst, name, fileType, space, H5P_DEFAULT, H5P_DEFAULT);
+			status = out < 0 ? -1 : H5Awrite(out, memType, &buffer[0]);
+			if (out >= 0) {
+				H5Aclose(out);
+			}
+			H5Dvlen_reclaim(memType, space, H5P_DEFAULT, &buffer[0]);
+		}
+		H5Sclose(space);
+		H5Tclose(memType);
+		H5Tclose(fileType);
+		H5Aclose(attr);
+		return status;
+	}
+
+	/// true if the elements of type can be copied byte by byte into another file
+	bool isFixedSize(hid_t type)
+	{
+		return H5Tdetect_class(type, H5T_VLEN) <= 0 && H5Tis_variable_str(type) <= 0 && H5Tdetect_class(type, H5T_REFERENCE) <= 0;
+	}
+
+	/// true if both dataset creation property lists give the same layout, chunks and filters
+	bool isSameStorage(hid_t a, hid_t b)
+	{
+		// H5Pequal does not compare the chunk dimensions reliably
+		H5D_layout_t layout = H5Pget_layout(a);
+		if (layout != H5Pget_layout(b)) {
+			return false;
+		}
+		if (layout == H5D_CHUNKED) {
+			hsize_t dimsA[H5S_MAX_RANK], dimsB[H5S_MAX_RANK];
+			int rank = H5Pget_chunk(a, H5S_MAX_RANK, dimsA);
+			if (rank != H5Pget_chunk(b, H5S_MAX_RANK, dimsB) || !equal(dimsA, dimsA + rank, dimsB)) {
+				return false;
+			}
+		}
+		int nFilters = H5Pget_nfilters(a);
+		if (nFilters != H5Pget_nfilters(b)) {
+			return false;
+		}
+		for (int i = 0; i < nFilters; ++i) {
+			unsigned int flags, valuesA[16], valuesB[16];
+			size_t nA = 16, nB = 16;
+			H5Z_filter_t idA = H5Pget_filter2(a, i, &flags, &nA, valuesA, 0, 0, 0);
+			H5Z_filter_t idB = H5Pget_filter2(b, i, &flags, &nB, valuesB, 0, 0, 0);
+			if (idA != idB || nA != nB || !equal(valuesA, valuesA + min<size_t>(nA, 16), valuesB)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	hsize_t gcd(hsize_t a, hsize_t b)
+	{
+		while (b) {
+			hsize_t t = a % b;
+			a = b;
+			b = t;
+		}
+		return a;
+	}
+
+	/// elements of all chunks of one row of chunks, i.e. without the first dimension
+	hsize_t getChunksPerRow(const hdf5::DatasetInfo& info)
+	{
+		hsize_t n = 1;
+		for (size_t d = 1; d < info.getRank(); ++d) {
+			n *= (info.shape[d] + info.chunkDims[d] - 1) / info.chunkDims[d];
+		}
+		return n;
+	}
+
+	hsize_t getChunkBytes(const hdf5::DatasetInfo& info)
+	{
+		hsize_t n = info.typeSize;
+		for (size_t d = 0; d < info.chunkDims.size(); ++d) {
+			n *= info.chunkDims[d];
+		}
+		return n;
+	}
+
+	/// true if the chunks of a dataset can be decoded without the library
+	bool isDecodable(const hdf5::DatasetInfo& info)
+	{
+		if (!info.isChunked() || info.getNumElements() == 0) {
+			return false;
+		}
+		for (size_t i = 0; i < info.filters.size(); ++i) {
+			if (info.filters[i].id != H5Z_FILTER_SHUFFLE && info.filters[i].id != H5Z_FILTER_DEFLATE) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Copies the part of a chunk of the given dimensions at offset, which
+	 * lies within a C order array of the given shape, from the array into
+	 * the chunk or back. The chunk is stored in full size.
+	 */
+	void copyChunk(unsigned char* chunk, unsigned char* array, const vector<hsize_t>& shape, const vector<hsize_t>& dims,
+			const vector<hsize_t>& offset, size_t typeSize, bool toChunk)
+	{
+		size_t rank = dims.size();
+		vector<hsize_t> extent(rank), arrayStride(rank, 1), chunkStride(rank, 1);
+		for (size_t d = 0; d < rank; ++d) {
+			extent[d] = min(dims[d], shape[d] - offset[d]);
+		}
+		for (size_t d = rank - 1; d > 0; --d) {
+			arrayStride[d - 1] = arrayStride[d] * shape[d];
+			chunkStride[d - 1] = chunkStride[d] * dims[d];
+		}
+		vector<hsize_t> idx(rank, 0);
+		size_t runBytes = extent[rank - 1] * typeSize;
+		for (;;) {
+			hsize_t arrayOffset = 0, chunkOffset = 0;
+			for (size_t d = 0; d < rank; ++d) {
+				arrayOffset += (offset[d] + idx[d]) * arrayStride[d];
+				chunkOffset += idx[d] * chunkStride[d];
+			}
+			if (toChunk) {
+				memcpy(chunk + chunkOffset * typeSize, array + arrayOffset * typeSize, runBytes);
+			}
+			else {
+				memcpy(array + arrayOffset * typeSize, chunk + chunkOffset * typeSize, runBytes);
+			}
+			// next run, the last dimension is copied as a whole
+			size_t d = rank - 1;
+			while (d > 0 && ++idx[d - 1] == extent[d - 1]) {
+				idx[d - 1] = 0;
+				--d;
+			}
+			if (d == 0) {
+				break;
+			}
+		}
+	}
+
+	/// offset of chunk index within the first nRows rows of a dataset, chunks are counted in storage order
+	vector<hsize_t> getChunkOffset(const hdf5::DatasetInfo& info, hsize_t nRows, hsize_t index)
+	{
+		size_t rank = info.getRank();
+		vector<hsize_t> offset(rank);
+		for (size_t d = rank; d-- > 0;) {
+			hsize_t size = d == 0 ? nRows : info.shape[d];
+			hsize_t nChunks = (size + info.chunkDims[d] - 1) / info.chunkDims[d];
+			offset[d] = (index % nChunks) * info.chunkDims[d];
+			index /= nChunks;
+		}
+		return offset;
+	}
+
+	/// chunks encoded per task, so tiny chunks do not cost a task each
+	const hsize_t TaskBytes = 1 << 20;
+}
+
+void Repacker::copyAttributes(hid_t src, hid_t dst)
+{
+	hsize_t idx = 0;
+	if (H5Aiterate2(src, H5_INDEX_NAME, H5_ITER_INC, &idx, &copyAttribute, &dst) < 0) {
+		throw hdf5::Exception("Repacker::copyAttributes(): Could not copy attributes");
+	}
+}
+
+void Repacker::copyGroup(const hdf5::Group& src, hid_t dst)
+{
+	hdf5::HandlePin pin = src.pinHandle();
+	vector<hdf5::Group::LinkInfo> links = src.listLinks();
+	for (size_t i = 0; i < links.size(); ++i) {
+		const hdf5::Group::LinkInfo& link = links[i];
+		const char* name = link.name.c_str();
+		if (link.linkType == hdf5::Group::LinkInfo::Hard && link.objectType == hdf5::Object::Group) {
+			hdf5::Group::ConstPtr group = src.getGroup(link.name);
+			hdf5::HandlePin groupPin = group->pinHandle();
+			hid_t gcpl = H5Gget_create_plist(groupPin.get());
+			hid_t groupId = H5Gcreate2(dst, name, H5P_DEFAULT, gcpl, H5P_DEFAULT);
+			H5Pclose(gcpl);
+			if (groupId < 0) {
+				throw hdf5::Exception("Could not create group " + group->getPath());
+			}
+			try {
+				copyAttributes(groupPin.get(), groupId);
+				copyGroup(*group, groupId);
+			}
+			catch (...) {
+				H5Gclose(groupId);
+				throw;
+			}
+			H5Gclose(groupId);
+		}
+		else if (link.linkType == hdf5::Group::LinkInfo::Hard && link.objectType == hdf5::Object::Dataset) {
+			copyDataset(pin.get(), *src.getDataSet(link.name), dst, link.name);
+		}
+		else if (link.linkType == hdf5::Group::LinkInfo::Hard) {
+			// e.g. committed datatypes
+			if (H5Ocopy(pin.get(), name, dst, name, H5P_DEFAULT, H5P_DEFAULT) < 0) {
+				throw hdf5::Exception("Could not copy object " + src.getPath() + "/" + link.name);
+			}
+			++fTotals.copied;
+		}
+		else if (link.linkType == hdf5::Group::LinkInfo::Soft || link.linkType == hdf5::Group::LinkInfo::External) {
+			H5L_info_t info;
+			H5Lget_info(pin.get(), name, &info, H5P_DEFAULT);
+			vector<char> value(info.u.val_size + 1, 0);
+			H5Lget_val(pin.get(), name, &value[0], value.size(), H5P_DEFAULT);
+			herr_t status;
+			if (link.linkType == hdf5::Group::LinkInfo::Soft) {
+				status = H5Lcreate_soft(&value[0], dst, name, H5P_DEFAULT, H5P_DEFAULT);
+			}
+			else {
+				unsigned int flags;
+				const char* fileName;
+				const char* objectName;
+				status = H5Lunpack_elink_val(&value[0], info.u.val_size, &flags, &fileName, &objectName);
+				if (status >= 0) {
+					status = H5Lcreate_external(fileName, objectName, dst, name, H5P_DEFAULT, H5P_DEFAULT);
+				}
+			}
+			if (status < 0) {
+				throw hdf5::Exception("Could not copy link " + src.getPath() + "/" + link.name);
+			}
+			++fTotals.links;
+		}
+		else {
+			cerr << "skipping user defined link " << src.getPath() << "/" << link.name << endl;
+		}
+	}
+}
+
+hid_t Repacker::createPropertyList(hid_t srcId, const hdf5::DatasetInfo& info, const Rule& rule) const
+{
+	const hdf5::DatasetProperties& properties = rule.properties;
+	// keeps fill value, allocation time and everything else not covered by the rule
+	hid_t dcpl = H5Dget_create_plist(srcId);
+	herr_t err = 0;
+
+	H5D_layout_t layout = rule.keepLayout ? info.layout : properties.fLayout;
+	if (layout == H5D_CHUNKED) {
+		vector<hsize_t> dims = rule.keepLayout ? info.chunkDims : properties.fChunkDims;
+		if (!rule.keepLayout && properties.fAccessPattern.kind != hdf5::AccessPattern::None) {
+			dims = properties.fAdvisor.suggest(info.shape, info.typeSize, properties.fAccessPattern);
+		}
+		if (dims.size() != info.getRank()) {
+			H5Pclose(dcpl);
+			throw hdf5::Exception("Rank of the chunks and the dataset does not match");
+		}
+		for (size_t d = 0; d < dims.size(); ++d) {
+			if (dims[d] == 0) {
+				dims[d] = info.shape[d];
+			}
+			// chunks must not be larger than fixed size dimensions
+			if (info.maxShape[d] != H5S_UNLIMITED) {
+				dims[d] = min(dims[d], info.maxShape[d]);
+			}
+			dims[d] = max<hsize_t>(dims[d], 1);
+		}
+		err |= H5Pset_chunk(dcpl, static_cast<int>(dims.size()), &dims[0]);
+	}
+	else {
+		if (H5Pget_nfilters(dcpl) > 0) {
+			err |= H5Premove_filter(dcpl, H5Z_FILTER_ALL);
+		}
+		err |= H5Pset_layout(dcpl, layout);
+	}
+
+	if (!rule.keepFilters) {
+		if (H5Pget_nfilters(dcpl) > 0) {
+			err |= H5Premove_filter(dcpl, H5Z_FILTER_ALL);
+		}
+		if ((properties.fShuffle || properties.fDeflateLevel >= 0) && layout != H5D_CHUNKED) {
+			H5Pclose(dcpl);
+			throw hdf5::Exception("Filters need a chunked layout");
+		}
+		if (properties.fShuffle) {
+			err |= H5Pset_shuffle(dcpl);
+		}
+		if (properties.fDeflateLevel >= 0) {
+			err |= H5Pset_deflate(dcpl, properties.fDeflateLevel);
+		}
+	}
+
+	if (err < 0) {
+		H5Pclose(dcpl);
+		throw hdf5::Exception("Could not set the creation properties");
+	}
+	return dcpl;
+}
+
+void Repacker::copyDataset(hid_t srcGroup, const hdf5::Dataset& src, hid_t dstGroup, const string& name)
+{
+	const string path = src.getPath();
+	const hdf5::DatasetInfo& info = src.getInfo();
+	hdf5::HandlePin pin = src.pinHandle();
+	hid_t srcId = pin.get();
+	Stopwatch t;
+
+	const Rule* rule = findRule(path);
+	hid_t dcpl = -1;
+	if (rule && info.getRank() > 0) {
+		try {
+			dcpl = createPropertyList(srcId, info, *rule);
+		}
+		catch (const hdf5::Exception& e) {
+			throw hdf5::Exception(path + ": " + e.what());
+		}
+		// nothing to change
+		hid_t srcDcpl = H5Dget_create_plist(srcId);
+		if (isSameStorage(dcpl, srcDcpl)) {
+			H5Pclose(dcpl);
+			dcpl = -1;
+		}
+		H5Pclose(srcDcpl);
+	}
+	if (dcpl < 0) {
+		if (H5Ocopy(srcGroup, name.c_str(), dstGroup, name.c_str(), H5P_DEFAULT, H5P_DEFAULT) < 0) {
+			throw hdf5::Exception("Could not copy dataset " + path);
+		}
+		++fTotals.copied;
+		return;
+	}
+
+	// a transient copy, committed datatypes cannot be used in another file
+	hid_t srcType = H5Dget_type(srcId);
+	hid_t type = H5Tcopy(srcType);
+	H5Tclose(srcType);
+	hid_t space = H5Dget_space(srcId);
+	hid_t dstId = H5Dcreate2(dstGroup, name.c_str(), type, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+	bool fixedSize = isFixedSize(type);
+	H5Sclose(space);
+	H5Tclose(type);
+	H5Pclose(dcpl);
+	if (dstId < 0) {
+		throw hdf5::Exception("Could not create dataset " + path + " with the new layout");
+	}
+
+	hdf5::DatasetInfo dstInfo(dstId);
+	bool encoded = fixedSize && dstInfo.isChunked() && info.getNumElements() > 0;
+	for (size_t i = 0; i < dstInfo.filters.size(); ++i) {
+		encoded = encoded && (dstInfo.filters[i].id == H5Z_FILTER_SHUFFLE || dstInfo.filters[i].id == H5Z_FILTER_DEFLATE);
+	}
+	try {
+		copyAttributes(srcId, dstId);
+		if (encoded) {
+			transferEncoded(srcId, dstId, info, dstInfo, path);
+		}
+		else if (info.getNumElements() > 0) {
+			transferLibrary(srcId, dstId, info, dstInfo, path);
+		}
+	}
+	catch (...) {
+		H5Dclose(dstId);
+		throw;
+	}
+
+	hsize_t stored = H5Dget_storage_size(dstId);
+	H5Dclose(dstId);
+	++fTotals.repacked;
+	fTotals.bytes += info.getDataSize();
+	cout << path << ": " << info.getDataSize() << " bytes, " << info.storageSize << " -> " << stored << " bytes stored, "
+			<< t.elapsed() << "s" << (encoded || info.getNumElements() == 0 ? "" : " (encoded by the library)") << endl;
+}
+
+hsize_t Repacker::getSlabRows(const hdf5::DatasetInfo& info, const string& path, hsize_t unitRows, hsize_t reserved, size_t nSlabBuffers) const
+{
+	hsize_t rowBytes = info.getDataSize() / info.shape[0];
+	hsize_t budget = fMemoryBudget > reserved ? (fMemoryBudget - reserved) / nSlabBuffers : 0;
+	// whole rows of source chunks as well, so no source chunk is decoded twice
+	if (info.isChunked()) {
+		hsize_t srcRows = info.chunkDims[0];
+		hsize_t lcm = unitRows / gcd(unitRows, srcRows) * srcRows;
+		if (lcm * rowBytes <= budget) {
+			unitRows = lcm;
+		}
+	}
+	if (unitRows * rowBytes > budget) {
+		cerr << path << ": one row of chunks needs " << unitRows * rowBytes * nSlabBuffers + reserved << " bytes, more than the memory budget" << endl;
+	}
+	hsize_t rows = max<hsize_t>(1, budget / rowBytes / unitRows) * unitRows;
+	return min(rows, (info.shape[0] + unitRows - 1) / unitRows * unitRows);
+}
+
+void Repacker::transferLibrary(hid_t srcId, hid_t dstId, const hdf5::DatasetInfo& info, const hdf5::DatasetInfo& dstInfo, const string& path)
+{
+	hid_t fileType = H5Dget_type(srcId);
+	hid_t memType = H5Tget_native_type(fileType, H5T_DIR_DEFAULT);
+	H5Tclose(fileType);
+	size_t rank = info.getRank();
+	hsize_t rowElements = info.getNumElements() / info.shape[0];
+	hsize_t slabRows = getSlabRows(info, path, dstInfo.isChunked() ? dstInfo.chunkDims[0] : 1, 0, 1);
+	vector<char> buffer(slabRows * rowElements * H5Tget_size(memType));
+
+	vector<hsize_t> start(rank, 0), count(info.shape);
+	hid_t srcSpace = H5Dget_space(srcId);
+	hid_t dstSpace = H5Dget_space(dstId);
+	herr_t status = 0;
+	for (hsize_t row = 0; row < info.shape[0] && status >= 0; row += slabRows) {
+		start[0] = row;
+		count[0] = min(slabRows, info.shape[0] - row);
+		H5Sselect_hyperslab(srcSpace, H5S_SELECT_SET, &start[0], 0, &count[0], 0);
+		H5Sselect_hyperslab(dstSpace, H5S_SELECT_SET, &start[0], 0, &count[0], 0);
+		hid_t memSpace = H5Screate_simple(rank, &count[0], 0);
+		status = H5Dread(srcId, memType, memSpace, srcSpace, H5P_DEFAULT, &buffer[0]);
+		if (status >= 0) {
+			status = H5Dwrite(dstId, memType, memSpace, dstSpace, H5P_DEFAULT, &buffer[0]);
+			H5Dvlen_reclaim(memType, memSpace, H5P_DEFAULT, &buffer[0]);
+		}
+		H5Sclose(memSpace);
+	}
+	H5Sclose(dstSpace);
+	H5Sclose(srcSpace);
+	H5Tclose(memType);
+	if (status < 0) {
+		throw hdf5::Exception("Could not copy the data of " + path);
+	}
+}
+
+bool Repacker::encodeChunk(const Slab& slab, const hdf5::DatasetInfo& dstInfo, hsize_t index, EncodedChunk& chunk)
+{
+	// buffers of this worker, reused for all chunks
+	static thread_local vector<unsigned char> data, temp;
+
+	size_t rank = dstInfo.getRank();
+	const vector<hsize_t>& dims = dstInfo.chunkDims;
+	size_t typeSize = dstInfo.typeSize;
+	hsize_t chunkBytes = getChunkBytes(dstInfo);
+
+	// position of the chunk, the index runs over the chunks of the slab in storage order
+	chunk.offset = getChunkOffset(dstInfo, slab.nRows, index);
+	vector<hsize_t> slabShape(dstInfo.shape);
+	slabShape[0] = slab.nRows;
+	bool partial = false;
+	for (size_t d = 0; d < rank; ++d) {
+		partial = partial || chunk.offset[d] + dims[d] > slabShape[d];
+	}
+
+	// copy the chunk out of the slab, the parts beyond the dataset stay zero
+	data.resize(chunkBytes);
+	if (partial) {
+		memset(&data[0], 0, chunkBytes);
+	}
+	copyChunk(&data[0], const_cast<unsigned char*>(&slab.raw[0]), slabShape, dims, chunk.offset, typeSize, true);
+	chunk.offset[0] += slab.firstRow;
+
+	// filters in pipeline order, as H5Z_filter_shuffle and H5Z_filter_deflate do it
+	size_t size = chunkBytes;
+	for (size_t i = 0; i < dstInfo.filters.size(); ++i) {
+		const hdf5::DatasetInfo::Filter& filter = dstInfo.filters[i];
+		if (filter.id == H5Z_FILTER_SHUFFLE && typeSize > 1) {
+			size_t n = size / typeSize;
+			temp.resize(size);
+			for (size_t b = 0; b < typeSize; ++b) {
+				for (size_t e = 0; e < n; ++e) {
+					temp[b * n + e] = data[e * typeSize + b];
+				}
+			}
+			data.swap(temp);
+		}
+		else if (filter.id == H5Z_FILTER_DEFLATE) {
+			uLongf compressed = compressBound(size);
+			temp.resize(compressed);
+			int level = filter.parameters.empty() ? Z_DEFAULT_COMPRESSION : filter.parameters[0];
+			if (compress2(&temp[0], &compressed, &data[0], size, level) != Z_OK) {
+				return false;
+			}
+			size = compressed;
+			data.swap(temp);
+		}
+	}
+	chunk.data.assign(data.begin(), data.begin() + size);
+	return true;
+}
+
+void Repacker::submitSlab(Slab& slab, const hdf5::DatasetInfo& dstInfo)
+{
+	hsize_t nChunks = (slab.nRows + dstInfo.chunkDims[0] - 1) / dstInfo.chunkDims[0] * getChunksPerRow(dstInfo);
+	hsize_t chunksPerTask = max<hsize_t>(1, TaskBytes / getChunkBytes(dstInfo));
+	slab.chunks.resize(nChunks);
+	slab.failed = false;
+	slab.pending = (nChunks + chunksPerTask - 1) / chunksPerTask;
+
+	Slab* s = &slab;
+	const hdf5::DatasetInfo* info = &dstInfo;
+	for (hsize_t first = 0; first < nChunks; first += chunksPerTask) {
+		hsize_t end = min(first + chunksPerTask, nChunks);
+		fPool.submit([this, s, info, first, end]() {
+			bool success = true;
+			for (hsize_t i = first; i < end && success; ++i) {
+				success = encodeChunk(*s, *info, i, s->chunks[i]);
+			}
+			lock_guard<mutex> lock(fMutex);
+			s->failed = s->failed || !success;
+			--s->pending;
+			fDone.notify_all();
+		});
+	}
+}
+
+void Repacker::readStoredChunks(hid_t srcId, const hdf5::DatasetInfo& info, Slab& slab, const string& path)
+{
+	size_t rank = info.getRank();
+	hsize_t nChunks = (slab.nRows + info.chunkDims[0] - 1) / info.chunkDims[0] * getChunksPerRow(info);
+	slab.stored.resize(nChunks);
+	size_t nStored = 0;
+	for (hsize_t i = 0; i < nChunks; ++i) {
+		StoredChunk& chunk = slab.stored[nStored];
+		chunk.offset = getChunkOffset(info, slab.nRows, i);
+		chunk.offset[0] += slab.firstRow;
+
+		// fails for chunks that are not allocated
+		hsize_t size = 0;
+		herr_t found;
+		H5E_BEGIN_TRY {
+			found = H5Dget_chunk_storage_size(srcId, &chunk.offset[0], &size);
+		} H5E_END_TRY;
+		if (found >= 0 && size > 0) {
+			chunk.data.resize(size);
+			if (H5Dread_chunk(srcId, H5P_DEFAULT, &chunk.offset[0], &chunk.filterMask, &chunk.data[0]) < 0) {
+				throw hdf5::Exception("Could not read the chunks of " + path);
+			}
+			++nStored;
+			continue;
+		}
+
+		// not allocated, the library supplies the fill value
+		vector<hsize_t> slabShape(info.shape), memStart(chunk.offset), count(rank);
+		slabShape[0] = slab.nRows;
+		memStart[0] -= slab.firstRow;
+		for (size_t d = 0; d < rank; ++d) {
+			count[d] = min(info.chunkDims[d], info.shape[d] - chunk.offset[d]);
+		}
+		hid_t type = H5Dget_type(srcId);
+		hid_t space = H5Dget_space(srcId);
+		hid_t memSpace = H5Screate_simple(rank, &slabShape[0], 0);
+		H5Sselect_hyperslab(space, H5S_SELECT_SET, &chunk.offset[0], 0, &count[0], 0);
+		H5Sselect_hyperslab(memSpace, H5S_SELECT_SET, &memStart[0], 0, &count[0], 0);
+		herr_t status = H5Dread(srcId, type, memSpace, space, H5P_DEFAULT, &slab.raw[0]);
+		H5Sclose(memSpace);
+		H5Sclose(space);
+		H5Tclose(type);
+		if (status < 0) {
+			throw hdf5::Exception("Could not read the data of " + path);
+		}
+	}
+	slab.stored.resize(nStored);
+}
+
+bool Repacker::decodeChunk(Slab& slab, const hdf5::DatasetInfo& info, const StoredChunk& chunk)
+{
+	// buffers of this worker, reused for all chunks
+	static thread_local vector<unsigned char> data, temp;
+
+	size_t typeSize = info.typeSize;
+	hsize_t chunkBytes = getChunkBytes(info);
+
+	// filters in reverse pipeline order, skipping the ones the mask marks as not applied
+	data.assign(chunk.data.begin(), chunk.data.end());
+	size_t size = data.size();
+	for (size_t i = info.filters.size(); i-- > 0;) {
+		const hdf5::DatasetInfo::Filter& filter = info.filters[i];
+		if (chunk.filterMask & (1u << i)) {
+			continue;
+		}
+		if (filter.id == H5Z_FILTER_SHUFFLE && typeSize > 1) {
+			size_t n = size / typeSize;
+			temp.resize(size);
+			for (size_t b = 0; b < typeSize; ++b) {
+				for (size_t e = 0; e < n; ++e) {
+					temp[e * typeSize + b] = data[b * n + e];
+				}
+			}
+			data.swap(temp);
+		}
+		else if (filter.id == H5Z_FILTER_DEFLATE) {
+			uLongf inflated = chunkBytes;
+			temp.resize(chunkBytes);
+			if (uncompress(&temp[0], &inflated, &data[0], size) != Z_OK) {
+				return false;
+			}
+			size = inflated;
+			data.swap(temp);
+		}
+	}
+	if (size != chunkBytes) {
+		return false;
+	}
+
+	// copy the part within the slab, the chunk is stored in full size
+	vector<hsize_t> slabShape(info.shape), offset(chunk.offset);
+	slabShape[0] = slab.nRows;
+	offset[0] -= slab.firstRow;
+	copyChunk(&data[0], &slab.raw[0], slabShape, info.chunkDims, offset, typeSize, false);
+	return true;
+}
+
+void Repacker::submitStoredChunks(Slab& slab, const hdf5::DatasetInfo& info)
+{
+	hsize_t nChunks = slab.stored.size();
+	hsize_t chunksPerTask = max<hsize_t>(1, TaskBytes / getChunkBytes(info));
+	slab.failed = false;
+	slab.pending = (nChunks + chunksPerTask - 1) / chunksPerTask;
+
+	Slab* s = &slab;
+	const hdf5::DatasetInfo* i = &info;
+	for (hsize_t first = 0; first < nChunks; first += chunksPerTask) {
+		hsize_t end = min(first + chunksPerTask, nChunks);
+		fPool.submit([this, s, i, first, end]() {
+			bool success = true;
+			for (hsize_t c = first; c < end && success; ++c) {
+				success = decodeChunk(*s, *i, s->stored[c]);
+			}
+			lock_guard<mutex> lock(fMutex);
+			s->failed = s->failed || !success;
+			--s->pending;
+			fDone.notify_all();
+		});
+	}
+}
+
+void Repacker::waitForSlab(Slab& slab)
+{
+	unique_lock<mutex> lock(fMutex);
+	fDone.wait(lock, [&slab]() { return slab.pending == 0; });
+}
+
+void Repacker::transferEncoded(hid_t srcId, hid_t dstId, const hdf5::DatasetInfo& info, const hdf5::DatasetInfo& dstInfo, const string& path)
+{
+	// while one slab is encoded, the next one is read: two raw slabs and up to two encoded ones, plus the stored source chunks
+	bool decode = isDecodable(info);
+	hsize_t chunkBytes = max(getChunkBytes(dstInfo), decode ? getChunkBytes(info) : 0);
+	hsize_t reserved = 2 * (chunkBytes + compressBound(chunkBytes)) * fPool.getNumThreads();
+	hsize_t slabRows = getSlabRows(info, path, dstInfo.chunkDims[0], reserved, decode ? 5 : 4);
+	hsize_t rowBytes = info.getDataSize() / info.shape[0];
+	// source chunks must not span two slabs
+	decode = decode && slabRows % info.chunkDims[0] == 0;
+
+	size_t rank = info.getRank();
+	hid_t type = H5Dget_type(srcId);
+	hid_t space = H5Dget_space(srcId);
+	vector<hsize_t> start(rank, 0), count(info.shape);
+	Slab slabs[2];
+	Slab* previous = 0;
+	try {
+		for (hsize_t row = 0, i = 0; row < info.shape[0]; row += slabRows, ++i) {
+			Slab& slab = slabs[i % 2];
+			slab.firstRow = row;
+			slab.nRows = min(slabRows, info.shape[0] - row);
+			slab.raw.resize(slab.nRows * rowBytes);
+
+			if (decode) {
+				readStoredChunks(srcId, info, slab, path);
+				submitStoredChunks(slab, info);
+				waitForSlab(slab);
+				slab.stored.clear();
+				if (slab.failed) {
+					throw hdf5::Exception("Could not decompress the chunks of " + path);
+				}
+			}
+			else {
+				// in the file type, so the bytes can be stored as they are
+				start[0] = row;
+				count[0] = slab.nRows;
+				H5Sselect_hyperslab(space, H5S_SELECT_SET, &start[0], 0, &count[0], 0);
+				hid_t memSpace = H5Screate_simple(rank, &count[0], 0);
+				herr_t status = H5Dread(srcId, type, memSpace, space, H5P_DEFAULT, &slab.raw[0]);
+				H5Sclose(memSpace);
+				if (status < 0) {
+					throw hdf5::Exception("Could not read the data of " + path);
+				}
+			}
+			submitSlab(slab, dstInfo);
+
+			if (previous) {
+				waitForSlab(*previous);
+				if (previous->failed) {
+					throw hdf5::Exception("Could not compress the chunks of " + path);
+				}
+				for (size_t c = 0; c < previous->chunks.size(); ++c) {
+					const EncodedChunk& chunk = previous->chunks[c];
+					if (H5Dwrite_chunk(dstId, H5P_DEFAULT, 0, &chunk.offset[0], chunk.data.size(), &chunk.data[0]) < 0) {
+						throw hdf5::Exception("Could not write the chunks of " + path);
+					}
+				}
+				previous->chunks.clear();
+			}
+			previous = &slab;
+		}
+		waitForSlab(*previous);
+		if (previous->failed) {
+			throw hdf5::Exception("Could not compress the chunks of " + path);
+		}
+		for (size_t c = 0; c < previous->chunks.size(); ++c) {
+			const EncodedChunk& chunk = previous->chunks[c];
+			if (H5Dwrite_chunk(dstId, H5P_DEFAULT, 0, &chunk.offset[0], chunk.data.size(), &chunk.data[0]) < 0) {
+				throw hdf5::Exception("Could not write the chunks of " + path);
+			}
+		}
+	}
+	catch (...) {
+		// the tasks refer to the slabs
+		waitForSlab(slabs[0]);
+		waitForSlab(slabs[1]);
+		H5Sclose(space);
+		H5Tclose(type);
+		throw;
+	}
+	H5Sclose(space);
+	H5Tclose(type);
+}
+
+/// measures the candidate chunks of the advisor for a dataset and prints them
+void advise(const hdf5::File& file, const string& path, const string& patternString, const hdf5::ChunkAdvisor& advisor)
+{
+	hdf5::AccessPattern pattern;
+	if (!parsePattern(patternString, pattern)) {
+		throw hdf5::Exception("Invalid access pattern '" + patternString + "'");
+	}
+	hid_t dataSet = H5Dopen2(file.getIdentifier(), path.c_str(), H5P_DEFAULT);
+	if (dataSet < 0) {
+		throw hdf5::Exception("Could not open dataset " + path);
+	}
+	try {
+		hdf5::DatasetInfo info(dataSet);
+		vector< vector<hsize_t> > candidates = advisor.getCandidates(info.shape, info.typeSize, pattern);
+		vector<hdf5::ChunkMeasurement> measurements = advisor.benchmark(dataSet, pattern, candidates);
+		cout << path << ": " << info << endl;
+		size_t best = 0;
+		for (size_t i = 0; i < measurements.size(); ++i) {
+			cout << (i == 0 ? "  suggested " : "  candidate ") << measurements[i] << endl;
+			if (measurements[i].getReadThroughput() > measurements[best].getReadThroughput()) {
+				best = i;
+			}
+		}
+		cout << "fastest: --rule '" << path << ":chunk=";
+		for (size_t d = 0; d < measurements[best].chunkDims.size(); ++d) {
+			cout << (d ? "x" : "") << measurements[best].chunkDims[d];
+		}
+		cout << "'" << endl;
+	}
+	catch (...) {
+		H5Dclose(dataSet);
+		throw;
+	}
+	H5Dclose(dataSet);
+}
+
+int main (int argc, char** argv) {
+	string input, output, memory, chunkBytes, cacheBytes, advisePath, pattern;
+	vector<string> ruleStrings;
+	size_t nThreads;
+
+	po::options_description desc("hdf5pp-repack: copies an HDF5 file with new chunking and compression per dataset\n\n"
+			"Rules have the form PATTERN:SPEC, the first rule whose regular expression matches the\n"
+			"whole path of a dataset is applied. SPEC is a comma separated list of\n"
+			"  chunk=AxBx..  chunk dimensions, 0 for the whole dimension\n"
+			"  rows[=N]      chunks for reading N rows at once\n"
+			"  columns[=N]   chunks for reading the whole first dimension of N columns\n"
+			"  tiles=AxB..   chunks for reading tiles of the given size\n"
+			"  append        chunks for appending records and reading ranges of them\n"
+			"  contiguous    contiguous layout without filters\n"
+			"  compact       compact layout without filters\n"
+			"  deflate=N     gzip compression at level N\n"
+			"  shuffle       byte shuffle before compression\n"
+			"  nofilter      no filters\n"
+			"Layout or filters not given are kept. All other objects are copied as they are. Hard\n"
+			"links to the same object are copied as separate objects, references are not updated.\n\n"
+			"With --advise, candidate chunks for the access pattern given by --pattern are measured\n"
+			"on a sample of the dataset in memory and nothing is written.\n\n"
+			"Options");
+	desc.add_options()
+		("help,h", "show this help")
+		("input,i", po::value<string>(&input), "file to repack")
+		("output,o", po::value<string>(&output), "file to create")
+		("rule,r", po::value< vector<string> >(&ruleStrings), "PATTERN:SPEC, may be given several times, e.g. '/raw/.*:chunk=4096x0,shuffle,deflate=4'")
+		("threads,t", po::value<size_t>(&nThreads)->default_value(0), "threads compressing chunks (0 = one per hardware thread)")
+		("memory,m", po::value<string>(&memory)->default_value("1G"), "memory for data in flight (suffixes K, M, G), at least four rows of chunks of a dataset")
+		("overwrite", "replace an existing output file")
+		("chunk-bytes", po::value<string>(&chunkBytes)->default_value("1M"), "chunk size aimed at for access patterns")
+		("cache-bytes", po::value<string>(&cacheBytes)->default_value("1M"), "chunk cache of the readers for access patterns")
+		("advise", po::value<string>(&advisePath), "dataset to measure chunks for")
+		("pattern", po::value<string>(&pattern)->default_value("rows"), "access pattern for --advise")
+	;
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);
+	}
+	catch (const po::error& e) {
+		cerr << e.what() << endl << desc << endl;
+		return 1;
+	}
+	if (vm.count("help") || input.empty() || (output.empty() && advisePath.empty())) {
+		cout << desc << endl;
+		return vm.count("help") ? 0 : 1;
+	}
+
+	try {
+		hdf5::ChunkAdvisor advisor(parseSize(chunkBytes), parseSize(cacheBytes));
+		if (!advisePath.empty()) {
+			advise(hdf5::File(hdf5::OpenFile(input)), advisePath, pattern, advisor);
+			return 0;
+		}
+
+		vector<Rule> rules;
+		for (size_t i = 0; i < ruleStrings.size(); ++i) {
+			rules.push_back(parseRule(ruleStrings[i], advisor));
+		}
+		hsize_t memoryBudget = parseSize(memory);
+
+		Stopwatch t;
+		hdf5::File src((hdf5::OpenFile(input)));
+		hdf5::ThreadPool pool(nThreads);
+		Repacker repacker(rules, pool, memoryBudget);
+
+		hid_t srcRoot = H5Gopen2(src.getIdentifier(), "/", H5P_DEFAULT);
+		// file creation properties include those of the root group
+		hid_t srcFile = H5Iget_file_id(srcRoot);
+		hid_t fcpl = H5Fget_create_plist(srcFile);
+		H5Fclose(srcFile);
+		hid_t fileId = H5Fcreate(output.c_str(), vm.count("overwrite") ? H5F_ACC_TRUNC : H5F_ACC_EXCL, fcpl, H5P_DEFAULT);
+		H5Pclose(fcpl);
+		if (fileId < 0) {
+			H5Gclose(srcRoot);
+			throw hdf5::Exception("Could not create file " + output);
+		}
+		hid_t dstRoot = H5Gopen2(fileId, "/", H5P_DEFAULT);
+		try {
+			Repacker::copyAttributes(srcRoot, dstRoot);
+			repacker.copyGroup(src, dstRoot);
+		}
+		catch (...) {
+			H5Gclose(dstRoot);
+			H5Gclose(srcRoot);
+			H5Fclose(fileId);
+			throw;
+		}
+		H5Gclose(dstRoot);
+		H5Gclose(srcRoot);
+		H5Fclose(fileId);
+
+		const Totals& totals = repacker.getTotals();
+		double elapsed = t.elapsed();
+		cerr << "repacked " << totals.repacked << " datasets (" << totals.bytes / 1e6 << " MB, " << totals.bytes / 1e6 / elapsed << " MB/s), copied "
+				<< totals.copied << " objects and " << totals.links << " links in " << elapsed << "s using " << pool.getNumThreads() << " threads" << endl;
+	}
+	catch (const std::exception& e) {
+		cerr << "hdf5pp-repack: " << e.what() << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * hdfScale.cpp
+ *
+ * Generates files with many small objects and measures how hdf5++ opens them
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <sys/resource.h>
+#include <boost/program_options.hpp>
+
+#include "File.h"
+
+using namespace std;
+namespace po = boost::program_options;
+
+/// shape of the generated file
+struct Shape {
+	size_t groups;
+	size_t depth;
+	size_t datasets;
+	size_t attributes;
+	size_t elements;
+};
+
+struct Counts {
+	size_t groups;
+	size_t datasets;
+	size_t attributes;
+
+	Counts(): groups(0), datasets(0), attributes(0) {}
+};
+
+class Stopwatch {
+	public:
+		Stopwatch(): fStart(chrono::steady_clock::now()) {}
+		double elapsed() const { return chrono::duration<double>(chrono::steady_clock::now() - fStart).count(); }
+	private:
+		chrono::steady_clock::time_point fStart;
+};
+
+/// peak resident set size of this process in bytes
+size_t peakRss()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+void addAttributes(hid_t objectId, const Shape& shape, Counts& counts)
+{
+	hid_t space = H5Screate(H5S_SCALAR);
+	for (size_t i = 0; i < shape.attributes; ++i) {
+		ostringstream name;
+		name << "a" << i;
+		double value = i;
+		hid_t attrId = H5Acreate2(objectId, name.str().c_str(), H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, H5P_DEFAULT);
+		H5Awrite(attrId, H5T_NATIVE_DOUBLE, &value);
+		H5Aclose(attrId);
+		++counts.attributes;
+	}
+	H5Sclose(space);
+}
+
+/// creates datasets and sub groups of groupId with the plain C API
+void generateGroup(hid_t groupId, size_t level, const Shape& shape, Counts& counts)
+{
+	hsize_t dims[] = { shape.elements };
+	hid_t space = H5Screate_simple(1, dims, 0);
+	vector<double> data(shape.elements, 1.);
+	for (size_t i = 0; i < shape.datasets; ++i) {
+		ostringstream name;
+		name << "d" << i;
+		hid_t dsId = H5Dcreate2(groupId, name.str().c_str(), H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+		if (dsId < 0) {
+			H5Sclose(space);
+			throw hdf5::Exception("Could not create dataset " + name.str());
+		}
+		H5Dwrite(dsId, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &data[0]);
+		addAttributes(dsId, shape, counts);
+		H5Dclose(dsId);
+		++counts.datasets;
+	}
+	H5Sclose(space);
+
+	if (level >= shape.depth) {
+		return;
+	}
+	for (size_t i = 0; i < shape.groups; ++i) {
+		ostringstream name;
+		name << "g" << i;
+		hid_t subId = H5Gcreate2(groupId, name.str().c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+		if (subId < 0) {
+			throw hdf5::Exception("Could not create group " + name.str());
+		}
+		addAttributes(subId, shape, counts);
+		generateGroup(subId, level + 1, shape, counts);
+		H5Gclose(subId);
+		if (++counts.groups % 10000 == 0) {
+			cerr << "  " << counts.groups << " groups, " << counts.datasets << " datasets" << endl;
+		}
+	}
+}
+
+/// visits all objects below group, optionally reading every dataset
+void traverse(const hdf5::Group& group, bool read, Counts& counts)
+{
+	for (hdf5::Group::ObjectConstIterator it = group.objectsBegin(); it != group.objectsEnd(); ++it) {
+		counts.attributes += it->second->getNumAttributes();
+		if (it->second->getType() == hdf5::Object::Group) {
+			++counts.groups;
+			traverse(dynamic_cast<const hdf5::Group&>(*it->second), read, counts);
+		}
+		else if (it->second->getType() == hdf5::Object::Dataset) {
+			++counts.datasets;
+			if (read) {
+				vector<double> data;
+				dynamic_cast<const hdf5::Dataset&>(*it->second).read(data);
+			}
+		}
+	}
+}
+
+int main (int argc, char** argv) {
+	string fileName, report;
+	Shape shape;
+	size_t maxOpenObjects;
+
+	po::options_description desc("hdf5pp_scale: open time and memory use of files with many objects");
+	desc.add_options()
+		("help,h", "show this help")
+		("generate", "generate the file (with the plain C API)")
+		("measure", "open the file with hdf5++ and measure it")
+		("file,f", po::value<string>(&fileName)->default_value("hdfScale.h5"), "HDF5 file")
+		("report,o", po::value<string>(&report)->default_value("-"), "JSON report of --measure (- for stdout)")
+		("groups,g", po::value<size_t>(&shape.groups)->default_value(10), "sub groups per group")
+		("depth,d", po::value<size_t>(&shape.depth)->default_value(3), "nesting depth of groups")
+		("datasets,n", po::value<size_t>(&shape.datasets)->default_value(10), "datasets per group")
+		("attributes,a", po::value<size_t>(&shape.attributes)->default_value(4), "attributes per group and dataset")
+		("elements,e", po::value<size_t>(&shape.elements)->default_value(16), "elements per dataset")
+		("max-open-objects", po::value<size_t>(&maxOpenObjects)->default_value(0), "handle limit while measuring (0 = unlimited)")
+		("read", "read every dataset while traversing")
+	;
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);
+	}
+	catch (const po::error& e) {
+		cerr << e.what() << endl << desc << endl;
+		return 1;
+	}
+	if (vm.count("help") || (!vm.count("generate") && !vm.count("measure"))) {
+		cout << desc << endl;
+		return vm.count("help") ? 0 : 1;
+	}
+
+	try {
+		if (vm.count("generate")) {
+			Counts counts;
+			Stopwatch t;
+			hid_t fileId = H5Fcreate(fileName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+			if (fileId < 0) {
+				throw hdf5::Exception("Could not create file " + fileName);
+			}
+			hid_t rootId = H5Gopen2(fileId, "/", H5P_DEFAULT);
+			addAttributes(rootId, shape, counts);
+			generateGroup(rootId, 0, shape, counts);
+			H5Gclose(rootId);
+			H5Fclose(fileId);
+			cerr << "generated " << fileName << ": " << counts.groups << " groups, " << counts.datasets << " datasets, "
+					<< counts.attributes << " attributes in " << t.elapsed() << "s" << endl;
+		}
+
+		if (vm.count("measure")) {
+			size_t rssBefore = peakRss();
+
+			boost::shared_ptr<hdf5::File> file(new hdf5::File());
+			Stopwatch tOpen;
+			file->openFile(hdf5::OpenFile(fileName).maxOpenObjects(maxOpenObjects));
+			double openTime = tOpen.elapsed();
+			size_t rssOpen = peakRss();
+			ssize_t hdfObjects = H5Fget_obj_count(H5F_OBJ_ALL, H5F_OBJ_ALL);
+			size_t managedObjects = file->getNumOpenObjects();
+
+			Counts counts;
+			counts.attributes = file->getNumAttributes();
+			Stopwatch tTraverse;
+			traverse(*file, vm.count("read") > 0, counts);
+			double traverseTime = tTraverse.elapsed();
+			size_t rssTraverse = peakRss();
+
+			Stopwatch tClose;
+			file.reset();
+			double closeTime = tClose.elapsed();
+
+			ofstream fileStream;
+			if (report != "-") {
+				fileStream.open(report.c_str());
+			}
+			ostream& os = report == "-" ? cout : fileStream;
+			os << "{" << endl;
+			os << "  \"file\": \"" << fileName << "\"," << endl;
+			os << "  \"groups\": " << counts.groups << "," << endl;
+			os << "  \"datasets\": " << counts.datasets << "," << endl;
+			os << "  \"attributes\": " << counts.attributes << "," << endl;
+			os << "  \"max_open_objects\": " << maxOpenObjects << "," << endl;
+			os << "  \"read\": " << (vm.count("read") ? "true" : "false") << "," << endl;
+			os << "  \"open_s\": " << openTime << "," << endl;
+			os << "  \"traverse_s\": " << traverseTime << "," << endl;
+			os << "  \"close_s\": " << closeTime << "," << endl;
+			os << "  \"open_hdf5_ids\": " << hdfObjects << "," << endl;
+			os << "  \"open_object_handles\": " << managedObjects << "," << endl;
+			os << "  \"peak_rss_before_open\": " << rssBefore << "," << endl;
+			os << "  \"peak_rss_after_open\": " << rssOpen << "," << endl;
+			os << "  \"peak_rss_after_traverse\": " << rssTraverse << endl;
+			os << "}" << endl;
+		}
+	}
+	catch (const std::exception& e) {
+		cerr << "hdf5pp_scale: " << e.what() << endl;
+		return 1;
+	}
+
+	return 0;
+}